@@ -0,0 +1,221 @@
+/*
+
+    Stateful CLIK Controller
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CLIKCONTROLLER_H
+#define CLIKCONTROLLER_H
+
+#include "sun_robot_lib/Robot.h"
+
+namespace sun
+{
+//! Timing statistics of ClikController::step
+struct ClikTimingStats
+{
+  //! Number of timed steps
+  long num_steps = 0;
+
+  //! Duration of the last step [ns]
+  double last_ns = 0.0;
+
+  //! Min and max duration [ns]
+  double min_ns = 0.0;
+  double max_ns = 0.0;
+
+  //! Mean duration [ns]
+  double mean_ns = 0.0;
+};
+
+//! Quaternion CLIK bound to a Robot, it owns the continuity state and all the buffers
+/*!
+    The controller stores the quaternion used for continuity, the gains, the sampling time, the masks,
+    the null space objective (distance from a target configuration, see Robot::grad_fcst_target_configuration)
+    and a workspace for the jacobian and the solver.
+    After the construction step() does not allocate memory.
+    The robot is stored by reference, it must outlive the controller.
+*/
+class ClikController
+{
+private:
+  ClikController();  // No Default Constructor
+
+  //! Controlled robot
+  Robot& _robot;
+
+  //! Workspace (jacobian, solver buffers and qDH_k+1)
+  KinematicsWorkspace _ws;
+
+  //! CLIK gain, sampling time and null space gain
+  double _gain, _Ts, _gain_null_space;
+
+  //! Operative space mask (see Robot::clik)
+  TooN::Vector<6, int> _mask;
+
+  //! Joint mask, empty if all the joints are active (see Robot::clik with joint_mask)
+  std::vector<bool> _joint_mask;
+
+  //! Null space objective: target configuration and scale of each joint (weight/range/sum of the weights)
+  TooN::Vector<> _desired_configuration;
+  TooN::Vector<> _null_space_scale;
+
+  //! Velocity projected into the null space
+  TooN::Vector<> _q0_p;
+
+  //! Quaternion at the last step (continuity)
+  UnitQuaternion _Q;
+
+  //! Outputs of the last step
+  TooN::Vector<> _qpDH;
+  TooN::Vector<6> _error;
+
+  //! Timing statistics
+  ClikTimingStats _stats;
+  double _total_ns;
+
+public:
+  /*======CONSTRUCTORS======*/
+
+  /*!
+      Full constructor
+      The null space objective is disabled (gain_null_space = 0), the mask is all ones
+  */
+  ClikController(Robot& robot, double gain, double Ts);
+
+  /*======END CONSTRUCTORS======*/
+
+  /*=========GETTERS=========*/
+
+  /*!
+      get the controlled robot
+  */
+  Robot& getRobot() const;
+
+  /*!
+      get the CLIK gain
+  */
+  double getGain() const;
+
+  /*!
+      get the sampling time
+  */
+  double getTs() const;
+
+  /*!
+      get the null space gain
+  */
+  double getNullSpaceGain() const;
+
+  /*!
+      get the operative space mask
+  */
+  const TooN::Vector<6, int>& getMask() const;
+
+  /*!
+      get the quaternion at the last step
+  */
+  const UnitQuaternion& getQuaternion() const;
+
+  /*!
+      get the joint velocity of the last step
+  */
+  const TooN::Vector<>& getJointVelocity() const;
+
+  /*!
+      get the error of the last step
+  */
+  const TooN::Vector<6>& getError() const;
+
+  /*!
+      get the timing statistics of step()
+  */
+  const ClikTimingStats& getTimingStats() const;
+
+  /*=========END GETTERS=========*/
+
+  /*=========SETTERS=========*/
+
+  /*!
+      set the CLIK gain
+  */
+  void setGain(double gain);
+
+  /*!
+      set the sampling time
+  */
+  void setTs(double Ts);
+
+  /*!
+      set the operative space mask, if the i-th element is 0 the i-th coordinate is not controlled
+  */
+  void setMask(const TooN::Vector<6, int>& mask);
+
+  /*!
+      set the joint mask, joint_mask[i] is false if the i-th joint is locked (empty = all the joints are active)
+  */
+  void setJointMask(const std::vector<bool>& joint_mask);
+
+  /*!
+      set the null space objective: minimize the weighted distance from desired_configuration (DH convention)
+      gain_null_space = 0 disables the objective
+  */
+  void setNullSpaceObjective(double gain_null_space, const TooN::Vector<>& desired_configuration,
+                             const TooN::Vector<>& desired_configuration_joint_weights);
+
+  /*=========END SETTERS=========*/
+
+  /*!
+      Reset the quaternion continuity state to the identity, the outputs and the timing statistics
+  */
+  void reset();
+
+  /*!
+      Reset as above, the quaternion continuity state is the orientation of the end-effector in qDH
+  */
+  void reset(const TooN::Vector<>& qDH);
+
+  /*!
+      Reset the timing statistics only
+  */
+  void resetTimingStats();
+
+  /*!
+      CLIK step
+
+      Inputs:
+          - qDH_k: joints at time k
+          - pd: desired position
+          - Qd: desired quaternion
+          - dpd: desired position velocity
+          - omegad: desired angular velocity
+
+      Outputs:
+          - return: qDH_k+1 joints at time k+1 (valid until the next step)
+      The joint velocity and the error are available through getJointVelocity() and getError()
+      This function does not allocate memory
+  */
+  const TooN::Vector<>& step(const TooN::Vector<>& qDH_k, const TooN::Vector<3>& pd, const UnitQuaternion& Qd,
+                             const TooN::Vector<3>& dpd, const TooN::Vector<3>& omegad);
+};
+
+}  // namespace sun
+
+#endif
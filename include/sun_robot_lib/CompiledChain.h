@@ -0,0 +1,144 @@
+/*
+
+    Compiled Kinematic Chain
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COMPILEDCHAIN_H
+#define COMPILEDCHAIN_H
+
+#include <cstdint>
+#include <vector>
+#include "sun_robot_lib/RobotLink.h"
+#include "sun_robot_lib/RigidTransform.h"
+
+//! Max number of joints of a compiled chain (size of the joint-type bitmask)
+#define COMPILEDCHAIN_MAX_JOINTS 64
+
+//! Tolerance used to detect the special DH patterns (alpha in {0, +-pi/2})
+#define COMPILEDCHAIN_DH_EPS 1.0E-12
+
+namespace sun
+{
+//! Flattened (struct-of-arrays) copy of a kinematic chain
+/*!
+    All the link parameters are stored in contiguous arrays indexed by joint,
+    the constant terms (e.g. sin and cos of alpha) are precomputed.
+    The kinematic functions of Robot run on this table, without virtual calls to the links.
+*/
+class CompiledChain
+{
+public:
+  //! Compose routine of a link: T = T*A given a, sin/cos of alpha, d and sin/cos of theta
+  typedef void (*DHKernel)(double a, double sin_alpha, double cos_alpha, double d, double sin_theta,
+                           double cos_theta, RigidTransform& T);
+
+  //! Number of joints
+  int num_joints;
+
+  // Kinematic parameters (DH)
+  std::vector<double> a;          // link length
+  std::vector<double> sin_alpha;  // sin of link twist
+  std::vector<double> cos_alpha;  // cos of link twist
+  std::vector<double> d;          // link offset (joint variable for prismatic links)
+  std::vector<double> theta;      // link angle (joint variable for revolute links)
+  std::vector<double> sin_theta;  // sin of link angle (prismatic links only)
+  std::vector<double> cos_theta;  // cos of link angle (prismatic links only)
+
+  //! Compose routine of each link, specialized on the DH pattern of the link (alpha in {0, +-pi/2}, a=0, d=0)
+  //! if the chain is built with specialize = true
+  std::vector<DHKernel> dh_kernel;
+
+  //! Joint type bitmask, the i-th bit is 1 if the i-th joint is prismatic
+  uint64_t prismatic_mask;
+
+  // Robot-DH Conversion: q_DH = robot2dh_sign*q_R + robot2dh_offset
+  std::vector<double> robot2dh_offset;
+  std::vector<double> robot2dh_sign;
+
+  // Safety Vars (Robot convention)
+  std::vector<double> hard_limit_lower, hard_limit_higher;
+  std::vector<double> soft_limit_lower, soft_limit_higher;
+  std::vector<double> hard_velocity_limit;
+  std::vector<double> soft_velocity_limit;
+
+  // Dynamic parameters (link frames)
+  std::vector<double> mass;                 // link mass
+  std::vector<TooN::Vector<3>> com;         // center of mass
+  std::vector<TooN::Matrix<3, 3>> inertia;  // inertia tensor w.r.t. the center of mass
+
+  /*======CONSTRUCTORS======*/
+
+  /*!
+      Empty chain
+  */
+  CompiledChain();
+
+  /*======END CONSTRUCTORS======*/
+
+  /*!
+      Flatten the vector of links into the table
+
+      specialize: if true the compose routine of each link is specialized on its DH pattern,
+      otherwise the general routine is used for all the links (reference to validate the specialized routines)
+  */
+  void build(const std::vector<RobotLinkPtr>& links, bool specialize = true);
+
+  /*!
+      Return true if the i-th joint is prismatic
+  */
+  bool isPrismatic(int i) const;
+
+  /*!
+      Compute the transform matrix of the i-th link
+      input q_DH in DH convention
+  */
+  TooN::Matrix<4, 4> A(int i, double q_DH) const;
+
+  /*!
+      Post-multiply T by the transform matrix of the i-th link: T = T*A_i(q_DH)
+      input q_DH in DH convention
+  */
+  void postMultA(int i, double q_DH, RigidTransform& T) const;
+
+  /*!
+      Transform the i-th joint from robot to DH convention
+  */
+  double joint_Robot2DH(int i, double q_Robot) const;
+
+  /*!
+      Transform the i-th joint from DH to robot convention
+  */
+  double joint_DH2Robot(int i, double q_DH) const;
+
+  /*!
+      Transform the i-th joint velocity from robot to DH convention
+  */
+  double jointvel_Robot2DH(int i, double q_vel_Robot) const;
+
+  /*!
+      Transform the i-th joint velocity from DH to robot convention
+  */
+  double jointvel_DH2Robot(int i, double q_vel_DH) const;
+};
+
+}  // namespace sun
+
+#endif
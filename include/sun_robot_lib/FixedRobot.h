@@ -0,0 +1,367 @@
+/*
+
+    Fixed DOF Robot Class
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef FIXEDROBOT_H
+#define FIXEDROBOT_H
+
+#include <algorithm>
+#include <array>
+#include "sun_robot_lib/Robot.h"
+#include "TooN/Cholesky.h"
+
+namespace sun
+{
+//! Fixed-size kinematic engine for a chain of N joints
+/*!
+    The number of joints and the joint types are template parameters:
+    the i-th bit of PRISMATIC_MASK is 1 if the i-th joint is prismatic, revolute otherwise.
+    All the vectors and matrices are fixed size (stack only) and all the loops have a compile-time bound.
+    The DH table is copied from a Robot object: fkine and jacobian are numerically identical to the ones of Robot,
+    clik solves the DLS as the allocation-free Robot::clik (KinematicsWorkspace overloads).
+*/
+template <int N, unsigned int PRISMATIC_MASK = 0u>
+class FixedRobot
+{
+private:
+  FixedRobot();  // No Default Constructor
+
+protected:
+  //! Transformation matrix of link_0 w.r.t. base frame
+  RigidTransform _b_T_0;
+  //! Transformation matrix of effector w.r.t. link_n frame
+  RigidTransform _n_T_e;
+
+  // Kinematic parameters (DH)
+  TooN::Vector<N> _a;          // link length
+  TooN::Vector<N> _sin_alpha;  // sin of link twist
+  TooN::Vector<N> _cos_alpha;  // cos of link twist
+  TooN::Vector<N> _d;          // link offset (not used for prismatic links)
+  TooN::Vector<N> _theta;      // link angle (not used for revolute links)
+
+  // Robot-DH Conversion
+  TooN::Vector<N> _robot2dh_offset;
+  std::array<bool, N> _robot2dh_flip;
+
+  //! Joint speed saturation used in dls for clik
+  double _dls_joint_speed_saturation;
+
+public:
+  //! Number of joints
+  static const int NUM_JOINTS = N;
+
+  /*=========CONSTRUCTORS=========*/
+
+  /*!
+      Construct the fixed-size engine from the kinematic chain of robot
+
+      robot must have N joints with the types given by PRISMATIC_MASK
+  */
+  explicit FixedRobot(const Robot& robot)
+  {
+    if (robot.getNumJoints() != N)
+    {
+      std::cout << ROBOT_ERROR_COLOR "[FixedRobot] Error in FixedRobot( const Robot& robot ): robot has "
+                << robot.getNumJoints() << " joints, expected " << N << ROBOT_CRESET << std::endl;
+      exit(-1);
+    }
+
+    _b_T_0 = RigidTransform(robot.getbT0());
+    _n_T_e = RigidTransform(robot.getnTe());
+    _dls_joint_speed_saturation = robot.getDLSJointSpeedSaturation();
+
+    std::vector<RobotLinkPtr> links = robot.getLinks();
+    for (int i = 0; i < N; i++)
+    {
+      if (isPrismatic(i) != (links[i]->type() == 'p'))
+      {
+        std::cout << ROBOT_ERROR_COLOR "[FixedRobot] Error in FixedRobot( const Robot& robot ): type of link " << i
+                  << " does not match PRISMATIC_MASK" ROBOT_CRESET << std::endl;
+        exit(-1);
+      }
+      _a[i] = links[i]->getDH_a();
+      _sin_alpha[i] = sin(links[i]->getDH_alpha());
+      _cos_alpha[i] = cos(links[i]->getDH_alpha());
+      _d[i] = links[i]->getDH_d();
+      _theta[i] = links[i]->getDH_theta();
+      _robot2dh_offset[i] = links[i]->getRobot2DH_offset();
+      _robot2dh_flip[i] = links[i]->getRobot2DH_flip();
+    }
+  }
+
+  /*=====END CONSTRUCTORS=========*/
+
+  /*!
+      Return true if the i-th joint is prismatic
+  */
+  static constexpr bool isPrismatic(int i)
+  {
+    return ((PRISMATIC_MASK >> i) & 1u) != 0u;
+  }
+
+  /*!
+      get number of joints
+  */
+  static constexpr int getNumJoints()
+  {
+    return N;
+  }
+
+  /*=========CONVERSIONS=========*/
+
+  /*!
+      Transform joints from robot to DH convention
+  */
+  TooN::Vector<N> joints_Robot2DH(const TooN::Vector<N>& q_Robot) const
+  {
+    TooN::Vector<N> q_DH;
+    for (int i = 0; i < N; i++)
+    {
+      q_DH[i] = (_robot2dh_flip[i] ? -q_Robot[i] : q_Robot[i]) + _robot2dh_offset[i];
+    }
+    return q_DH;
+  }
+
+  /*!
+      Transform joints from DH to robot convention
+  */
+  TooN::Vector<N> joints_DH2Robot(const TooN::Vector<N>& q_DH) const
+  {
+    TooN::Vector<N> q_Robot;
+    for (int i = 0; i < N; i++)
+    {
+      q_Robot[i] = _robot2dh_flip[i] ? -(q_DH[i] - _robot2dh_offset[i]) : (q_DH[i] - _robot2dh_offset[i]);
+    }
+    return q_Robot;
+  }
+
+  /*=========END CONVERSIONS=========*/
+
+  /*========FKINE=========*/
+
+  /*!
+      Compute the transform matrix of the i-th link
+      input q_DH in DH convention
+  */
+  TooN::Matrix<4, 4> A(int i, double q_DH) const
+  {
+    const double theta = isPrismatic(i) ? _theta[i] : q_DH;
+    const double d = isPrismatic(i) ? q_DH : _d[i];
+
+    const double sa = _sin_alpha[i];
+    const double ca = _cos_alpha[i];
+
+    const double st = sin(theta);
+    const double ct = cos(theta);
+
+    // standard DH
+    return TooN::Data(ct, -st * ca, st * sa, _a[i] * ct, st, ct * ca, -ct * sa, _a[i] * st, 0.0, sa, ca, d, 0.0, 0.0,
+                      0.0, 1.0);
+  }
+
+  /*!
+      Post-multiply T by the transform matrix of the i-th link: T = T*A_i(q_DH)
+      input q_DH in DH convention
+  */
+  void postMultA(int i, double q_DH, RigidTransform& T) const
+  {
+    const double theta = isPrismatic(i) ? _theta[i] : q_DH;
+    const double d = isPrismatic(i) ? q_DH : _d[i];
+
+    T.postMultDH(_a[i], _sin_alpha[i], _cos_alpha[i], d, sin(theta), cos(theta));
+  }
+
+  /*!
+      fkine to the end-effector
+  */
+  TooN::Matrix<4, 4> fkine(const TooN::Vector<N>& q_DH) const
+  {
+    RigidTransform b_T_j = _b_T_0;
+    for (int i = 0; i < N; i++)
+    {
+      postMultA(i, q_DH[i], b_T_j);
+    }
+    b_T_j *= _n_T_e;
+    return b_T_j.toMatrix();
+  }
+
+  /*!
+      All the transformations [ b_T_0 , b_T_1, ... , b_T_e ] (size = N+1)
+  */
+  std::array<RigidTransform, N + 1> fkine_all(const TooN::Vector<N>& q_DH) const
+  {
+    std::array<RigidTransform, N + 1> all_T;
+    all_T[0] = _b_T_0;
+    for (int i = 0; i < N; i++)
+    {
+      all_T[i + 1] = all_T[i];
+      postMultA(i, q_DH[i], all_T[i + 1]);
+    }
+    all_T[N] *= _n_T_e;
+    return all_T;
+  }
+
+  /*========END FKINE=========*/
+
+  /*========Jacobians=========*/
+
+  /*!
+      Fused fkine and geometric jacobian in frame {end-effector} w.r.t. base frame
+
+      Outputs:
+          - return: geometric jacobian
+          - b_T_e: end-effector pose
+  */
+  TooN::Matrix<6, N> fkine_jacob_geometric(const TooN::Vector<N>& q_DH,
+                                           // Return Vars
+                                           TooN::Matrix<4, 4>& b_T_e) const
+  {
+    const std::array<RigidTransform, N + 1> all_T = fkine_all(q_DH);
+    all_T[N].toMatrix(b_T_e);
+
+    TooN::Matrix<6, N> J_geo;
+    const TooN::Vector<3>& p_e = all_T[N].p;
+    for (int i = 0; i < N; i++)
+    {
+      TooN::Vector<3> z_i_1 = all_T[i].z();
+      if (isPrismatic(i))
+      {
+        J_geo.T()[i].template slice<0, 3>() = z_i_1;
+        J_geo.T()[i].template slice<3, 3>() = TooN::Zeros;
+      }
+      else
+      {
+        const TooN::Vector<3>& p_i_1 = all_T[i].p;
+        J_geo.T()[i].template slice<0, 3>() = z_i_1 ^ (p_e - p_i_1);
+        J_geo.T()[i].template slice<3, 3>() = z_i_1;
+      }
+    }
+    return J_geo;
+  }
+
+  /*!
+      Compute the geometric jacobian in frame {end-effector} w.r.t. base frame
+  */
+  TooN::Matrix<6, N> jacob_geometric(const TooN::Vector<N>& q_DH) const
+  {
+    TooN::Matrix<4, 4> b_T_e;
+    return fkine_jacob_geometric(q_DH, b_T_e);
+  }
+
+  /*========END Jacobians=========*/
+
+  /*========CLIK=========*/
+
+  /*!
+      Very General CLIK (see Robot::clik)
+
+      J_pinv_dls = J^T * ( J*J^T + damping^2*I )^-1 is computed with a 6x6 Cholesky factorization
+  */
+  TooN::Vector<N> clik(const TooN::Vector<N>& qDH_k, const TooN::Vector<6>& error, const TooN::Matrix<6, N>& jacob,
+                       const TooN::Vector<6>& veld, double gain, double Ts, double gain_null_space,
+                       const TooN::Vector<N>& q0_p,
+                       // Return Vars
+                       TooN::Vector<N>& qpDH) const
+  {
+    TooN::Vector<6> vel_e = (veld + gain * error);
+    double damping = TooN::norm(vel_e) / _dls_joint_speed_saturation;
+
+    TooN::Matrix<6, 6> JJt = jacob * jacob.T();
+    double damping_sq = std::max(damping * damping, ROBOT_DLS_MIN_DAMPING_SQ);
+    for (int i = 0; i < 6; i++)
+    {
+      JJt(i, i) += damping_sq;
+    }
+    TooN::Cholesky<6> JJt_chol(JJt);
+    TooN::Matrix<N, 6> J_pinv_dls = jacob.T() * JJt_chol.get_inverse();
+    qpDH = J_pinv_dls * vel_e;
+
+    // Null space
+    if (gain_null_space != 0.0)
+    {
+      TooN::Matrix<N, N> null_proj = TooN::Identity;
+      null_proj -= J_pinv_dls * jacob;
+      qpDH += gain_null_space * (null_proj * q0_p);
+    }
+
+    return (qDH_k + qpDH * Ts);
+  }
+
+  /*!
+      Clik using Quaternions FULL VERSION (see Robot::clik)
+  */
+  TooN::Vector<N> clik(const TooN::Vector<N>& qDH_k, const TooN::Vector<3>& pd, const UnitQuaternion& Qd,
+                       const UnitQuaternion& oldQ, const TooN::Vector<3>& dpd, const TooN::Vector<3>& omegad,
+                       const TooN::Vector<6, int>& mask, double gain, double Ts, double gain_null_space,
+                       const TooN::Vector<N>& q0_p,
+                       // Return Vars
+                       TooN::Vector<N>& qpDH, TooN::Vector<6>& error, UnitQuaternion& newQ) const
+  {
+    // fkine and geometric Jacobian in a single pass
+    TooN::Matrix<4, 4> b_T_e;
+    TooN::Matrix<6, N> jacob = fkine_jacob_geometric(qDH_k, b_T_e);
+
+    // Compute Error
+    TooN::Vector<3> position = b_T_e.T()[3].template slice<0, 3>();
+    newQ = UnitQuaternion(b_T_e, oldQ);
+    error.template slice<0, 3>() = pd - position;
+    UnitQuaternion deltaQ = Qd / newQ;
+    error.template slice<3, 3>() = deltaQ.getV();
+
+    // Construct veld
+    TooN::Vector<6> veld;
+    veld.template slice<0, 3>() = dpd;
+    veld.template slice<3, 3>() = omegad;
+
+    // Apply mask
+    for (int i = 0; i < 6; i++)
+    {
+      if (mask[i] == 0)
+      {
+        error[i] = 0.0;
+        jacob[i] = TooN::Zeros;
+        veld[i] = 0.0;
+      }
+    }
+
+    return clik(qDH_k, error, jacob, veld, gain, Ts, gain_null_space, q0_p, qpDH);
+  }
+
+  /*!
+      Clik using Quaternions (see Robot::clik)
+  */
+  TooN::Vector<N> clik(const TooN::Vector<N>& qDH_k, const TooN::Vector<3>& pd, const UnitQuaternion& Qd,
+                       const UnitQuaternion& oldQ, const TooN::Vector<3>& dpd, const TooN::Vector<3>& omegad,
+                       double gain, double Ts, double gain_null_space, const TooN::Vector<N>& q0_p,
+                       // Return Vars
+                       TooN::Vector<N>& qpDH, TooN::Vector<6>& error, UnitQuaternion& newQ) const
+  {
+    return clik(qDH_k, pd, Qd, oldQ, dpd, omegad, TooN::Ones, gain, Ts, gain_null_space, q0_p, qpDH, error, newQ);
+  }
+
+  /*========END CLIK=========*/
+
+};  // END CLASS
+
+}  // namespace sun
+
+#endif
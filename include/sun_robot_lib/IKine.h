@@ -0,0 +1,116 @@
+/*
+
+    Inverse Kinematics Solver Types
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef IKINE_H
+#define IKINE_H
+
+#include <string>
+#include <atomic>
+
+namespace sun
+{
+//! Exit status of the iterative inverse kinematics (see Robot::ikine)
+enum IKineStatus
+{
+  IKINE_SUCCESS = 0,     //!< the error is within the tolerances
+  IKINE_MAX_ITERATIONS,  //!< the iteration cap has been reached
+  IKINE_STALLED,         //!< no progress: the step is below tolerance_step or the damping exceeded lambda_max
+  IKINE_CANCELLED,       //!< stopped by the cancel flag (see IKineOptions::cancel)
+  IKINE_SOFT_LIMITS,     //!< converged, but the solution exceeds the soft joint limits (multi-start only)
+  IKINE_INVALID_SIZE     //!< the seed, the output or the workspace is not of size NUM_JOINT (nothing is computed)
+};
+
+//! Options of the iterative inverse kinematics (see Robot::ikine)
+struct IKineOptions
+{
+  //! Tolerance on the position error norm [m]
+  double tolerance_position = 1.0E-6;
+
+  //! Tolerance on the orientation error norm (angle) [rad]
+  double tolerance_orientation = 1.0E-6;
+
+  //! Max number of iterations (accepted and rejected steps)
+  int max_iterations = 100;
+
+  //! The solver stops (IKINE_STALLED) if the joint step norm is below this value
+  double tolerance_step = 1.0E-12;
+
+  //! Levenberg-Marquardt damping: initial value, bounds and update factors
+  double lambda_initial = 1.0E-3;
+  double lambda_min = 1.0E-9;
+  double lambda_max = 1.0E6;
+  double lambda_increase = 10.0;  // after a rejected step
+  double lambda_decrease = 0.1;   // after an accepted step
+
+  //! If true the iterates are clamped within the hard joint limits
+  bool clamp_joint_limits = true;
+
+  //! If not null, the solver stops (IKINE_CANCELLED) as soon as *cancel is true (checked once per iteration)
+  const std::atomic<bool>* cancel = nullptr;
+};
+
+//! Report of the iterative inverse kinematics (see Robot::ikine)
+struct IKineResult
+{
+  //! Exit status
+  IKineStatus status = IKINE_MAX_ITERATIONS;
+
+  //! Number of iterations (accepted and rejected steps)
+  int iterations = 0;
+
+  //! Number of jacobian evaluations
+  int jacobian_evaluations = 0;
+
+  //! Final position error norm [m]
+  double error_position = 0.0;
+
+  //! Final orientation error norm (angle) [rad]
+  double error_orientation = 0.0;
+};
+
+/*!
+    Return the name of the status
+*/
+inline std::string ikineStatusToString(IKineStatus status)
+{
+  switch (status)
+  {
+    case IKINE_SUCCESS:
+      return "SUCCESS";
+    case IKINE_MAX_ITERATIONS:
+      return "MAX_ITERATIONS";
+    case IKINE_STALLED:
+      return "STALLED";
+    case IKINE_CANCELLED:
+      return "CANCELLED";
+    case IKINE_SOFT_LIMITS:
+      return "SOFT_LIMITS";
+    case IKINE_INVALID_SIZE:
+      return "INVALID_SIZE";
+  }
+  return "UNKNOWN";
+}
+
+}  // namespace sun
+
+#endif
@@ -0,0 +1,114 @@
+/*
+
+    Kinematics Cache
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef KINEMATICSCACHE_H
+#define KINEMATICSCACHE_H
+
+#include <cstdint>
+#include <vector>
+#include "TooN/TooN.h"
+#include "sun_robot_lib/RigidTransform.h"
+
+namespace sun
+{
+class Robot;
+
+//! Stateful prefix cache used by the incremental overloads of Robot::fkine and Robot::jacob_geometric
+/*!
+    The cache remembers the last joint positions and the frames of the chain,
+    a new call recomputes the chain only from the first joint that changed.
+    The jacobian columns of the unchanged prefix are reused, only their position part is updated.
+
+    Invalidation contract:
+        - Robot::setbT0, Robot::setnTe, Robot::compile and all the functions that modify the links
+          (setLinks, push_back_link, pop_back_link) change the kinematics id of the robot,
+          the next call with the cache recomputes the whole chain.
+        - A link modified through the reference returned by Robot::getLink is detected by its version
+          (see RobotLink::getVersion): the chain is compiled again with a new kinematics id.
+        - Using the same cache with different robots is safe (each robot has its own id) but useless.
+    After the construction no function that writes into the cache will allocate memory.
+    The public members are outputs, do not modify them.
+*/
+class KinematicsCache
+{
+private:
+  KinematicsCache();  // No Default Constructor
+
+  //! Number of joints
+  int _num_joints;
+
+  //! Kinematics id of the robot that filled the cache (0 = empty cache)
+  uint64_t _kinematics_id;
+
+  //! all_T[0.._num_valid_frames] are consistent with q_DH
+  int _num_valid_frames;
+
+  //! The columns [0,_num_valid_columns) of jacob are consistent with the frames (except the position part)
+  int _num_valid_columns;
+
+  //! Number of links recomputed by the last update
+  int _last_recomputed_links;
+
+  friend class Robot;
+
+public:
+  //! Joint positions of the last call
+  TooN::Vector<> q_DH;
+
+  //! Frames of the joints [ b_T_0 , b_T_1, ... , b_T_n ] (size = num_joints+1)
+  std::vector<RigidTransform> all_T;
+
+  //! End-effector pose
+  RigidTransform b_T_e;
+
+  //! Geometric Jacobian (6 x num_joints)
+  TooN::Matrix<6, TooN::Dynamic> jacob;
+
+  /*======CONSTRUCTORS======*/
+
+  /*!
+      Construct an empty cache for a robot with num_joints joints
+  */
+  explicit KinematicsCache(int num_joints);
+
+  /*======END CONSTRUCTORS======*/
+
+  /*!
+      Force the recomputation of the whole chain at the next call
+  */
+  void invalidate();
+
+  /*!
+      get number of joints
+  */
+  int getNumJoints() const;
+
+  /*!
+      Number of links recomputed by the last call (0 if the joints did not change)
+  */
+  int getLastRecomputedLinks() const;
+};
+
+}  // namespace sun
+
+#endif
@@ -0,0 +1,121 @@
+/*
+
+    Kinematics Workspace
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef KINEMATICSWORKSPACE_H
+#define KINEMATICSWORKSPACE_H
+
+#include <vector>
+#include "TooN/TooN.h"
+#include "sun_robot_lib/RigidTransform.h"
+
+namespace sun
+{
+//! Preallocated buffers used by the allocation-free overloads of Robot::fkine_all, Robot::jacob_geometric and Robot::clik
+/*!
+    The workspace is sized once for a given number of joints (use robot.getNumJoints()).
+    After the construction no kinematic function that writes into the workspace will allocate memory.
+*/
+class KinematicsWorkspace
+{
+private:
+  KinematicsWorkspace();  // No Default Constructor
+
+  //! Number of joints
+  int _num_joints;
+
+public:
+  //! All the transformations [ b_T_0 , b_T_1, ... , b_T_e ] (size = num_joints+1)
+  std::vector<RigidTransform> all_T;
+
+  //! Geometric Jacobian (6 x num_joints)
+  TooN::Matrix<6, TooN::Dynamic> jacob;
+
+  //! DLS pseudo inverse of the Jacobian (num_joints x 6)
+  TooN::Matrix<TooN::Dynamic, 6> J_pinv_dls;
+
+  //! Null space projector (num_joints x num_joints)
+  TooN::Matrix<> null_proj;
+
+  //! Joint positions at time k+1 (output of clik)
+  TooN::Vector<> qDH_k1;
+
+  //! Time derivative of the geometric Jacobian (6 x num_joints)
+  TooN::Matrix<6, TooN::Dynamic> jacob_dot;
+
+  //! Time derivative of the axis z_{i-1} of each joint, in base frame (size = num_joints, see jacob_dot)
+  std::vector<TooN::Vector<3>> joint_axis_dot;
+
+  //! Velocity of the origins [ o_0 , o_1, ... , p_e ] of the frames, in base frame (size = num_joints+1)
+  std::vector<TooN::Vector<3>> joint_origin_dot;
+
+  //! Joint acceleration to be projected into the null space (used by clik_second_order)
+  TooN::Vector<> q0_pp;
+
+  //! Indices of the active (not locked) joints, used by the joint masked functions (capacity num_joints)
+  std::vector<int> active_joints;
+
+  //! Net force acting on each link, in base frame (size = num_joints, written by the inverse dynamics)
+  std::vector<TooN::Vector<3>> link_force;
+
+  //! Net moment acting on each link about its center of mass, in base frame (size = num_joints, see link_force)
+  std::vector<TooN::Vector<3>> link_moment;
+
+  //! Motion subspace of each joint in base frame, [angular; linear velocity of the point at the base origin]
+  std::vector<TooN::Vector<6>> joint_motion;
+
+  //! Spatial inertia in base frame about the base origin, composite (mass matrix) or articulated (forward dynamics)
+  std::vector<TooN::Matrix<6, 6>> body_inertia;
+
+  //! Bias force of each articulated body (forward dynamics)
+  std::vector<TooN::Vector<6>> body_bias;
+
+  //! Velocity product acceleration of each link (forward dynamics)
+  std::vector<TooN::Vector<6>> body_acc_bias;
+
+  //! body_inertia*joint_motion of each joint (forward dynamics)
+  std::vector<TooN::Vector<6>> joint_inertia_force;
+
+  //! Articulated inertia seen by each joint (forward dynamics)
+  std::vector<double> joint_inertia;
+
+  //! Bias torque of each joint (forward dynamics)
+  std::vector<double> joint_bias_torque;
+
+  /*======CONSTRUCTORS======*/
+
+  /*!
+      Construct a workspace for a robot with num_joints joints
+  */
+  explicit KinematicsWorkspace(int num_joints);
+
+  /*======END CONSTRUCTORS======*/
+
+  /*!
+      get number of joints
+  */
+  int getNumJoints() const;
+};
+
+}  // namespace sun
+
+#endif
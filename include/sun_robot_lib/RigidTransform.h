@@ -0,0 +1,217 @@
+/*
+
+    Rigid Transform Class
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RIGIDTRANSFORM_H
+#define RIGIDTRANSFORM_H
+
+#include "TooN/TooN.h"
+
+namespace sun
+{
+//! Rigid transformation (rotation + translation), i.e. an homogeneous matrix without the constant row [0 0 0 1]
+/*!
+    The products are computed on the 3x4 affine part only:
+    a composition costs 36 multiplications instead of the 64 of a Matrix<4,4> product.
+    All the functions are inline, they are used in the inner loop of the kinematic chain.
+*/
+class RigidTransform
+{
+public:
+  //! Rotation part
+  TooN::Matrix<3, 3> R;
+
+  //! Translation part
+  TooN::Vector<3> p;
+
+  /*======CONSTRUCTORS======*/
+
+  /*!
+      Identity transformation
+  */
+  RigidTransform() : R(TooN::Identity), p(TooN::Zeros)
+  {
+  }
+
+  /*!
+      Constructor from rotation and translation
+  */
+  RigidTransform(const TooN::Matrix<3, 3>& R_, const TooN::Vector<3>& p_) : R(R_), p(p_)
+  {
+  }
+
+  /*!
+      Constructor from an homogeneous matrix (the last row is ignored)
+  */
+  explicit RigidTransform(const TooN::Matrix<4, 4>& T)
+  {
+    for (int r = 0; r < 3; r++)
+    {
+      R(r, 0) = T(r, 0);
+      R(r, 1) = T(r, 1);
+      R(r, 2) = T(r, 2);
+      p[r] = T(r, 3);
+    }
+  }
+
+  /*======END CONSTRUCTORS======*/
+
+  /*!
+      Write the homogeneous matrix into T
+  */
+  void toMatrix(TooN::Matrix<4, 4>& T) const
+  {
+    for (int r = 0; r < 3; r++)
+    {
+      T(r, 0) = R(r, 0);
+      T(r, 1) = R(r, 1);
+      T(r, 2) = R(r, 2);
+      T(r, 3) = p[r];
+    }
+    T(3, 0) = 0.0;
+    T(3, 1) = 0.0;
+    T(3, 2) = 0.0;
+    T(3, 3) = 1.0;
+  }
+
+  /*!
+      Return the homogeneous matrix
+  */
+  TooN::Matrix<4, 4> toMatrix() const
+  {
+    TooN::Matrix<4, 4> T;
+    toMatrix(T);
+    return T;
+  }
+
+  /*!
+      Composition this*T
+  */
+  RigidTransform operator*(const RigidTransform& T) const
+  {
+    RigidTransform out;
+    for (int r = 0; r < 3; r++)
+    {
+      const double r0 = R(r, 0);
+      const double r1 = R(r, 1);
+      const double r2 = R(r, 2);
+      out.R(r, 0) = r0 * T.R(0, 0) + r1 * T.R(1, 0) + r2 * T.R(2, 0);
+      out.R(r, 1) = r0 * T.R(0, 1) + r1 * T.R(1, 1) + r2 * T.R(2, 1);
+      out.R(r, 2) = r0 * T.R(0, 2) + r1 * T.R(1, 2) + r2 * T.R(2, 2);
+      out.p[r] = r0 * T.p[0] + r1 * T.p[1] + r2 * T.p[2] + p[r];
+    }
+    return out;
+  }
+
+  /*!
+      Post-multiply: this = this*T
+  */
+  RigidTransform& operator*=(const RigidTransform& T)
+  {
+    *this = (*this) * T;
+    return *this;
+  }
+
+  /*!
+      Post-multiply by the standard DH matrix A(a,alpha,d,theta) given sin and cos of alpha and theta
+      The structure of A is exploited:
+          A = [ ct  -st*ca   st*sa  a*ct ]
+              [ st   ct*ca  -ct*sa  a*st ]
+              [ 0    sa      ca     d    ]
+  */
+  RigidTransform& postMultDH(double a, double sin_alpha, double cos_alpha, double d, double sin_theta,
+                             double cos_theta)
+  {
+    for (int r = 0; r < 3; r++)
+    {
+      const double x = R(r, 0);
+      const double y = R(r, 1);
+      const double z = R(r, 2);
+      // x' = x*ct + y*st,  u = -x*st + y*ct
+      const double xn = x * cos_theta + y * sin_theta;
+      const double u = y * cos_theta - x * sin_theta;
+      R(r, 0) = xn;
+      R(r, 1) = u * cos_alpha + z * sin_alpha;
+      R(r, 2) = z * cos_alpha - u * sin_alpha;
+      p[r] += a * xn + d * z;
+    }
+    return *this;
+  }
+
+  /*!
+      Inverse transformation [ R^T , -R^T*p ]
+  */
+  RigidTransform inverse() const
+  {
+    RigidTransform out;
+    for (int r = 0; r < 3; r++)
+    {
+      out.R(r, 0) = R(0, r);
+      out.R(r, 1) = R(1, r);
+      out.R(r, 2) = R(2, r);
+      out.p[r] = -(R(0, r) * p[0] + R(1, r) * p[1] + R(2, r) * p[2]);
+    }
+    return out;
+  }
+
+  /*!
+      Apply the transformation to the point x: R*x + p
+  */
+  TooN::Vector<3> operator*(const TooN::Vector<3>& x) const
+  {
+    return TooN::makeVector(R(0, 0) * x[0] + R(0, 1) * x[1] + R(0, 2) * x[2] + p[0],
+                            R(1, 0) * x[0] + R(1, 1) * x[1] + R(1, 2) * x[2] + p[1],
+                            R(2, 0) * x[0] + R(2, 1) * x[1] + R(2, 2) * x[2] + p[2]);
+  }
+
+  /*!
+      Apply the rotation only to the vector v: R*v
+  */
+  TooN::Vector<3> rotate(const TooN::Vector<3>& v) const
+  {
+    return TooN::makeVector(R(0, 0) * v[0] + R(0, 1) * v[1] + R(0, 2) * v[2],
+                            R(1, 0) * v[0] + R(1, 1) * v[1] + R(1, 2) * v[2],
+                            R(2, 0) * v[0] + R(2, 1) * v[1] + R(2, 2) * v[2]);
+  }
+
+  /*!
+      Apply the inverse rotation to the vector v: R^T*v
+  */
+  TooN::Vector<3> rotateTranspose(const TooN::Vector<3>& v) const
+  {
+    return TooN::makeVector(R(0, 0) * v[0] + R(1, 0) * v[1] + R(2, 0) * v[2],
+                            R(0, 1) * v[0] + R(1, 1) * v[1] + R(2, 1) * v[2],
+                            R(0, 2) * v[0] + R(1, 2) * v[1] + R(2, 2) * v[2]);
+  }
+
+  /*!
+      Return the z axis (third column of R)
+  */
+  TooN::Vector<3> z() const
+  {
+    return TooN::makeVector(R(0, 2), R(1, 2), R(2, 2));
+  }
+};
+
+}  // namespace sun
+
+#endif
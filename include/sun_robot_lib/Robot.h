@@ -26,33 +26,122 @@
 
 #include <sun_robot_lib/RobotLinkPrismatic.h>
 #include <sun_robot_lib/RobotLinkRevolute.h>
+#include <sun_robot_lib/RigidTransform.h>
+#include <sun_robot_lib/KinematicsWorkspace.h>
+#include <sun_robot_lib/KinematicsCache.h>
+#include <sun_robot_lib/IKine.h>
+#include <sun_robot_lib/CompiledChain.h>
+#include <atomic>
 #include <iomanip>
+#include <memory>
+#include <mutex>
 #include "sun_math_toolbox/PortingFunctions.h"
 #include "sun_math_toolbox/UnitQuaternion.h"
 
+//! Lower bound of the squared damping used in the allocation-free dls, avoids singular (J*J^T) when the error is zero
+#define ROBOT_DLS_MIN_DAMPING_SQ 1.0E-12
+
+//! Distance from the hard joint limits of the iterates of ikine when the joints are clamped
+#define ROBOT_IKINE_LIMIT_MARGIN 1.0E-6
+
+//! Default gravity acceleration [m/s^2], the default gravity vector is [0 0 -ROBOT_GRAVITY_ACCELERATION] in base frame
+#define ROBOT_GRAVITY_ACCELERATION 9.81
+
+//! Minimum distance from the soft joint limits used in grad_fcst_joint_limits, bounds the gradient outside the limits
+#define ROBOT_JOINT_LIMIT_MIN_DISTANCE 1.0E-6
+
 namespace sun
 {
+//! Solver of the DLS step of clik
+enum CLIKSolver
+{
+  CLIK_SOLVER_PINV,     //!< explicit DLS pseudo-inverse (NUM_JOINTx6) and null space projector (NUM_JOINTxNUM_JOINT)
+  CLIK_SOLVER_CHOLESKY  //!< 6x6 Cholesky solves of (J*J^T + damping^2*I), the pseudo-inverse and the projector are
+                        //!< never built
+};
+
+//! Return codes of the real-time safe functions (fkine_rt, jacob_geometric_rt, clik_rt)
+enum RobotRTStatus
+{
+  ROBOT_RT_OK = 0,              //!< success
+  ROBOT_RT_CHAIN_NOT_COMPILED,  //!< a link was modified after the last compilation, call compile() before the loop
+  ROBOT_RT_INVALID_SIZE,        //!< an input/output vector or the workspace has the wrong number of joints
+  ROBOT_RT_NUMERICAL_ERROR      //!< the result is not finite (nan or inf in the inputs)
+};
+
+/*!
+    Return the name of the real-time status (static string, no allocation)
+*/
+inline const char* robotRTStatusToString(RobotRTStatus status)
+{
+  switch (status)
+  {
+    case ROBOT_RT_OK:
+      return "OK";
+    case ROBOT_RT_CHAIN_NOT_COMPILED:
+      return "CHAIN_NOT_COMPILED";
+    case ROBOT_RT_INVALID_SIZE:
+      return "INVALID_SIZE";
+    case ROBOT_RT_NUMERICAL_ERROR:
+      return "NUMERICAL_ERROR";
+  }
+  return "UNKNOWN";
+}
+
+//! Persistent workers of Robot::ikine_multistart (defined in IKineMultiStart.cpp)
+class IKineWorkerPool;
+
 //! The Robot Class
 class Robot
 {
 private:
 protected:
   //! Transformation matrix of link_ w.r.t. base frame
-  TooN::Matrix<4, 4> _b_T_0;  // T_0^b
+  RigidTransform _b_T_0;  // T_0^b
   //! Links
   std::vector<RobotLinkPtr> _links;
   //! Transformation matrix of effector w.r.t. link_n frame
-  TooN::Matrix<4, 4> _n_T_e;  // T_e^n
+  RigidTransform _n_T_e;  // T_e^n
 
   //! Joint speed saturation used in dls for clik
   double _dls_joint_speed_saturation;  // Used in clik
 
+  //! Solver of the DLS step of clik
+  CLIKSolver _clik_solver;
+
+  //! Gravity acceleration vector in base frame (used by the dynamic functions)
+  TooN::Vector<3> _gravity;
+
   //! Name of the robot
   std::string _name;
 
   //! Model of the robot
   std::string _model;
 
+  //! Flattened copy of the links used by the kinematic functions (see compile())
+  mutable CompiledChain _chain;
+
+  //! Sum of the versions of the links when _chain was built (see linksVersion)
+  mutable std::atomic<uint64_t> _chain_links_version;
+
+  //! Protects the rebuild of _chain in the const functions
+  mutable std::mutex _chain_mutex;
+
+  //! If true the DH compose routines of _chain are specialized on the DH pattern of each link (see CompiledChain)
+  bool _specialize_dh_kernels;
+
+  //! Id of the current kinematics, it changes at every modification of links, b_T_0 and n_T_e (see KinematicsCache)
+  mutable uint64_t _kinematics_id;
+
+  //! Workers of ikine_multistart with their clones of the robot, created at the first multi-threaded call
+  //! (not copied by the copy constructor)
+  mutable std::shared_ptr<IKineWorkerPool> _ikine_pool;
+
+  //! Protects the creation of _ikine_pool
+  mutable std::mutex _ikine_pool_mutex;
+
+  friend class IKineWorkerPool;
+
 public:
   /*=========CONSTRUCTORS=========*/
 
@@ -93,6 +182,31 @@ protected:
   */
   static void checkHomog(const TooN::Matrix<4, 4>& M);
 
+  /*!
+      Sum of the versions of the links (see RobotLink::getVersion)
+
+      The versions are unique and increase at every modification of a link, so the sum changes if a link is
+      modified or replaced through the reference returned by getLink
+      This function does not allocate memory
+  */
+  uint64_t linksVersion() const;
+
+  /*!
+      Return true if the compiled chain is up to date with the links
+      This function does not allocate memory
+  */
+  bool isCompiledChainUpToDate() const;
+
+  /*!
+      Build the compiled chain and assign a new kinematics id, _chain_mutex must be locked
+  */
+  void buildCompiledChain() const;
+
+  /*!
+      Assign a new kinematics id, the KinematicsCache filled with the old id will be recomputed
+  */
+  void newKinematicsId() const;
+
 public:
   /*!
       Display robot in smart way
@@ -114,6 +228,21 @@ public:
   */
   virtual double getDLSJointSpeedSaturation() const;
 
+  /*!
+      get the solver of the DLS step of clik
+  */
+  virtual CLIKSolver getCLIKSolver() const;
+
+  /*!
+      get the gravity acceleration vector in base frame
+  */
+  virtual TooN::Vector<3> getGravity() const;
+
+  /*!
+      get true if the DH compose routines of the compiled chain are specialized on the DH pattern of each link
+  */
+  virtual bool getDHKernelSpecialization() const;
+
   /*!
       get number of joints
   */
@@ -134,6 +263,10 @@ public:
       get reference of link i
 
       Note: smart_pointer
+      Note: the link can be modified (or replaced) through the reference, the modification is detected by the
+            version of the link and the chain is compiled again by the next kinematic call.
+            Call compile() after the modification if the robot is shared among threads or used by the real-time
+            functions.
   */
   virtual RobotLinkPtr& getLink(int i);
 
@@ -167,6 +300,14 @@ public:
   */
   virtual Robot* clone() const;
 
+  /*!
+      Get the flattened kinematic chain
+
+      The chain is compiled here if a link was modified through the reference returned by getLink
+      (the rebuild is protected by a mutex, concurrent calls on a const Robot are safe)
+  */
+  virtual const CompiledChain& getCompiledChain() const;
+
   /*=========END GETTERS=========*/
 
   /*=========SETTERS=========*/
@@ -176,6 +317,25 @@ public:
   */
   virtual void setDLSJointSpeedSaturation(double dls_joint_speed_saturation);
 
+  /*!
+      set the solver of the DLS step of clik (default CLIK_SOLVER_PINV)
+      CLIK_SOLVER_CHOLESKY computes qpDH = J^T*y with (J*J^T + damping^2*I)*y = vel_e
+      and the null space term as q0_p - J^T*(J*J^T + damping^2*I)^-1*J*q0_p
+  */
+  virtual void setCLIKSolver(CLIKSolver clik_solver);
+
+  /*!
+      set the gravity acceleration vector in base frame (default [0 0 -ROBOT_GRAVITY_ACCELERATION])
+  */
+  virtual void setGravity(const TooN::Vector<3>& gravity);
+
+  /*!
+      set if the DH compose routines of the compiled chain are specialized on the DH pattern of each link
+      (default true), false selects the general routine for all the links (same results, reference for benchmarks
+      and tests). The chain is compiled again by the next kinematic call.
+  */
+  virtual void setDHKernelSpecialization(bool specialize);
+
   /*!
       Set Transformation matrix of link_0 w.r.t. base frame
   */
@@ -221,6 +381,15 @@ public:
   */
   virtual void setModel(const std::string& model);
 
+  /*!
+      Flatten the links into the compiled chain (contiguous arrays with precomputed constants)
+
+      The chain is compiled by the constructors and by setLinks, push_back_link, pop_back_link and
+      setDHKernelSpecialization. A link modified through the reference returned by getLink is detected by the
+      next kinematic call, that compiles the chain again.
+  */
+  virtual void compile();
+
   /*=========END SETTERS=========*/
 
   /*=========CONVERSIONS=========*/
@@ -311,8 +480,23 @@ protected:
       This function compute the fkine to joint "n_joint" given the last transformation to joint n_joint-1
       - q_DH_j is the joint position of the i-th link
       - b_T_j_1 is the transformation of the link j-1 w.r.t base frame
+
+      Deprecated: kept for the derived classes, the kinematic functions no longer call it
+      (they compose the transformations with the CompiledChain, see getCompiledChain)
+  */
+  [[deprecated("the kinematic functions compose the transformations with the CompiledChain")]] virtual TooN::Matrix<
+      4, 4>
+  fkine_internal(const double& q_DH_j, const TooN::Matrix<4, 4>& b_T_j_1, int n_joint) const;
+
+  /*!
+      Internal fkine to n_joint-th link (see fkine)
   */
-  virtual TooN::Matrix<4, 4> fkine_internal(const double& q_DH_j, const TooN::Matrix<4, 4>& b_T_j_1, int n_joint) const;
+  virtual RigidTransform fkine_rigid(const TooN::Vector<>& q_DH, int n_joint) const;
+
+  /*!
+      Internal fkine_all, the transformations are written into all_T (see fkine_all)
+  */
+  virtual void fkine_all_internal(const TooN::Vector<>& q_DH, int n_joint, std::vector<RigidTransform>& all_T) const;
 
 public:
   /*!
@@ -352,6 +536,51 @@ public:
   */
   virtual std::vector<TooN::Matrix<4, 4>> fkine_all(const TooN::Vector<>& q_DH, int n_joint) const;
 
+  /*!
+      This function computes all the transformation up to the end-effector into the workspace
+
+      The result is ws.all_T = [ b_T_0 , b_T_1, ... , b_T_e ] (size = NUM_JOINT+1)
+      This function does not allocate memory
+  */
+  virtual void fkine_all(const TooN::Vector<>& q_DH, KinematicsWorkspace& ws) const;
+
+protected:
+  /*!
+      Update the frames of the cache to q_DH, starting from the first joint that changed
+  */
+  virtual void updateKinematicsCache(const TooN::Vector<>& q_DH, KinematicsCache& cache) const;
+
+public:
+  /*!
+      Incremental fkine to the end-effector
+
+      Only the links from the first joint that changed w.r.t. the last call with the same cache are recomputed
+      The result is also in cache.b_T_e, the frames in cache.all_T
+      This function does not allocate memory
+  */
+  virtual TooN::Matrix<4, 4> fkine(const TooN::Vector<>& q_DH, KinematicsCache& cache) const;
+
+  /*!
+      Batched fkine to the end-effector (struct-of-arrays layout)
+
+      The configurations are computed in parallel on the SIMD lanes of the CPU (AVX2, SSE2 or scalar fallback)
+
+      Inputs:
+          - q_DH: joint positions, q_DH[j*num_conf + k] is the j-th joint of the k-th configuration
+          - num_conf: number of configurations
+          - num_threads: the batch is split in chunks computed in parallel (1 = calling thread only)
+
+      Outputs:
+          - b_T_e: poses, b_T_e[(r*4+c)*num_conf + k] is the element (r,c) of the k-th pose, r=0,1,2
+                   (the last row is always [0 0 0 1] and it is not stored), size = 12*num_conf
+  */
+  virtual void fkine_batch(const double* q_DH, int num_conf, double* b_T_e, int num_threads = 1) const;
+
+  /*!
+      Name of the kernels used by the batched functions on this CPU ("avx2", "sse2" or "scalar")
+  */
+  static std::string getBatchBackend();
+
   /*========END FKINE=========*/
 
   /*========Jacobians=========*/
@@ -362,14 +591,89 @@ protected:
       The input is a vector of all transformation the considered joints i.e.
       [ b_T_0 , b_T_1, ... , (b_T_j*j_T_f) ] (size = joints+1)
   */
-  virtual TooN::Matrix<3, TooN::Dynamic> jacob_p_internal(const std::vector<TooN::Matrix<4, 4>>& all_T) const;
+  virtual TooN::Matrix<3, TooN::Dynamic> jacob_p_internal(const std::vector<RigidTransform>& all_T) const;
 
   /*!
       Internal computation of the orientation part of the geometric jacobian in the frame {f}
       The input is a vector of all transformation the considered joints i.e.
       [ b_T_0 , b_T_1, ... , (b_T_j*j_T_f) ] (size = joints+1)
   */
-  virtual TooN::Matrix<3, TooN::Dynamic> jacob_o_geometric_internal(const std::vector<TooN::Matrix<4, 4>>& all_T) const;
+  virtual TooN::Matrix<3, TooN::Dynamic> jacob_o_geometric_internal(const std::vector<RigidTransform>& all_T) const;
+
+  /*!
+      Deprecated: Matrix<4,4> version of jacob_p_internal, forwards to the RigidTransform version
+      The kinematic functions call the RigidTransform version only, override that one in the derived classes
+  */
+  [[deprecated("use jacob_p_internal(const std::vector<RigidTransform>&)")]] virtual TooN::Matrix<3, TooN::Dynamic>
+  jacob_p_internal(const std::vector<TooN::Matrix<4, 4>>& all_T) const;
+
+  /*!
+      Deprecated: Matrix<4,4> version of jacob_o_geometric_internal, forwards to the RigidTransform version
+      The kinematic functions call the RigidTransform version only, override that one in the derived classes
+  */
+  [[deprecated("use jacob_o_geometric_internal(const std::vector<RigidTransform>&)")]] virtual TooN::Matrix<
+      3, TooN::Dynamic>
+  jacob_o_geometric_internal(const std::vector<TooN::Matrix<4, 4>>& all_T) const;
+
+  /*!
+      Internal computation of the full geometric jacobian in the frame {f}
+      Position and orientation columns are filled in a single loop over the frames
+      The input is a vector of all transformation the considered joints i.e.
+      [ b_T_0 , b_T_1, ... , (b_T_j*j_T_f) ] (size = joints+1)
+      J_geo must be already of size 6 x joints
+  */
+  virtual void jacob_geometric_internal(const std::vector<RigidTransform>& all_T,
+                                        TooN::Matrix<6, TooN::Dynamic>& J_geo) const;
+
+  /*!
+      Internal computation of the rows of the geometric jacobian in the frame {f}
+      Only the position rows (if position is true) and the orientation rows (if orientation is true) are computed,
+      the other rows of J_geo are set to zero
+      J_geo must be already of size 6 x joints
+  */
+  virtual void jacob_geometric_internal(const std::vector<RigidTransform>& all_T, bool position, bool orientation,
+                                        TooN::Matrix<6, TooN::Dynamic>& J_geo) const;
+
+  /*!
+      Internal computation of the columns of the active joints of the geometric jacobian in the frame {f}
+      joint_mask[i] is false if the i-th joint is locked, the column of a locked joint is set to zero
+      J_geo must be already of size 6 x joints
+  */
+  virtual void jacob_geometric_internal(const std::vector<RigidTransform>& all_T, const std::vector<bool>& joint_mask,
+                                        TooN::Matrix<6, TooN::Dynamic>& J_geo) const;
+
+  /*!
+      Internal computation of the velocities of the frames given the frames all_T and the joint velocities
+      The input is a vector of all transformation [ b_T_0 , b_T_1, ... , b_T_e ] (size = joints+1)
+      axis_dot[i] is the time derivative of the axis z_i of all_T[i] (size = joints)
+      origin_dot[i] is the velocity of the origin of all_T[i] (size = joints+1, origin_dot.back() is the velocity of p_e)
+  */
+  virtual void frames_velocity_internal(const std::vector<RigidTransform>& all_T, const TooN::Vector<>& qDH_dot,
+                                        std::vector<TooN::Vector<3>>& axis_dot,
+                                        std::vector<TooN::Vector<3>>& origin_dot) const;
+
+  /*!
+      Internal computation of the time derivative of the geometric jacobian in the frame {f}
+      axis_dot and origin_dot are the velocities of the frames all_T (see frames_velocity_internal)
+      J_geo_dot must be already of size 6 x joints
+  */
+  virtual void jacob_geometric_dot_internal(const std::vector<RigidTransform>& all_T,
+                                            const std::vector<TooN::Vector<3>>& axis_dot,
+                                            const std::vector<TooN::Vector<3>>& origin_dot,
+                                            TooN::Matrix<6, TooN::Dynamic>& J_geo_dot) const;
+
+  /*!
+      Internal computation of the drift term J_geo_dot*qDH_dot in the frame {f}
+      This is the acceleration [linear; angular] of the frame {f} for zero joint accelerations,
+      computed in a single forward recursion over the frames all_T (J_geo_dot is not formed)
+  */
+  virtual TooN::Vector<6> jacob_geometric_dot_qdot_internal(const std::vector<RigidTransform>& all_T,
+                                                            const TooN::Vector<>& qDH_dot) const;
+
+  /*!
+      Check the sizes of the inputs of the jacobian derivative functions, exit on error
+  */
+  void checkJacobDotSizes(const char* function_name, const TooN::Vector<>& q_DH, const TooN::Vector<>& qDH_dot) const;
 
 public:
   /*!
@@ -435,6 +739,64 @@ public:
   */
   virtual TooN::Matrix<6, TooN::Dynamic> jacob_geometric(const TooN::Vector<>& q_DH) const;
 
+  /*!
+      Compute the geometric jacobian in frame {end-effector} w.r.t. base frame into the workspace
+
+      The result is ws.jacob, also ws.all_T is updated (ws.all_T.back() is b_T_e)
+      This function does not allocate memory
+  */
+  virtual const TooN::Matrix<6, TooN::Dynamic>& jacob_geometric(const TooN::Vector<>& q_DH,
+                                                                KinematicsWorkspace& ws) const;
+
+  /*!
+      Compute the geometric jacobian in frame {end-effector} w.r.t. base frame into the workspace,
+      only the columns of the active joints
+
+      joint_mask: joint_mask[i] is false if the i-th joint is locked, the column of a locked joint is zero
+      The result is ws.jacob, also ws.all_T is updated (ws.all_T.back() is b_T_e)
+      This function does not allocate memory
+  */
+  virtual const TooN::Matrix<6, TooN::Dynamic>& jacob_geometric(const TooN::Vector<>& q_DH,
+                                                                const std::vector<bool>& joint_mask,
+                                                                KinematicsWorkspace& ws) const;
+
+  /*!
+      Incremental geometric jacobian in frame {end-effector} w.r.t. base frame
+
+      The frames are updated as in the incremental fkine, the columns of the unchanged joints are reused
+      (only their position part is updated to the new end-effector position).
+      The result is cache.jacob, also cache.b_T_e is updated
+      This function does not allocate memory
+  */
+  virtual const TooN::Matrix<6, TooN::Dynamic>& jacob_geometric(const TooN::Vector<>& q_DH,
+                                                                KinematicsCache& cache) const;
+
+  /*!
+      Fused fkine and geometric jacobian in frame {end-effector} w.r.t. base frame
+
+      The kinematic chain is traversed only once, the frames are shared between the fkine and the jacobian
+
+      Outputs:
+          - return: geometric jacobian (6 x NUM_JOINT)
+          - b_T_e: end-effector pose
+          - all_T: all the transformations [ b_T_0 , b_T_1, ... , b_T_e ] (size = NUM_JOINT+1)
+  */
+  virtual TooN::Matrix<6, TooN::Dynamic> fkine_jacob_geometric(const TooN::Vector<>& q_DH,
+                                                               // Return Vars
+                                                               TooN::Matrix<4, 4>& b_T_e,
+                                                               std::vector<TooN::Matrix<4, 4>>& all_T) const;
+
+  /*!
+      Fused fkine and geometric jacobian in frame {end-effector} w.r.t. base frame
+
+      Outputs:
+          - return: geometric jacobian (6 x NUM_JOINT)
+          - b_T_e: end-effector pose
+  */
+  virtual TooN::Matrix<6, TooN::Dynamic> fkine_jacob_geometric(const TooN::Vector<>& q_DH,
+                                                               // Return Vars
+                                                               TooN::Matrix<4, 4>& b_T_e) const;
+
   /*!
       Ginven the jacobian b_J in frame {b} and the rotation matrix u_R_b of frame {b} w.r.t. frame {u},
       compute the jacobian w.r.t frame {u} (pag 113)
@@ -442,10 +804,134 @@ public:
   */
   static TooN::Matrix<> change_jacob_frame(TooN::Matrix<> b_J, const TooN::Matrix<3, 3>& u_R_b);
 
+  /*!
+      Compute the time derivative of the geometric jacobian in frame {end-effector} w.r.t. base frame
+
+      The columns are computed analytically in O(NUM_JOINT) from the frames of fkine_all
+      and the velocities of the joint axes and of the frame origins
+
+      Inputs:
+          - q_DH, qDH_dot: joint positions and velocities (DH convention)
+  */
+  virtual TooN::Matrix<6, TooN::Dynamic> jacob_geometric_dot(const TooN::Vector<>& q_DH,
+                                                             const TooN::Vector<>& qDH_dot) const;
+
+  /*!
+      Compute the time derivative of the geometric jacobian in frame {end-effector} w.r.t. base frame
+      into the workspace
+
+      The result is ws.jacob_dot, also ws.all_T (as fkine_all), ws.jacob, ws.joint_axis_dot and ws.joint_origin_dot
+      are updated
+      This function does not allocate memory
+  */
+  virtual const TooN::Matrix<6, TooN::Dynamic>& jacob_geometric_dot(const TooN::Vector<>& q_DH,
+                                                                    const TooN::Vector<>& qDH_dot,
+                                                                    KinematicsWorkspace& ws) const;
+
+  /*!
+      Compute the drift term J_dot*qDH_dot of the geometric jacobian in frame {end-effector} w.r.t. base frame
+
+      This is the end-effector acceleration [linear; angular] for zero joint accelerations,
+      it is cheaper than jacob_geometric_dot(q_DH, qDH_dot)*qDH_dot
+  */
+  virtual TooN::Vector<6> jacob_geometric_dot_qdot(const TooN::Vector<>& q_DH, const TooN::Vector<>& qDH_dot) const;
+
+  /*!
+      Compute the drift term J_dot*qDH_dot of the geometric jacobian in frame {end-effector} w.r.t. base frame
+
+      ws.all_T is updated as fkine_all
+      This function does not allocate memory
+  */
+  virtual TooN::Vector<6> jacob_geometric_dot_qdot(const TooN::Vector<>& q_DH, const TooN::Vector<>& qDH_dot,
+                                                   KinematicsWorkspace& ws) const;
+
+  /*!
+      Batched geometric jacobian in frame {end-effector} w.r.t. base frame (struct-of-arrays layout)
+
+      The frames of each configuration are computed once and reused for all the columns,
+      the configurations are computed in parallel on the SIMD lanes (see fkine_batch)
+
+      Inputs:
+          - q_DH: joint positions, q_DH[j*num_conf + k] is the j-th joint of the k-th configuration
+          - num_conf: number of configurations
+          - num_threads: the batch is split in chunks computed in parallel (1 = calling thread only)
+
+      Outputs:
+          - jacob: jacobians, jacob[(r*NUM_JOINT+c)*num_conf + k] is the element (r,c) of the k-th jacobian,
+                   size = 6*NUM_JOINT*num_conf
+          - b_T_e: poses as in fkine_batch, it can be null
+  */
+  virtual void jacob_geometric_batch(const double* q_DH, int num_conf, double* jacob, double* b_T_e = nullptr,
+                                     int num_threads = 1) const;
+
   /*========END Jacobians=========*/
 
   /*========CLIK=========*/
 
+protected:
+  /*!
+      DLS step of the masked clik on the reduced task
+
+      Only the m active rows of the mask are used, the m x m system (J_m*J_m^T + damping^2*I) is
+      solved with a Cholesky factorization (CLIK_SOLVER_CHOLESKY) or inverted to build the explicit DLS pseudo-inverse
+      and null space projector (CLIK_SOLVER_PINV, see setCLIKSolver). The result is the same of the full DLS
+      with the masked rows of jacob, error and veld set to zero.
+
+      Inputs:
+          - error, veld: error and desired velocity (the masked elements are not read)
+          - mask: if the i-th element is 0 the i-th row is not in the task
+          - jacob: geometric jacobian, only the active rows are read
+          - J_pinv_dls, null_proj: storage of CLIK_SOLVER_PINV (NUM_JOINT x 6 and NUM_JOINT x NUM_JOINT),
+            J_pinv_dls is written in its first m columns
+
+      Outputs:
+          - qpDH: joints velocity (must be of size NUM_JOINT)
+      This function does not allocate memory
+  */
+  virtual void clik_masked(const TooN::Vector<6>& error, const TooN::Vector<6>& veld, const TooN::Vector<6, int>& mask,
+                           double gain, double gain_null_space, const TooN::Vector<>& q0_p,
+                           const TooN::Matrix<6, TooN::Dynamic>& jacob, TooN::Matrix<TooN::Dynamic, 6>& J_pinv_dls,
+                           TooN::Matrix<>& null_proj,
+                           // Return Vars
+                           TooN::Vector<>& qpDH) const;
+
+  /*!
+      DLS step of the clik on the reduced task (active rows of mask) in the reduced joint space
+      (active joints of joint_mask, the locked joints have zero velocity)
+
+      With m active rows and n active joints, CLIK_SOLVER_CHOLESKY solves a min(m,n) x min(m,n) system with a
+      Cholesky factorization: (J*J^T + damping^2*I) if m <= n, (J^T*J + damping^2*I) otherwise (same DLS solution).
+      CLIK_SOLVER_PINV builds the explicit DLS pseudo-inverse and null space projector of the active rows and joints
+      into ws.J_pinv_dls and ws.null_proj.
+
+      jacob: geometric jacobian, only the active rows and columns are read
+      Outputs:
+          - qpDH: joints velocity (must be of size NUM_JOINT)
+      This function does not allocate memory
+  */
+  virtual void clik_joint_masked(const TooN::Vector<6>& error, const TooN::Vector<6>& veld,
+                                 const TooN::Vector<6, int>& mask, const std::vector<bool>& joint_mask, double gain,
+                                 double gain_null_space, const TooN::Vector<>& q0_p, KinematicsWorkspace& ws,
+                                 // Return Vars
+                                 TooN::Vector<>& qpDH) const;
+
+  /*!
+      DLS step and integration of the second order clik on the m rows rows[0..m-1] of the task
+
+      The Jacobian calculated in qDH_k has to be in ws.jacob (only the rows in rows are read)
+      and the frames in ws.all_T, see clik_second_order
+      This function does not allocate memory
+  */
+  virtual const TooN::Vector<>& clik_second_order_internal(const TooN::Vector<>& qDH_k, const TooN::Vector<>& qpDH_k,
+                                                           const TooN::Vector<6>& error, const TooN::Vector<6>& veld,
+                                                           const TooN::Vector<6>& accd, const int* rows, int m,
+                                                           double gain_p, double gain_d, double Ts,
+                                                           double gain_null_space, const TooN::Vector<>& q0_p,
+                                                           KinematicsWorkspace& ws,
+                                                           // Return Vars
+                                                           TooN::Vector<>& qpDH_k1, TooN::Vector<>& qppDH) const;
+
+public:
   /*!
       Very General CLIK
       
@@ -502,6 +988,112 @@ public:
                               // Return Vars
                               TooN::Vector<>& qpDH, TooN::Vector<6>& error, UnitQuaternion& newQ);
 
+  /*!
+      Very General CLIK, allocation-free version
+
+      The Jacobian calculated in qDH_k has to be in ws.jacob (use appropriate jacob function here)
+      The DLS pseudo inverse and the null space projector are computed into the workspace
+
+      Inputs:
+          - qDH_k: joints at time k
+          - error: error vector (use the appropriate error type here)
+          - veld: desired velocity
+          - gain: CLIK Gain
+          - Ts: sampling time
+          - gain_null_space: Gain for second objective
+          - q0_dot: velocity to be projected into the null space
+          - ws: workspace
+
+      Outputs:
+          - return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1)
+          - qpDH: joints velocity at time k+1 (must be of size NUM_JOINT)
+  */
+  virtual const TooN::Vector<>& clik(const TooN::Vector<>& qDH_k, const TooN::Vector<6>& error,
+                                     const TooN::Vector<6>& veld, double gain, double Ts, double gain_null_space,
+                                     const TooN::Vector<>& q0_dot, KinematicsWorkspace& ws,
+                                     // Return Vars
+                                     TooN::Vector<>& qpDH);
+
+  /*!
+      Very General CLIK with locked joints, allocation-free version
+
+      Only the active joints of joint_mask move, the problem is solved in the reduced joint space
+      The Jacobian calculated in qDH_k has to be in ws.jacob (use jacob_geometric(q_DH, joint_mask, ws))
+
+      Inputs:
+          - joint_mask: joint_mask[i] is false if the i-th joint is locked
+          - see the version without joint_mask
+
+      Outputs:
+          - return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1), the locked joints are equal to qDH_k
+          - qpDH: joints velocity at time k+1 (must be of size NUM_JOINT), zero for the locked joints
+  */
+  virtual const TooN::Vector<>& clik(const TooN::Vector<>& qDH_k, const TooN::Vector<6>& error,
+                                     const TooN::Vector<6>& veld, double gain, double Ts, double gain_null_space,
+                                     const TooN::Vector<>& q0_dot, const std::vector<bool>& joint_mask,
+                                     KinematicsWorkspace& ws,
+                                     // Return Vars
+                                     TooN::Vector<>& qpDH);
+
+  /*!
+      Clik using Quaternions FULL VERSION, allocation-free version
+
+      Same as the FULL VERSION but all the temporaries are stored in the workspace ws
+
+      Outputs:
+          - return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1)
+          - qpDH: joints velocity at time k+1 (must be of size NUM_JOINT)
+          - error: error vector at time k
+          - newQ: Quaternion at time k (usefull for continuity in the next call of these function)
+  */
+  virtual const TooN::Vector<>& clik(const TooN::Vector<>& qDH_k, const TooN::Vector<3>& pd,
+                                     const UnitQuaternion& Qd, const UnitQuaternion& oldQ,
+                                     const TooN::Vector<3>& dpd, const TooN::Vector<3>& omegad,
+                                     const TooN::Vector<6, int>& mask, double gain, double Ts, double gain_null_space,
+                                     const TooN::Vector<>& q0_p, KinematicsWorkspace& ws,
+                                     // Return Vars
+                                     TooN::Vector<>& qpDH, TooN::Vector<6>& error, UnitQuaternion& newQ);
+
+  /*!
+      Clik using Quaternions FULL VERSION with locked joints, allocation-free version
+
+      Only the active joints of joint_mask move (joint_mask[i] is false if the i-th joint is locked),
+      only the columns of the active joints and the rows of the active operative space coordinates are computed,
+      the problem is solved in the reduced joint space (e.g. orientation with the 3 wrist joints is a 3x3 problem)
+
+      Outputs:
+          - return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1), the locked joints are equal to qDH_k
+          - qpDH: joints velocity at time k+1 (must be of size NUM_JOINT), zero for the locked joints
+          - error: error vector at time k
+          - newQ: Quaternion at time k (usefull for continuity in the next call of these function)
+  */
+  virtual const TooN::Vector<>& clik(const TooN::Vector<>& qDH_k, const TooN::Vector<3>& pd,
+                                     const UnitQuaternion& Qd, const UnitQuaternion& oldQ,
+                                     const TooN::Vector<3>& dpd, const TooN::Vector<3>& omegad,
+                                     const TooN::Vector<6, int>& mask, const std::vector<bool>& joint_mask,
+                                     double gain, double Ts, double gain_null_space, const TooN::Vector<>& q0_p,
+                                     KinematicsWorkspace& ws,
+                                     // Return Vars
+                                     TooN::Vector<>& qpDH, TooN::Vector<6>& error, UnitQuaternion& newQ);
+
+  /*!
+      Clik using Quaternions, allocation-free version
+
+      Same as the version without mask but all the temporaries are stored in the workspace ws
+
+      Outputs:
+          - return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1)
+          - qpDH: joints velocity at time k+1 (must be of size NUM_JOINT)
+          - error: error vector at time k
+          - newQ: Quaternion at time k (usefull for continuity in the next call of these function)
+  */
+  virtual const TooN::Vector<>& clik(const TooN::Vector<>& qDH_k, const TooN::Vector<3>& pd,
+                                     const UnitQuaternion& Qd, const UnitQuaternion& oldQ,
+                                     const TooN::Vector<3>& dpd, const TooN::Vector<3>& omegad, double gain, double Ts,
+                                     double gain_null_space, const TooN::Vector<>& q0_p, KinematicsWorkspace& ws,
+                                     // Return Vars
+                                     TooN::Vector<>& qpDH, TooN::Vector<6>& error, UnitQuaternion& newQ);
+
   /*!
       Clik using Quaternions
 
@@ -597,8 +1189,457 @@ public:
                               // Return Vars
                               TooN::Vector<>& qpDH, TooN::Vector<6>& error, UnitQuaternion& newQ);
 
+  /*!
+      Very General second order (acceleration level) CLIK, allocation-free version
+
+      qppDH = J^#*( accd + gain_d*(veld - J*qpDH_k) + gain_p*error - J_dot*qpDH_k )
+              + (gain_d + gain_null_space)*(I - J^#*J)*(q0_p - qpDH_k)
+      J^# is the DLS pseudo inverse, the damping is computed as in clik from the velocity change qppDH*Ts.
+      The internal motion is always damped by gain_d: if gain_null_space is 0, q0_p is ignored (replaced by zero)
+      and the null space velocity decays to zero, otherwise it converges to q0_p.
+      The joints are integrated assuming a constant acceleration during the sampling time:
+          qDH_k+1 = qDH_k + qpDH_k*Ts + 0.5*qppDH*Ts^2,  qpDH_k+1 = qpDH_k + qppDH*Ts
+
+      The Jacobian calculated in qDH_k has to be in ws.jacob and the frames in ws.all_T
+      (use jacob_geometric(qDH_k, ws)), the drift term J_dot*qpDH_k is computed from the frames ws.all_T
+
+      Inputs:
+          - qDH_k, qpDH_k: joints and joints velocity at time k
+          - error: error vector (use the appropriate error type here)
+          - veld: desired velocity
+          - accd: desired acceleration
+          - gain_p, gain_d: CLIK position and velocity gains
+          - Ts: sampling time
+          - gain_null_space: Gain for second objective (0 = no tracking, the internal motion is only damped)
+          - q0_p: velocity to be tracked into the null space
+          - ws: workspace
+
+      Outputs:
+          - return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1)
+          - qpDH_k1: joints velocity at time k+1 (must be of size NUM_JOINT, it can be qpDH_k)
+          - qppDH: joints acceleration at time k (must be of size NUM_JOINT)
+  */
+  virtual const TooN::Vector<>& clik_second_order(const TooN::Vector<>& qDH_k, const TooN::Vector<>& qpDH_k,
+                                                  const TooN::Vector<6>& error, const TooN::Vector<6>& veld,
+                                                  const TooN::Vector<6>& accd, double gain_p, double gain_d, double Ts,
+                                                  double gain_null_space, const TooN::Vector<>& q0_p,
+                                                  KinematicsWorkspace& ws,
+                                                  // Return Vars
+                                                  TooN::Vector<>& qpDH_k1, TooN::Vector<>& qppDH);
+
+  /*!
+      Second order (acceleration level) Clik using Quaternions FULL VERSION, allocation-free version
+
+      fkine, geometric Jacobian and drift term J_dot*qpDH_k are computed from a single pass over the frames,
+      see the Very General version for the control law and the integration scheme
+
+      Inputs:
+          - qDH_k, qpDH_k: joints and joints velocity at time k
+          - pd, Qd: desired position and quaternion
+          - oldQ: last quaternion at time k-1 (needed for continuity)
+          - dpd, omegad: desired position velocity and angular velocity
+          - ddpd, domegad: desired position acceleration and angular acceleration
+          - mask: bitmask, if the i-th element is 0 then the i-th operative space coordinate will not be used in the
+     error computation
+          - gain_p, gain_d: CLIK position and velocity gains
+          - Ts: sampling time
+          - gain_null_space: Gain for second objective
+          - q0_p: velocity to be tracked into the null space
+          - ws: workspace
+
+      Outputs:
+          - return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1)
+          - qpDH_k1: joints velocity at time k+1 (must be of size NUM_JOINT, it can be qpDH_k)
+          - qppDH: joints acceleration at time k (must be of size NUM_JOINT)
+          - error: error vector at time k
+          - newQ: Quaternion at time k (usefull for continuity in the next call of these function)
+  */
+  virtual const TooN::Vector<>& clik_second_order(
+      const TooN::Vector<>& qDH_k, const TooN::Vector<>& qpDH_k, const TooN::Vector<3>& pd, const UnitQuaternion& Qd,
+      const UnitQuaternion& oldQ, const TooN::Vector<3>& dpd, const TooN::Vector<3>& omegad,
+      const TooN::Vector<3>& ddpd, const TooN::Vector<3>& domegad, const TooN::Vector<6, int>& mask, double gain_p,
+      double gain_d, double Ts, double gain_null_space, const TooN::Vector<>& q0_p, KinematicsWorkspace& ws,
+      // Return Vars
+      TooN::Vector<>& qpDH_k1, TooN::Vector<>& qppDH, TooN::Vector<6>& error, UnitQuaternion& newQ);
+
+  /*!
+      Second order (acceleration level) Clik using Quaternions FULL VERSION
+
+      Same as the allocation-free version, a workspace is allocated at each call
+
+      Outputs:
+          - return: qDH_k+1 joints at time k+1
+          - qpDH_k1: joints velocity at time k+1
+          - qppDH: joints acceleration at time k
+          - error: error vector at time k
+          - newQ: Quaternion at time k (usefull for continuity in the next call of these function)
+  */
+  virtual TooN::Vector<> clik_second_order(const TooN::Vector<>& qDH_k, const TooN::Vector<>& qpDH_k,
+                                           const TooN::Vector<3>& pd, const UnitQuaternion& Qd,
+                                           const UnitQuaternion& oldQ, const TooN::Vector<3>& dpd,
+                                           const TooN::Vector<3>& omegad, const TooN::Vector<3>& ddpd,
+                                           const TooN::Vector<3>& domegad, const TooN::Vector<6, int>& mask,
+                                           double gain_p, double gain_d, double Ts, double gain_null_space,
+                                           const TooN::Vector<>& q0_p,
+                                           // Return Vars
+                                           TooN::Vector<>& qpDH_k1, TooN::Vector<>& qppDH, TooN::Vector<6>& error,
+                                           UnitQuaternion& newQ);
+
   /*========END CLIK=========*/
 
+  /*========IKINE=========*/
+
+protected:
+  /*!
+      Clamp the joints q_DH (DH convention) within the hard joint limits (ROBOT_IKINE_LIMIT_MARGIN inside)
+  */
+  void clampToHardJointLimits(TooN::Vector<>& q_DH) const;
+
+  /*!
+      Iterative inverse kinematics, see ikine
+
+      cancel_internal (may be null) is polled together with options.cancel,
+      ikine_multistart sets it to stop the remaining solves once a solution is accepted
+  */
+  virtual IKineResult ikine_internal(const TooN::Matrix<4, 4>& b_T_e, const TooN::Vector<>& qDH_seed,
+                                     const IKineOptions& options, const std::atomic<bool>* cancel_internal,
+                                     KinematicsWorkspace& ws,
+                                     // Return Vars
+                                     TooN::Vector<>& q_DH) const;
+
+public:
+  /*!
+      Iterative inverse kinematics (Levenberg-Marquardt with adaptive damping)
+
+      Each iteration solves (J*J^T + lambda*I)*y = e, dq = J^T*y with a 6x6 Cholesky factorization,
+      where e is the pose error (position error and rotation vector of the orientation error)
+      and J the geometric jacobian.
+      lambda is decreased after an accepted step (the error norm decreases) and increased after a rejected one,
+      the jacobian is evaluated only after the accepted steps.
+
+      Inputs:
+          - b_T_e: desired end-effector pose
+          - qDH_seed: initial guess in DH convention
+          - options: tolerances, iteration cap, damping and joint clamping (see IKineOptions)
+          - ws: workspace
+
+      Outputs:
+          - return: status, iterations, jacobian evaluations and final error (see IKineResult),
+                    IKINE_INVALID_SIZE if qDH_seed, q_DH or ws are not of size NUM_JOINT
+          - q_DH: solution in DH convention (the best iterate if the status is not IKINE_SUCCESS),
+                  must be of size NUM_JOINT, not modified if the status is IKINE_INVALID_SIZE
+      This function does not allocate memory
+  */
+  virtual IKineResult ikine(const TooN::Matrix<4, 4>& b_T_e, const TooN::Vector<>& qDH_seed,
+                            const IKineOptions& options, KinematicsWorkspace& ws,
+                            // Return Vars
+                            TooN::Vector<>& q_DH) const;
+
+  /*!
+      Iterative inverse kinematics (Levenberg-Marquardt with adaptive damping)
+
+      Same as above, the workspace is allocated internally
+  */
+  virtual IKineResult ikine(const TooN::Matrix<4, 4>& b_T_e, const TooN::Vector<>& qDH_seed,
+                            // Return Vars
+                            TooN::Vector<>& q_DH, const IKineOptions& options = IKineOptions()) const;
+
+  /*!
+      Multi-start inverse kinematics
+
+      The seeds are solved with ikine by num_threads workers: the calling thread and num_threads-1 persistent threads,
+      each one with its own clone() of the robot. The threads and the clones are created at the first call and kept
+      by the robot (the clones are rebuilt if the kinematics changes); if another call is using them,
+      the seeds are solved in the calling thread only.
+      The seeds are taken in order; the first solution within the tolerances and the soft joint limits
+      cancels the remaining solves.
+      options.cancel is polled by all the workers: if it is set before a solution is accepted, the remaining
+      solves are stopped and the status is IKINE_CANCELLED.
+      With num_threads = 1 the seeds are solved sequentially in the calling thread.
+
+      Inputs:
+          - b_T_e: desired end-effector pose
+          - qDH_seeds: seeds in DH convention
+          - options: options of each ikine solve
+          - num_threads: number of workers (1 = calling thread only, at most one worker per seed)
+
+      Outputs:
+          - return: the result of the accepted solve (status IKINE_SUCCESS);
+                    otherwise the result of the solve with the lowest error, with status IKINE_SOFT_LIMITS
+                    if it converged outside the soft joint limits
+          - q_DH: the solution in DH convention, must be of size NUM_JOINT
+          - seed_index: index in qDH_seeds of the returned solution (-1 if cancelled before any completed solve)
+  */
+  virtual IKineResult ikine_multistart(const TooN::Matrix<4, 4>& b_T_e, const std::vector<TooN::Vector<>>& qDH_seeds,
+                                       // Return Vars
+                                       TooN::Vector<>& q_DH, int& seed_index,
+                                       const IKineOptions& options = IKineOptions(), int num_threads = 1) const;
+
+  /*!
+      Multi-start inverse kinematics with random seeds
+
+      The first seed is qDH_seed, the other num_seeds-1 seeds are uniformly distributed within the soft joint limits
+      (generated with std::mt19937 initialized with random_seed). See above.
+      For the joints with infinite soft limits the hard limits are used; if also these are infinite,
+      the joint of the seeds is the one of qDH_seed.
+  */
+  virtual IKineResult ikine_multistart(const TooN::Matrix<4, 4>& b_T_e, const TooN::Vector<>& qDH_seed, int num_seeds,
+                                       unsigned int random_seed,
+                                       // Return Vars
+                                       TooN::Vector<>& q_DH, int& seed_index,
+                                       const IKineOptions& options = IKineOptions(), int num_threads = 1) const;
+
+  /*!
+      Trajectory inverse kinematics
+
+      Each sample is solved with ikine, warm-started from the previous solutions
+      (linear extrapolation of the last two samples, the previous sample if the extrapolated seed fails).
+      The orientation error of ikine is always the shortest rotation, so the solutions are continuous
+      also when the quaternion of the path changes sign.
+      With num_threads > 1 the path is split in segments solved in parallel (each worker on its own clone()),
+      the first sample of each segment is seeded by a coarse sequential pass over the path;
+      at the boundaries the segments are stitched, in order: the first sample of each segment is solved again
+      from the final samples of the previous segment (as in the sequential solve); if this solution fails or is
+      not on the same branch, or a sample of the segment failed, the segment is solved again sequentially.
+
+      Inputs:
+          - b_T_e: poses of the path
+          - Ts: sampling time (used for the velocities)
+          - qDH_seed: seed of the first sample in DH convention
+          - options: options of each ikine solve
+          - num_threads: number of segments solved in parallel (1 = calling thread only)
+
+      Outputs:
+          - return: number of samples that did not converge within the tolerances
+          - q_DH: joint positions, q_DH[k*NUM_JOINT + j] is the j-th joint of the k-th sample,
+                  size = NUM_JOINT*b_T_e.size()
+          - qDH_dot: joint velocities (backward differences, zero for the first sample), same layout of q_DH
+          - error: error[2*k] and error[2*k+1] are the position and orientation error norms of the k-th sample,
+                   size = 2*b_T_e.size()
+  */
+  virtual int ikine_trajectory(const std::vector<TooN::Matrix<4, 4>>& b_T_e, double Ts, const TooN::Vector<>& qDH_seed,
+                               // Return Vars
+                               double* q_DH, double* qDH_dot, double* error,
+                               const IKineOptions& options = IKineOptions(), int num_threads = 1) const;
+
+  /*========END IKINE=========*/
+
+  /*========REAL-TIME=========*/
+
+  /*
+      Real-time safe versions of fkine, jacobian and clik
+
+      These functions never allocate memory, never print and never call exit():
+      a failure is reported by the returned RobotRTStatus and the outputs are not valid.
+      The kinematic chain is compiled by the constructors and by the functions that modify the links. If a link is
+      modified through the reference returned by getLink, call compile() before the real-time loop:
+      the chain is never compiled by these functions.
+  */
+
+protected:
+  /*!
+      Check the preconditions of the real-time functions: compiled chain and sizes of q_DH and ws
+  */
+  RobotRTStatus checkRT(const TooN::Vector<>& q_DH, const KinematicsWorkspace& ws) const;
+
+public:
+  /*!
+      Real-time safe fkine of all the frames
+
+      The result is ws.all_T = [ b_T_0 , b_T_1, ... , b_T_e ] (size = NUM_JOINT+1)
+  */
+  virtual RobotRTStatus fkine_rt(const TooN::Vector<>& q_DH, KinematicsWorkspace& ws) const;
+
+  /*!
+      Real-time safe geometric jacobian in frame {end-effector} w.r.t. base frame
+
+      The result is ws.jacob, also ws.all_T is updated (ws.all_T.back() is b_T_e)
+  */
+  virtual RobotRTStatus jacob_geometric_rt(const TooN::Vector<>& q_DH, KinematicsWorkspace& ws) const;
+
+  /*!
+      Real-time safe clik using Quaternions FULL VERSION
+
+      Same inputs of the FULL VERSION of clik with the workspace
+
+      Outputs:
+          - return: ROBOT_RT_OK on success
+          - ws.qDH_k1: joints at time k+1
+          - qpDH: joints velocity at time k+1 (must be of size NUM_JOINT)
+          - error: error vector at time k
+          - newQ: Quaternion at time k (usefull for continuity in the next call of these function)
+  */
+  virtual RobotRTStatus clik_rt(const TooN::Vector<>& qDH_k, const TooN::Vector<3>& pd, const UnitQuaternion& Qd,
+                                const UnitQuaternion& oldQ, const TooN::Vector<3>& dpd, const TooN::Vector<3>& omegad,
+                                const TooN::Vector<6, int>& mask, double gain, double Ts, double gain_null_space,
+                                const TooN::Vector<>& q0_p, KinematicsWorkspace& ws,
+                                // Return Vars
+                                TooN::Vector<>& qpDH, TooN::Vector<6>& error, UnitQuaternion& newQ);
+
+  /*========END REAL-TIME=========*/
+
+  /*========DYNAMICS=========*/
+
+  /*
+      Rigid body dynamics:
+          - inverse dynamics by the recursive Newton-Euler algorithm, O(NUM_JOINT)
+          - mass matrix by the composite rigid body algorithm, O(NUM_JOINT^2)
+          - forward dynamics by the articulated body algorithm, O(NUM_JOINT)
+
+      The dynamic parameters are the ones of the links (RobotLink::setDynamicParameters),
+      the gravity is getGravity(), no external wrench acts on the end-effector.
+      Joint positions, velocities, accelerations and torques are in DH convention
+      (use jointsvel_DH2Robot to transform the torques in robot convention).
+      The workspace versions never allocate memory, they also write the frames ws.all_T as fkine_all.
+  */
+
+protected:
+  /*!
+      Frames of the links [ b_T_0 , b_T_1, ... , b_T_n ] into ws.all_T
+      The last frame is b_T_n, the {end-effector} transformation is NOT applied
+  */
+  void fkine_links_internal(const TooN::Vector<>& q_DH, KinematicsWorkspace& ws) const;
+
+  /*!
+      Internal recursive Newton-Euler algorithm
+      The joint velocities (accelerations) are zero if qDH_dot (qDH_dot_dot) is nullptr
+      The net force and moment of each link are left in ws.link_force and ws.link_moment
+      tau must be of size NUM_JOINT
+  */
+  void rnea_internal(const TooN::Vector<>& q_DH, const TooN::Vector<>* qDH_dot, const TooN::Vector<>* qDH_dot_dot,
+                     const TooN::Vector<3>& gravity, KinematicsWorkspace& ws,
+                     // Return Vars
+                     TooN::Vector<>& tau) const;
+
+  /*!
+      Check the sizes of the inputs of the dynamic functions, print an error and exit if they are wrong
+      qDH_dot and qDH_dot_dot are not checked if nullptr
+  */
+  void checkDynamicsSizes(const char* function_name, const TooN::Vector<>& q_DH, const TooN::Vector<>* qDH_dot,
+                          const TooN::Vector<>* qDH_dot_dot, const KinematicsWorkspace& ws,
+                          const TooN::Vector<>& tau) const;
+
+public:
+  /*!
+      Inverse dynamics: joint torques tau = B(q)*qdd + C(q,qd)*qd + g(q)
+
+      Inputs:
+          - q_DH, qDH_dot, qDH_dot_dot: joint positions, velocities and accelerations (DH convention)
+  */
+  virtual TooN::Vector<> inverseDynamics(const TooN::Vector<>& q_DH, const TooN::Vector<>& qDH_dot,
+                                         const TooN::Vector<>& qDH_dot_dot) const;
+
+  /*!
+      Inverse dynamics using the workspace (no allocation)
+
+      Outputs:
+          - tau: joint torques, must be of size NUM_JOINT
+  */
+  virtual void inverseDynamics(const TooN::Vector<>& q_DH, const TooN::Vector<>& qDH_dot,
+                               const TooN::Vector<>& qDH_dot_dot, KinematicsWorkspace& ws,
+                               // Return Vars
+                               TooN::Vector<>& tau) const;
+
+  /*!
+      Gravity torques g(q)
+      Computed from the total mass and the first moment of mass of the subchains, cheaper than the full RNEA
+  */
+  virtual TooN::Vector<> gravityTorques(const TooN::Vector<>& q_DH) const;
+
+  /*!
+      Gravity torques g(q) using the workspace (no allocation)
+
+      Outputs:
+          - tau: joint torques, must be of size NUM_JOINT
+  */
+  virtual void gravityTorques(const TooN::Vector<>& q_DH, KinematicsWorkspace& ws,
+                              // Return Vars
+                              TooN::Vector<>& tau) const;
+
+  /*!
+      Coriolis and centrifugal torques C(q,qd)*qd (no gravity, zero accelerations)
+  */
+  virtual TooN::Vector<> coriolisTorques(const TooN::Vector<>& q_DH, const TooN::Vector<>& qDH_dot) const;
+
+  /*!
+      Coriolis and centrifugal torques C(q,qd)*qd using the workspace (no allocation)
+
+      Outputs:
+          - tau: joint torques, must be of size NUM_JOINT
+  */
+  virtual void coriolisTorques(const TooN::Vector<>& q_DH, const TooN::Vector<>& qDH_dot, KinematicsWorkspace& ws,
+                               // Return Vars
+                               TooN::Vector<>& tau) const;
+
+  /*!
+      Joint space mass matrix B(q) by the composite rigid body algorithm
+  */
+  virtual TooN::Matrix<> massMatrix(const TooN::Vector<>& q_DH) const;
+
+  /*!
+      Joint space mass matrix B(q) using the workspace (no allocation)
+
+      Outputs:
+          - B: mass matrix, must be of size NUM_JOINT x NUM_JOINT
+  */
+  virtual void massMatrix(const TooN::Vector<>& q_DH, KinematicsWorkspace& ws,
+                          // Return Vars
+                          TooN::Matrix<>& B) const;
+
+  /*!
+      Forward dynamics: joint accelerations qdd = B(q)^-1*( tau - C(q,qd)*qd - g(q) )
+      by the articulated body algorithm, O(NUM_JOINT)
+      ERROR IF the mass matrix is singular (e.g. massless distal links)
+
+      Inputs:
+          - q_DH, qDH_dot: joint positions and velocities (DH convention)
+          - tau: joint torques (DH convention)
+  */
+  virtual TooN::Vector<> forwardDynamics(const TooN::Vector<>& q_DH, const TooN::Vector<>& qDH_dot,
+                                         const TooN::Vector<>& tau) const;
+
+  /*!
+      Forward dynamics using the workspace (no allocation)
+
+      Outputs:
+          - qDH_dot_dot: joint accelerations, must be of size NUM_JOINT
+  */
+  virtual void forwardDynamics(const TooN::Vector<>& q_DH, const TooN::Vector<>& qDH_dot, const TooN::Vector<>& tau,
+                               KinematicsWorkspace& ws,
+                               // Return Vars
+                               TooN::Vector<>& qDH_dot_dot) const;
+
+  /*!
+      Batched mass matrix (struct-of-arrays layout, see fkine_batch)
+
+      Inputs:
+          - q_DH: joint positions, q_DH[j*num_conf + k] is the j-th joint of the k-th configuration
+          - num_conf: number of configurations
+          - num_threads: the batch is split in chunks computed in parallel (1 = calling thread only)
+
+      Outputs:
+          - B: mass matrices, B[(r*NUM_JOINT+c)*num_conf + k] is the element (r,c) of the k-th matrix,
+               size = NUM_JOINT*NUM_JOINT*num_conf
+  */
+  virtual void massMatrix_batch(const double* q_DH, int num_conf, double* B, int num_threads = 1) const;
+
+  /*!
+      Batched forward dynamics (struct-of-arrays layout, see fkine_batch)
+
+      Inputs:
+          - q_DH, qDH_dot, tau: joint positions, velocities and torques,
+                                q_DH[j*num_conf + k] is the j-th joint of the k-th configuration
+          - num_conf: number of configurations
+          - num_threads: the batch is split in chunks computed in parallel (1 = calling thread only)
+
+      Outputs:
+          - qDH_dot_dot: joint accelerations, same layout of the inputs, size = NUM_JOINT*num_conf
+  */
+  virtual void forwardDynamics_batch(const double* q_DH, const double* qDH_dot, const double* tau, int num_conf,
+                                     double* qDH_dot_dot, int num_threads = 1) const;
+
+  /*========END DYNAMICS=========*/
+
   /*====== COST FUNCTIONS FOR NULL SPACE ======*/
 
   /*!
@@ -613,6 +1654,76 @@ public:
                                                         const TooN::Vector<>& desired_configuration,
                                                         const TooN::Vector<>& desired_configuration_joint_weights);
 
+protected:
+  /*!
+      Internal manipulability sqrt(det(J*J^T)) (sqrt(det(J^T*J)) if NUM_JOINT < 6) of the jacobian ws.jacob
+
+      If J_pinv is not null the pseudo inverse of ws.jacob is written into it (NUM_JOINT x 6, undefined if singular)
+      Return 0 if ws.jacob is singular
+      This function does not allocate memory
+  */
+  double manipulability_internal(const KinematicsWorkspace& ws, TooN::Matrix<TooN::Dynamic, 6>* J_pinv) const;
+
+public:
+  /*!
+      Manipulability measure sqrt(det(J*J^T)) of the geometric jacobian in frame {end-effector}
+      (sqrt(det(J^T*J)) if NUM_JOINT < 6)
+  */
+  virtual double manipulability(const TooN::Vector<>& q_DH) const;
+
+  /*!
+      Manipulability measure of the geometric jacobian in frame {end-effector}, allocation-free version
+
+      ws.all_T and ws.jacob are updated as in jacob_geometric(q_DH, ws)
+  */
+  virtual double manipulability(const TooN::Vector<>& q_DH, KinematicsWorkspace& ws) const;
+
+  /*!
+      Gradient of the manipulability measure, to maximize the manipulability (use it as q0_p of clik)
+
+      d(w)/d(q_k) = w*trace( J^# * d(J)/d(q_k) ), the columns d(J)/d(q_k) (kinematic hessian) are never formed:
+      the sums over the joints are accumulated in a backward and a forward pass over the frames, O(NUM_JOINT)
+      The gradient is zero in a singular configuration
+
+      Inputs:
+          -q_DH: joint positions
+  */
+  virtual TooN::Vector<> grad_fcst_manipulability(const TooN::Vector<>& q_DH) const;
+
+  /*!
+      Gradient of the manipulability measure, allocation-free version
+
+      Outputs:
+          - return: manipulability measure
+          - grad: gradient (must be of size NUM_JOINT)
+      ws.all_T and ws.jacob are updated as in jacob_geometric(q_DH, ws), ws.J_pinv_dls is the pseudo inverse of ws.jacob
+  */
+  virtual double grad_fcst_manipulability(const TooN::Vector<>& q_DH, KinematicsWorkspace& ws,
+                                          // Return Vars
+                                          TooN::Vector<>& grad) const;
+
+  /*!
+      Gradient of cost function to maximize the distance from the soft joint limits (use it as q0_p of clik)
+
+      The cost is sum_i (qM_i - qm_i)^2 / ( 4*(qM_i - q_i)*(q_i - qm_i) ), it is 1 at the center of the joint
+      and it goes to infinity at the limits. The opposite of its gradient is returned,
+      the joints with infinite limits have zero gradient.
+
+      Inputs:
+          -q_DH: joint positions
+  */
+  virtual TooN::Vector<> grad_fcst_joint_limits(const TooN::Vector<>& q_DH) const;
+
+  /*!
+      Gradient of cost function to maximize the distance from the soft joint limits, allocation-free version
+
+      Outputs:
+          - grad: gradient (must be of size NUM_JOINT)
+  */
+  virtual void grad_fcst_joint_limits(const TooN::Vector<>& q_DH,
+                                      // Return Vars
+                                      TooN::Vector<>& grad) const;
+
   /*====== END COST FUNCTIONS FOR NULL SPACE ======*/
 
 };  // END CLASS
@@ -24,6 +24,7 @@
 #ifndef ROBOTLINK_H
 #define ROBOTLINK_H
 
+#include <cstdint>
 #include <memory>
 #include "TooN/TooN.h"
 
@@ -60,8 +61,22 @@ protected:
   double _soft_velocity_limit;                               // Hard Velocity Limits in Robot convention
   //////////////////////////////////////////////
 
+  // Dynamic parameters (expressed in the DH frame of the link, i.e. the frame {i} moved by the joint i)
+  double _mass;                 // link mass
+  TooN::Vector<3> _com;         // center of mass
+  TooN::Matrix<3, 3> _inertia;  // inertia tensor w.r.t. the center of mass
+  //////////////////////////////////////////////
+
   std::string _name;  // joint name
 
+  //! Version of the parameters, a new (unique) value is assigned at every modification (see getVersion)
+  uint64_t _version;
+
+  /*!
+      Assign a new version, call this in every function that modifies the parameters
+  */
+  void newVersion();
+
   /*======CONSTRUCTORS======*/
 
   //! Full Constructor
@@ -150,6 +165,30 @@ public:
   */
   virtual std::string getName() const;
 
+  /*!
+      Return the link mass
+  */
+  virtual double getMass() const;
+
+  /*!
+      Return the center of mass of the link in the link frame
+  */
+  virtual TooN::Vector<3> getCOM() const;
+
+  /*!
+      Return the inertia tensor of the link w.r.t. the center of mass, in the link frame
+  */
+  virtual TooN::Matrix<3, 3> getInertia() const;
+
+  /*!
+      Return the version of the parameters
+
+      A new value, unique among all the links, is assigned by the constructors and by every setter
+      (a clone has the same version of the original link). Used by Robot to detect the modification
+      of a link made through the reference returned by Robot::getLink
+  */
+  uint64_t getVersion() const;
+
   /*!
       Clone the object
   */
@@ -226,6 +265,28 @@ public:
   */
   virtual void setName(const std::string& name);
 
+  /*!
+      Set the link mass
+      ERROR IF mass < 0
+  */
+  virtual void setMass(double mass);
+
+  /*!
+      Set the center of mass of the link in the link frame
+  */
+  virtual void setCOM(const TooN::Vector<3>& com);
+
+  /*!
+      Set the inertia tensor of the link w.r.t. the center of mass, in the link frame
+      ERROR IF the tensor is not symmetric
+  */
+  virtual void setInertia(const TooN::Matrix<3, 3>& inertia);
+
+  /*!
+      Set all the dynamic parameters of the link (see setMass, setCOM and setInertia)
+  */
+  virtual void setDynamicParameters(double mass, const TooN::Vector<3>& com, const TooN::Matrix<3, 3>& inertia);
+
   //======END SETTERS===========//
 
   /*!
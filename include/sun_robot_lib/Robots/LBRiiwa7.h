@@ -25,6 +25,7 @@
 #define ROBOTLBRIIWA7_H
 
 #include "sun_robot_lib/Robot.h"
+#include "sun_robot_lib/FixedRobot.h"
 
 #define LBRIIWA7_MODEL_STR "LBRiiwa7"
 
@@ -47,6 +48,70 @@ public:
       Empty constructor
   */
   LBRiiwa7();
+
+protected:
+  /*!
+      Check that the kinematic chain still has the structure required by the analytic inverse kinematics
+      (spherical shoulder and wrist, a=0), print an error and exit otherwise
+  */
+  void checkIKineStructure() const;
+
+public:
+  /*!
+      Analytic inverse kinematics with the arm angle parametrization
+
+      The arm angle is the rotation of the plane (shoulder, elbow, wrist) about the shoulder-wrist axis,
+      measured from the reference plane obtained with q3 = 0.
+
+      Inputs:
+          - b_T_e: desired end-effector pose
+          - arm_angle: arm angle [rad]
+
+      Outputs:
+          - return: number of solutions within the hard joint limits
+          - q_DH_solutions: the 8 branch solutions in DH convention (empty if the pose is out of the workspace)
+                            the branches are ordered as (sign(q4), sign(q2), sign(q6)) = (+,+,+), (+,+,-), ...
+          - in_limits: in_limits[i] is true if q_DH_solutions[i] is within the hard joint limits
+  */
+  virtual int ikine_analytic(const TooN::Matrix<4, 4>& b_T_e, double arm_angle,
+                             // Return Vars
+                             std::vector<TooN::Vector<>>& q_DH_solutions, std::vector<bool>& in_limits) const;
+
+  /*!
+      Analytic inverse kinematics with the arm angle parametrization, solution nearest to the seed
+
+      Inputs:
+          - b_T_e: desired end-effector pose
+          - arm_angle: arm angle [rad] (use arm_angle(qDH_seed) to keep the current one)
+          - qDH_seed: seed configuration in DH convention
+
+      Outputs:
+          - return: false if no solution is within the hard joint limits (q_DH is not modified)
+          - q_DH: the solution within the hard joint limits nearest to qDH_seed
+  */
+  virtual bool ikine_analytic(const TooN::Matrix<4, 4>& b_T_e, double arm_angle, const TooN::Vector<>& qDH_seed,
+                              // Return Vars
+                              TooN::Vector<>& q_DH) const;
+
+  /*!
+      Arm angle of the configuration q_DH (see ikine_analytic)
+  */
+  virtual double arm_angle(const TooN::Vector<>& q_DH) const;
+};
+
+//! Fixed-size kinematic engine of the LBRiiwa7 (7 revolute joints)
+class LBRiiwa7Fixed : public FixedRobot<7>
+{
+public:
+  /*!
+      Full constructor
+  */
+  LBRiiwa7Fixed(const TooN::Matrix<4, 4>& n_T_e, double dls_joint_speed_saturation);
+
+  /*!
+      Empty constructor
+  */
+  LBRiiwa7Fixed();
 };
 
 }  // namespace sun
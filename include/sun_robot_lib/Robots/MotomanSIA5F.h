@@ -25,9 +25,16 @@
 #define ROBOTMOTOMANSIA5F_H
 
 #include "sun_robot_lib/Robot.h"
+#include "sun_robot_lib/FixedRobot.h"
 
 #define MOTOMANSIA5F_MODEL_STR "MotomanSIA5F"
 
+//! Default number of samples of q3 used by the 1-D search of the inverse kinematics
+#define MOTOMANSIA5F_IK_NUM_SAMPLES 36
+
+//! Max number of branch solutions of the analytic inverse kinematics for a given q3
+#define MOTOMANSIA5F_IK_MAX_SOLUTIONS 8
+
 namespace sun
 {
 class MotomanSIA5F : public Robot
@@ -47,6 +54,89 @@ public:
       Empty constructor
   */
   MotomanSIA5F();
+
+protected:
+  /*!
+      Check that the kinematic chain still has the structure required by the analytic inverse kinematics
+      (spherical shoulder and wrist with elbow offsets), print an error and exit otherwise
+  */
+  void checkIKineStructure() const;
+
+  /*!
+      Analytic inverse kinematics for a given q3, the structure is not checked (see checkIKineStructure)
+
+      Inputs:
+          - T_07: flange pose w.r.t. frame 0
+          - q3_DH: joint 3 (E) in DH convention
+
+      Outputs:
+          - return: number of solutions within the hard joint limits
+          - q_DH_solutions: the first num_solutions elements are the branch solutions in DH convention
+          - in_limits: in_limits[i] is true if q_DH_solutions[i] is within the hard joint limits
+          - num_solutions: number of branch solutions
+
+      This function does not allocate memory
+  */
+  int ikine_analytic_internal(const RigidTransform& T_07, double q3_DH,
+                              // Return Vars
+                              TooN::Vector<7> (&q_DH_solutions)[MOTOMANSIA5F_IK_MAX_SOLUTIONS],
+                              bool (&in_limits)[MOTOMANSIA5F_IK_MAX_SOLUTIONS], int& num_solutions) const;
+
+public:
+  /*!
+      Analytic inverse kinematics for a given value of the redundancy parameter q3
+
+      The wrist distance from the shoulder does not depend on q3: q4 is computed from it,
+      then q1,q2 from the wrist position and q5,q6,q7 from the wrist orientation.
+
+      Inputs:
+          - b_T_e: desired end-effector pose
+          - q3_DH: joint 3 (E) in DH convention
+
+      Outputs:
+          - return: number of solutions within the hard joint limits
+          - q_DH_solutions: the branch solutions in DH convention (up to 8, empty if the pose is not reachable
+                            with this q3), branches (q4, sign(q2), sign(q6))
+          - in_limits: in_limits[i] is true if q_DH_solutions[i] is within the hard joint limits
+  */
+  virtual int ikine_analytic(const TooN::Matrix<4, 4>& b_T_e, double q3_DH,
+                             // Return Vars
+                             std::vector<TooN::Vector<>>& q_DH_solutions, std::vector<bool>& in_limits) const;
+
+  /*!
+      Semi-analytic inverse kinematics (1-D search over q3), solution nearest to the seed
+
+      The analytic solutions are enumerated for q3 = qDH_seed[2] and for num_samples values of q3
+      uniformly distributed within its hard limits.
+      The structure of the chain is checked once per call, the search does not allocate memory
+
+      Inputs:
+          - b_T_e: desired end-effector pose
+          - qDH_seed: seed configuration in DH convention
+          - num_samples: number of samples of q3
+
+      Outputs:
+          - return: false if no solution is within the hard joint limits (q_DH is not modified)
+          - q_DH: the solution within the hard joint limits nearest to qDH_seed
+  */
+  virtual bool ikine_analytic(const TooN::Matrix<4, 4>& b_T_e, const TooN::Vector<>& qDH_seed,
+                              // Return Vars
+                              TooN::Vector<>& q_DH, int num_samples = MOTOMANSIA5F_IK_NUM_SAMPLES) const;
+};
+
+//! Fixed-size kinematic engine of the MotomanSIA5F (7 revolute joints)
+class MotomanSIA5FFixed : public FixedRobot<7>
+{
+public:
+  /*!
+      Full constructor
+  */
+  MotomanSIA5FFixed(const TooN::Matrix<4, 4>& n_T_e, double dls_joint_speed_saturation);
+
+  /*!
+      Empty constructor
+  */
+  MotomanSIA5FFixed();
 };
 
 }  // namespace sun
@@ -0,0 +1,1048 @@
+/*
+
+    Kinematics and CLIK Benchmark
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+    Micro-benchmarks of the kinematic and dynamic functions and end-to-end CLIK cycles on LBRiiwa7 and MotomanSIA5F
+
+    Usage:
+        sun_robot_lib_benchmark [--format=json|csv] [--iterations=N] [--filter=SUBSTRING] [--output=FILE]
+
+    Each benchmark runs a warm-up phase and then N operations on a fixed pool of random inputs
+    (fixed seed, the results are comparable among builds).
+    The N operations are run twice:
+        - throughput: the loop is timed as a whole, ns/op is the total time over the number of operations;
+        - latency: each operation is timed alone, p50 and p99 are the percentiles of the single-op times
+          (they include the cost of one clock read, tens of ns).
+    The allocations are counted by replacing the global operator new (throughput run).
+    The inverse kinematics benchmarks also report the success rate and, for the iterative solvers, the mean number
+    of jacobian evaluations on the pool of inputs (untimed pass), the other benchmarks report null.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "TooN/Cholesky.h"
+#include "sun_robot_lib/ClikController.h"
+#include "sun_robot_lib/Robots/LBRiiwa7.h"
+#include "sun_robot_lib/Robots/MotomanSIA5F.h"
+
+//! Seed of the random inputs
+#define BENCH_SEED 42
+
+//! Number of random inputs of each benchmark
+#define BENCH_POOL_SIZE 256
+
+//! Min number of measured calls of each benchmark
+#define BENCH_MIN_CALLS 64
+
+//! Default number of measured operations
+#define BENCH_DEFAULT_ITERATIONS 20000
+
+//! Number of configurations of the batched benchmarks
+#define BENCH_BATCH_SIZE 1024
+
+//! Max number of seeds of the multi-start benchmarks
+#define BENCH_MULTISTART_MAX_SEEDS 16
+
+//! The multi-start benchmarks run iterations/BENCH_MULTISTART_ITERATIONS_DIVISOR operations (each one is a full search)
+#define BENCH_MULTISTART_ITERATIONS_DIVISOR 100
+
+using namespace TooN;
+using namespace std;
+using namespace sun;
+
+/*=========ALLOCATION COUNTER=========*/
+
+// operator delete is kept out of line: inlined in a new-expression, free() would look mismatched to the compiler
+#ifdef __GNUC__
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+namespace
+{
+atomic<long> allocation_counter(0);
+}
+
+void* operator new(size_t size)
+{
+  allocation_counter.fetch_add(1, memory_order_relaxed);
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr)
+  {
+    throw bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+BENCH_NOINLINE void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+BENCH_NOINLINE void operator delete[](void* p) noexcept
+{
+  free(p);
+}
+
+/*=========END ALLOCATION COUNTER=========*/
+
+namespace
+{
+//! Result of a benchmark
+struct BenchResult
+{
+  string robot;
+  string name;
+  long iterations;
+  double ns_per_op;
+  double allocs_per_op;
+  double p50_ns;
+  double p99_ns;
+  double success_rate;          // negative if not applicable
+  double jacobian_evaluations;  // per op, negative if not applicable
+};
+
+//! Options of the command line
+struct BenchOptions
+{
+  string format = "json";
+  long iterations = BENCH_DEFAULT_ITERATIONS;
+  string filter = "";
+  string output = "";
+};
+
+//! Results are accumulated here to avoid the elimination of the benchmarked calls
+volatile double sink = 0.0;
+
+/*
+    Run a benchmark: op(k) executes one operation on the k-th input of the pool
+    ops_per_call: number of operations executed by each call of op (e.g. the configurations of a batch)
+*/
+void runBenchmark(const BenchOptions& options, const string& robot, const string& name,
+                  const function<void(int)>& op, vector<BenchResult>& results, long ops_per_call = 1)
+{
+  const string full_name = robot + "/" + name;
+  if (!options.filter.empty() && full_name.find(options.filter) == string::npos)
+  {
+    return;
+  }
+
+  const long calls = max(long(BENCH_MIN_CALLS), options.iterations / ops_per_call);
+  vector<double> call_ns(calls);
+
+  // Warm-up
+  const long warmup_calls = max(100L, calls / 10);
+  for (long k = 0; k < warmup_calls; k++)
+  {
+    op(k % BENCH_POOL_SIZE);
+  }
+
+  // Throughput
+  const long allocations_start = allocation_counter.load();
+  const auto t_start = chrono::steady_clock::now();
+  for (long k = 0; k < calls; k++)
+  {
+    op(k % BENCH_POOL_SIZE);
+  }
+  const double total_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - t_start).count();
+  const long allocations = allocation_counter.load() - allocations_start;
+
+  // Latency
+  for (long k = 0; k < calls; k++)
+  {
+    const auto t0 = chrono::steady_clock::now();
+    op(k % BENCH_POOL_SIZE);
+    call_ns[k] = chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count() / ops_per_call;
+  }
+  sort(call_ns.begin(), call_ns.end());
+
+  BenchResult result;
+  result.robot = robot;
+  result.name = name;
+  result.iterations = calls * ops_per_call;
+  result.ns_per_op = total_ns / result.iterations;
+  result.allocs_per_op = double(allocations) / result.iterations;
+  result.p50_ns = call_ns[calls / 2];
+  result.p99_ns = call_ns[min(calls - 1, (calls * 99) / 100)];
+  result.success_rate = -1.0;
+  result.jacobian_evaluations = -1.0;
+  results.push_back(result);
+
+  fprintf(stderr, "%-55s %10.1f ns/op %8.2f allocs/op\n", full_name.c_str(), result.ns_per_op,
+          result.allocs_per_op);
+}
+
+/*
+    Set the statistics of the inverse kinematics benchmark robot/name: solve(k, jacobian_evaluations) solves the k-th
+    input of the pool, returns true on success and adds its jacobian evaluations to jacobian_evaluations
+    iterative: false for the analytic solvers (no jacobian evaluations)
+    Each input is solved once (untimed), nothing is done if the benchmark has been excluded by the filter
+*/
+void setIKineStats(const string& robot, const string& name, const function<bool(int, long&)>& solve, bool iterative,
+                   vector<BenchResult>& results)
+{
+  if (results.empty() || results.back().robot != robot || results.back().name != name)
+  {
+    return;
+  }
+  int num_success = 0;
+  long jacobian_evaluations = 0;
+  for (int k = 0; k < BENCH_POOL_SIZE; k++)
+  {
+    if (solve(k, jacobian_evaluations))
+    {
+      num_success++;
+    }
+  }
+  BenchResult& result = results.back();
+  result.success_rate = double(num_success) / BENCH_POOL_SIZE;
+  if (iterative)
+  {
+    result.jacobian_evaluations = double(jacobian_evaluations) / BENCH_POOL_SIZE;
+    fprintf(stderr, "%-55s %10.1f %% success %8.2f jacobians/op\n", (robot + "/" + name).c_str(),
+            100.0 * result.success_rate, result.jacobian_evaluations);
+  }
+  else
+  {
+    fprintf(stderr, "%-55s %10.1f %% success\n", (robot + "/" + name).c_str(), 100.0 * result.success_rate);
+  }
+}
+
+/*
+    Iterated CLIK inverse kinematics (reference for Robot::ikine and the analytic solvers)
+    The allocation-free clik is iterated from qDH_seed with gain*Ts = 1 (Gauss-Newton step with the DLS pseudo-inverse)
+    on the position error and the rotation vector of the orientation error, until the tolerances of ik_options are met
+    One jacobian evaluation per iteration
+*/
+IKineResult ikineIteratedCLIK(Robot& robot, const Matrix<4, 4>& b_T_d, const Vector<>& qDH_seed,
+                              const IKineOptions& ik_options, const Vector<>& q0_dot, KinematicsWorkspace& ws,
+                              // Return Vars
+                              Vector<>& qpDH, Vector<>& q_DH)
+{
+  const Vector<3> pd = b_T_d.T()[3].slice<0, 3>();
+  const UnitQuaternion Qd(b_T_d);
+  const Vector<6> veld = Zeros;
+
+  IKineResult result;
+  q_DH = qDH_seed;
+  Vector<6> error;
+  while (true)
+  {
+    robot.jacob_geometric(q_DH, ws);
+    result.jacobian_evaluations++;
+
+    const RigidTransform& b_T_e = ws.all_T.back();
+    error.slice<0, 3>() = pd - b_T_e.p;
+    // the quaternion nearest to Qd, the orientation error is the shortest rotation
+    error.slice<3, 3>() = 2.0 * (Qd / UnitQuaternion(b_T_e.R, Qd)).getV();
+    result.error_position = norm(error.slice<0, 3>());
+    result.error_orientation = norm(error.slice<3, 3>());
+
+    if (result.error_position <= ik_options.tolerance_position &&
+        result.error_orientation <= ik_options.tolerance_orientation)
+    {
+      result.status = IKINE_SUCCESS;
+      return result;
+    }
+    if (result.iterations >= ik_options.max_iterations)
+    {
+      result.status = IKINE_MAX_ITERATIONS;
+      return result;
+    }
+    result.iterations++;
+
+    q_DH = robot.clik(q_DH, error, veld, 1.0, 1.0, 0.0, q0_dot, ws, qpDH);
+  }
+}
+
+/*
+    Random configurations in DH convention, uniformly distributed within the soft joint limits
+*/
+vector<Vector<>> randomConfigurations(Robot& robot, mt19937& generator)
+{
+  const CompiledChain& chain = robot.getCompiledChain();
+  uniform_real_distribution<double> uniform(0.0, 1.0);
+  vector<Vector<>> q_DH(BENCH_POOL_SIZE, Zeros(robot.getNumJoints()));
+  for (auto& q : q_DH)
+  {
+    for (int i = 0; i < robot.getNumJoints(); i++)
+    {
+      const double q_R = chain.soft_limit_lower[i] + (chain.soft_limit_higher[i] - chain.soft_limit_lower[i]) *
+                                                         (0.05 + 0.9 * uniform(generator));
+      q[i] = chain.joint_Robot2DH(i, q_R);
+    }
+  }
+  return q_DH;
+}
+
+/*
+    Benchmarks of a robot
+    FixedType: fixed-size engine of the robot (FixedRobot<7>)
+    ikine_analytic: analytic inverse kinematics of the robot, ikine_analytic(b_T_e, q_DH_seed, q_DH)
+*/
+template <class FixedType>
+void benchmarkRobot(const BenchOptions& options, const string& robot_name, Robot& robot, const FixedType& fixed,
+                    const function<bool(const Matrix<4, 4>&, const Vector<>&, Vector<>&)>& ikine_analytic,
+                    vector<BenchResult>& results)
+{
+  robot.compile();
+  const int numQ = robot.getNumJoints();
+
+  mt19937 generator(BENCH_SEED);
+  uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+  const vector<Vector<>> q_DH = randomConfigurations(robot, generator);
+  const vector<Vector<>> q0_p = randomConfigurations(robot, generator);
+  vector<Vector<7>> q_DH_fixed(BENCH_POOL_SIZE);
+  vector<Vector<>> q_R(BENCH_POOL_SIZE);
+  vector<Matrix<4, 4>> b_T_d(BENCH_POOL_SIZE);
+  vector<Vector<>> qDH_seed(BENCH_POOL_SIZE, Zeros(numQ));
+  for (int k = 0; k < BENCH_POOL_SIZE; k++)
+  {
+    for (int i = 0; i < 7; i++)
+    {
+      q_DH_fixed[k][i] = q_DH[k][i];
+    }
+    q_R[k] = robot.joints_DH2Robot(q_DH[k]);
+    b_T_d[k] = robot.fkine(q_DH[k]);
+    for (int i = 0; i < numQ; i++)
+    {
+      qDH_seed[k][i] = q_DH[k][i] + 0.1 * uniform(generator);
+    }
+  }
+  const Vector<3> dpd = makeVector(0.01, 0.0, 0.0);
+  const Vector<3> omegad = makeVector(0.0, 0.02, 0.0);
+
+  KinematicsWorkspace ws(numQ);
+  KinematicsCache cache(numQ);
+  Vector<> qpDH = Zeros(numQ);
+  Vector<> q_out = Zeros(numQ);
+  Vector<6> error;
+  UnitQuaternion Q;
+
+  /*=========FKINE=========*/
+
+  runBenchmark(options, robot_name, "fkine", [&](int k) { sink = sink + robot.fkine(q_DH[k])(0, 3); }, results);
+
+  runBenchmark(options, robot_name, "fkine_all",
+               [&](int k) { sink = sink + robot.fkine_all(q_DH[k], numQ + 1).back()(0, 3); }, results);
+
+  runBenchmark(options, robot_name, "fkine_all_workspace",
+               [&](int k) {
+                 robot.fkine_all(q_DH[k], ws);
+                 sink = sink + ws.all_T.back().p[0];
+               },
+               results);
+
+  // reference: general DH compose routine for all the links
+  robot.setDHKernelSpecialization(false);
+  runBenchmark(options, robot_name, "fkine_all_workspace_generic_dh",
+               [&](int k) {
+                 robot.fkine_all(q_DH[k], ws);
+                 sink = sink + ws.all_T.back().p[0];
+               },
+               results);
+  robot.setDHKernelSpecialization(true);
+
+  // only the last joint changes
+  {
+    Vector<> q_wrist = q_DH[0];
+    robot.fkine(q_wrist, cache);
+    runBenchmark(options, robot_name, "fkine_cache_last_joint",
+                 [&](int k) {
+                   q_wrist[numQ - 1] = q_DH[k][numQ - 1];
+                   sink = sink + robot.fkine(q_wrist, cache)(0, 3);
+                 },
+                 results);
+  }
+
+  runBenchmark(options, robot_name, "fkine_fixed", [&](int k) { sink = sink + fixed.fkine(q_DH_fixed[k])(0, 3); },
+               results);
+
+  {
+    vector<double> q_batch(numQ * BENCH_BATCH_SIZE);
+    vector<double> T_batch(12 * BENCH_BATCH_SIZE);
+    for (int c = 0; c < BENCH_BATCH_SIZE; c++)
+    {
+      for (int i = 0; i < numQ; i++)
+      {
+        q_batch[i * BENCH_BATCH_SIZE + c] = q_DH[c % BENCH_POOL_SIZE][i];
+      }
+    }
+    runBenchmark(options, robot_name, "fkine_batch",
+                 [&](int) {
+                   robot.fkine_batch(q_batch.data(), BENCH_BATCH_SIZE, T_batch.data());
+                   sink = sink + T_batch[0];
+                 },
+                 results, BENCH_BATCH_SIZE);
+  }
+
+  /*=========JACOBIAN=========*/
+
+  runBenchmark(options, robot_name, "jacob_geometric",
+               [&](int k) { sink = sink + robot.jacob_geometric(q_DH[k])(0, 0); }, results);
+
+  runBenchmark(options, robot_name, "jacob_geometric_workspace",
+               [&](int k) { sink = sink + robot.jacob_geometric(q_DH[k], ws)(0, 0); }, results);
+
+  // reference: general DH compose routine for all the links
+  robot.setDHKernelSpecialization(false);
+  runBenchmark(options, robot_name, "jacob_geometric_workspace_generic_dh",
+               [&](int k) { sink = sink + robot.jacob_geometric(q_DH[k], ws)(0, 0); }, results);
+  robot.setDHKernelSpecialization(true);
+
+  runBenchmark(options, robot_name, "fkine_jacob_geometric",
+               [&](int k) {
+                 Matrix<4, 4> b_T_e;
+                 sink = sink + robot.fkine_jacob_geometric(q_DH[k], b_T_e)(0, 0) + b_T_e(0, 3);
+               },
+               results);
+
+  {
+    Vector<> q_wrist = q_DH[0];
+    robot.jacob_geometric(q_wrist, cache);
+    runBenchmark(options, robot_name, "jacob_geometric_cache_last_joint",
+                 [&](int k) {
+                   q_wrist[numQ - 1] = q_DH[k][numQ - 1];
+                   sink = sink + robot.jacob_geometric(q_wrist, cache)(0, 0);
+                 },
+                 results);
+  }
+
+  runBenchmark(options, robot_name, "jacob_geometric_fixed",
+               [&](int k) { sink = sink + fixed.jacob_geometric(q_DH_fixed[k])(0, 0); }, results);
+
+  {
+    vector<double> q_batch(numQ * BENCH_BATCH_SIZE);
+    vector<double> J_batch(6 * numQ * BENCH_BATCH_SIZE);
+    for (int c = 0; c < BENCH_BATCH_SIZE; c++)
+    {
+      for (int i = 0; i < numQ; i++)
+      {
+        q_batch[i * BENCH_BATCH_SIZE + c] = q_DH[c % BENCH_POOL_SIZE][i];
+      }
+    }
+    runBenchmark(options, robot_name, "jacob_geometric_batch",
+                 [&](int) {
+                   robot.jacob_geometric_batch(q_batch.data(), BENCH_BATCH_SIZE, J_batch.data());
+                   sink = sink + J_batch[0];
+                 },
+                 results, BENCH_BATCH_SIZE);
+  }
+
+  // q0_p is used as joint velocity
+  runBenchmark(options, robot_name, "jacob_geometric_dot",
+               [&](int k) { sink = sink + robot.jacob_geometric_dot(q_DH[k], q0_p[k])(0, 0); }, results);
+
+  runBenchmark(options, robot_name, "jacob_geometric_dot_workspace",
+               [&](int k) { sink = sink + robot.jacob_geometric_dot(q_DH[k], q0_p[k], ws)(0, 0); }, results);
+
+  // reference: central difference of the jacobian along the joint velocity
+  {
+    const double h = 1e-6;
+    KinematicsWorkspace ws_minus(numQ);
+    Vector<> q_plus = Zeros(numQ);
+    Vector<> q_minus = Zeros(numQ);
+    runBenchmark(options, robot_name, "jacob_geometric_dot_finite_difference",
+                 [&](int k) {
+                   q_plus = q_DH[k] + h * q0_p[k];
+                   q_minus = q_DH[k] - h * q0_p[k];
+                   sink = sink + (robot.jacob_geometric(q_plus, ws)(0, 0) -
+                                  robot.jacob_geometric(q_minus, ws_minus)(0, 0)) /
+                                     (2.0 * h);
+                 },
+                 results);
+  }
+
+  runBenchmark(options, robot_name, "jacob_geometric_dot_qdot_workspace",
+               [&](int k) { sink = sink + robot.jacob_geometric_dot_qdot(q_DH[k], q0_p[k], ws)[0]; }, results);
+
+  /*=========LIMITS=========*/
+
+  runBenchmark(options, robot_name, "exceededHardJointLimits",
+               [&](int k) { sink = sink + robot.exceededHardJointLimits(q_R[k]); }, results);
+
+  runBenchmark(options, robot_name, "exceededSoftJointLimits",
+               [&](int k) { sink = sink + robot.exceededSoftJointLimits(q_R[k]); }, results);
+
+  runBenchmark(options, robot_name, "checkHardJointLimits",
+               [&](int k) { sink = sink + robot.checkHardJointLimits(q_R[k])[0]; }, results);
+
+  /*=========CLIK=========*/
+
+  const Vector<3> pd = makeVector(0.4, 0.1, 0.5);
+  const UnitQuaternion Qd(Matrix<3, 3>(rotx(0.3) * roty(0.2)));
+
+  runBenchmark(options, robot_name, "clik",
+               [&](int k) {
+                 q_out = robot.clik(q_DH[k], pd, Qd, Q, dpd, omegad, 50.0, 0.001, 1.0, q0_p[k], qpDH, error, Q);
+                 sink = sink + q_out[0];
+               },
+               results);
+
+  // reference: the clik of the baseline, fkine and jacob_geometric in two traversals of the chain
+  {
+    Vector<6> veld;
+    veld.slice<0, 3>() = dpd;
+    veld.slice<3, 3>() = omegad;
+    runBenchmark(options, robot_name, "clik_two_traversals",
+                 [&](int k) {
+                   const Matrix<4, 4> b_T_e = robot.fkine(q_DH[k]);
+                   Q = UnitQuaternion(b_T_e, Q);
+                   error.slice<0, 3>() = pd - b_T_e.T()[3].slice<0, 3>();
+                   error.slice<3, 3>() = (Qd / Q).getV();
+                   const Matrix<> jacob = robot.jacob_geometric(q_DH[k]);
+                   q_out = robot.clik(q_DH[k], error, jacob, veld, 50.0, 0.001, 1.0, q0_p[k], qpDH);
+                   sink = sink + q_out[0];
+                 },
+                 results);
+  }
+
+  robot.setCLIKSolver(CLIK_SOLVER_PINV);
+  runBenchmark(options, robot_name, "clik_workspace_pinv",
+               [&](int k) {
+                 sink = sink + robot.clik(q_DH[k], pd, Qd, Q, dpd, omegad, 50.0, 0.001, 1.0, q0_p[k], ws, qpDH,
+                                          error, Q)[0];
+               },
+               results);
+
+  robot.setCLIKSolver(CLIK_SOLVER_CHOLESKY);
+  runBenchmark(options, robot_name, "clik_workspace_cholesky",
+               [&](int k) {
+                 sink = sink + robot.clik(q_DH[k], pd, Qd, Q, dpd, omegad, 50.0, 0.001, 1.0, q0_p[k], ws, qpDH,
+                                          error, Q)[0];
+               },
+               results);
+  robot.setCLIKSolver(CLIK_SOLVER_PINV);
+
+  {
+    Vector<6, int> mask = Zeros;
+    mask[0] = mask[1] = mask[2] = 1;
+    runBenchmark(options, robot_name, "clik_workspace_position_only",
+                 [&](int k) {
+                   sink = sink + robot.clik(q_DH[k], pd, Qd, Q, dpd, omegad, mask, 50.0, 0.001, 1.0, q0_p[k], ws,
+                                            qpDH, error, Q)[0];
+                 },
+                 results);
+
+    Vector<6, int> mask_orientation = Zeros;
+    mask_orientation[3] = mask_orientation[4] = mask_orientation[5] = 1;
+    vector<bool> wrist(numQ, false);
+    wrist[numQ - 1] = wrist[numQ - 2] = wrist[numQ - 3] = true;
+    runBenchmark(options, robot_name, "clik_workspace_wrist_orientation",
+                 [&](int k) {
+                   sink = sink + robot.clik(q_DH[k], pd, Qd, Q, dpd, omegad, mask_orientation, wrist, 50.0, 0.001,
+                                            0.0, q0_p[k], ws, qpDH, error, Q)[0];
+                 },
+                 results);
+  }
+
+  runBenchmark(options, robot_name, "clik_rt",
+               [&](int k) {
+                 sink = sink + robot.clik_rt(q_DH[k], pd, Qd, Q, dpd, omegad, Ones, 50.0, 0.001, 1.0, q0_p[k], ws,
+                                             qpDH, error, Q);
+               },
+               results);
+
+  runBenchmark(options, robot_name, "clik_fixed",
+               [&](int k) {
+                 Vector<7> q0_p_fixed = q_DH_fixed[(k + 1) % BENCH_POOL_SIZE];
+                 Vector<7> qpDH_fixed;
+                 sink = sink + fixed.clik(q_DH_fixed[k], pd, Qd, Q, dpd, omegad, Ones, 50.0, 0.001, 1.0, q0_p_fixed,
+                                          qpDH_fixed, error, Q)[0];
+               },
+               results);
+
+  {
+    // q0_p is used as joint velocity at time k
+    const Vector<3> ddpd = makeVector(0.0, 0.01, 0.0);
+    const Vector<3> domegad = makeVector(0.02, 0.0, 0.0);
+    Vector<> qpDH_k1 = Zeros(numQ);
+    Vector<> qppDH = Zeros(numQ);
+    const Vector<> q0_zero = Zeros(numQ);
+    runBenchmark(options, robot_name, "clik_second_order_workspace",
+                 [&](int k) {
+                   sink = sink + robot.clik_second_order(q_DH[k], q0_p[k], pd, Qd, Q, dpd, omegad, ddpd, domegad,
+                                                         Ones, 400.0, 40.0, 0.001, 1.0, q0_zero, ws, qpDH_k1,
+                                                         qppDH, error, Q)[0];
+                 },
+                 results);
+  }
+
+  {
+    ClikController controller(robot, 50.0, 0.001);
+    runBenchmark(options, robot_name, "clik_controller_step",
+                 [&](int k) { sink = sink + controller.step(q_DH[k], pd, Qd, dpd, omegad)[0]; }, results);
+  }
+
+  /*=========NULL SPACE OBJECTIVES=========*/
+
+  {
+    Vector<> grad = Zeros(numQ);
+    runBenchmark(options, robot_name, "grad_fcst_manipulability_workspace",
+                 [&](int k) { sink = sink + robot.grad_fcst_manipulability(q_DH[k], ws, grad) + grad[0]; }, results);
+
+    // reference: central differences of the manipulability, 2*NUM_JOINT jacobian evaluations
+    Vector<> q_h = Zeros(numQ);
+    runBenchmark(options, robot_name, "grad_manipulability_finite_difference",
+                 [&](int k) {
+                   const double h = 1e-6;
+                   for (int i = 0; i < numQ; i++)
+                   {
+                     q_h = q_DH[k];
+                     q_h[i] += h;
+                     const double w_plus = robot.manipulability(q_h, ws);
+                     q_h[i] -= 2.0 * h;
+                     grad[i] = (w_plus - robot.manipulability(q_h, ws)) / (2.0 * h);
+                   }
+                   sink = sink + grad[0];
+                 },
+                 results);
+
+    runBenchmark(options, robot_name, "grad_fcst_joint_limits",
+                 [&](int k) {
+                   robot.grad_fcst_joint_limits(q_DH[k], grad);
+                   sink = sink + grad[0];
+                 },
+                 results);
+  }
+
+  /*=========END-TO-END CLIK CYCLE=========*/
+
+  // tracking of a circle at 1kHz starting from the first configuration of the pool, one op = one cycle
+  {
+    const double Ts = 0.001;
+    const Matrix<4, 4> b_T_start = robot.fkine(q_DH[0]);
+    const Vector<3> center = makeVector(b_T_start(0, 3), b_T_start(1, 3) - 0.05, b_T_start(2, 3));
+    const UnitQuaternion Q_start(b_T_start);
+    long cycle = 0;
+
+    auto circle = [&](long n, Vector<3>& p, Vector<3>& dp) {
+      const double w = 2.0 * M_PI * 0.5;
+      const double t = n * Ts;
+      p = center + makeVector(0.0, 0.05 * cos(w * t), 0.05 * sin(w * t));
+      dp = makeVector(0.0, -0.05 * w * sin(w * t), 0.05 * w * cos(w * t));
+    };
+
+    Vector<> q_cycle = q_DH[0];
+    UnitQuaternion Q_cycle = Q_start;
+    runBenchmark(options, robot_name, "clik_cycle",
+                 [&](int) {
+                   Vector<3> p, dp;
+                   circle(cycle++, p, dp);
+                   q_cycle = robot.clik(q_cycle, p, Q_start, Q_cycle, dp, Zeros, 50.0, Ts, 0.0, Zeros(numQ), qpDH,
+                                        error, Q_cycle);
+                   sink = sink + q_cycle[0];
+                 },
+                 results);
+
+    ClikController controller(robot, 50.0, Ts);
+    controller.reset(q_DH[0]);
+    Vector<> q_controller = q_DH[0];
+    cycle = 0;
+    runBenchmark(options, robot_name, "clik_cycle_controller",
+                 [&](int) {
+                   Vector<3> p, dp;
+                   circle(cycle++, p, dp);
+                   const Vector<>& q_next = controller.step(q_controller, p, Q_start, dp, Zeros);
+                   for (int i = 0; i < numQ; i++)
+                   {
+                     q_controller[i] = q_next[i];
+                   }
+                   sink = sink + q_controller[0];
+                 },
+                 results);
+  }
+
+  /*=========DYNAMICS=========*/
+
+  {
+    Vector<> tau = Zeros(numQ);
+    runBenchmark(options, robot_name, "inverseDynamics",
+                 [&](int k) { sink = sink + robot.inverseDynamics(q_DH[k], q0_p[k], qDH_seed[k])[0]; }, results);
+
+    runBenchmark(options, robot_name, "inverseDynamics_workspace",
+                 [&](int k) {
+                   robot.inverseDynamics(q_DH[k], q0_p[k], qDH_seed[k], ws, tau);
+                   sink = sink + tau[0];
+                 },
+                 results);
+
+    runBenchmark(options, robot_name, "gravityTorques_workspace",
+                 [&](int k) {
+                   robot.gravityTorques(q_DH[k], ws, tau);
+                   sink = sink + tau[0];
+                 },
+                 results);
+
+    runBenchmark(options, robot_name, "coriolisTorques_workspace",
+                 [&](int k) {
+                   robot.coriolisTorques(q_DH[k], q0_p[k], ws, tau);
+                   sink = sink + tau[0];
+                 },
+                 results);
+
+    Matrix<> B = Zeros(numQ, numQ);
+    runBenchmark(options, robot_name, "massMatrix_workspace",
+                 [&](int k) {
+                   robot.massMatrix(q_DH[k], ws, B);
+                   sink = sink + B(0, 0);
+                 },
+                 results);
+
+    // reference: one column of the mass matrix per call of the RNEA (unit acceleration, no velocity, no gravity)
+    {
+      RobotPtr robot_no_gravity(robot.clone());
+      robot_no_gravity->setGravity(Zeros);
+      robot_no_gravity->compile();
+      const Vector<> zeros = Zeros(numQ);
+      Vector<> e_j = Zeros(numQ);
+      runBenchmark(options, robot_name, "massMatrix_rnea_columns",
+                   [&](int k) {
+                     for (int j = 0; j < numQ; j++)
+                     {
+                       e_j[j] = 1.0;
+                       robot_no_gravity->inverseDynamics(q_DH[k], zeros, e_j, ws, tau);
+                       e_j[j] = 0.0;
+                       B.T()[j] = tau;
+                     }
+                     sink = sink + B(0, 0);
+                   },
+                   results);
+    }
+
+    Vector<> qdd = Zeros(numQ);
+    runBenchmark(options, robot_name, "forwardDynamics_workspace",
+                 [&](int k) {
+                   robot.forwardDynamics(q_DH[k], q0_p[k], qDH_seed[k], ws, qdd);
+                   sink = sink + qdd[0];
+                 },
+                 results);
+
+    // reference: qdd = B^-1*(tau - n(q,qd)) with the mass matrix by the CRBA and a Cholesky solve
+    {
+      const Vector<> zeros = Zeros(numQ);
+      runBenchmark(options, robot_name, "forwardDynamics_crba_cholesky",
+                   [&](int k) {
+                     robot.inverseDynamics(q_DH[k], q0_p[k], zeros, ws, tau);
+                     robot.massMatrix(q_DH[k], ws, B);
+                     Cholesky<> chol(B);
+                     qdd = chol.backsub(qDH_seed[k] - tau);
+                     sink = sink + qdd[0];
+                   },
+                   results);
+    }
+
+    vector<double> q_batch(numQ * BENCH_BATCH_SIZE);
+    vector<double> qd_batch(numQ * BENCH_BATCH_SIZE);
+    vector<double> tau_batch(numQ * BENCH_BATCH_SIZE);
+    vector<double> qdd_batch(numQ * BENCH_BATCH_SIZE);
+    vector<double> B_batch(numQ * numQ * BENCH_BATCH_SIZE);
+    for (int c = 0; c < BENCH_BATCH_SIZE; c++)
+    {
+      for (int i = 0; i < numQ; i++)
+      {
+        q_batch[i * BENCH_BATCH_SIZE + c] = q_DH[c % BENCH_POOL_SIZE][i];
+        qd_batch[i * BENCH_BATCH_SIZE + c] = q0_p[c % BENCH_POOL_SIZE][i];
+        tau_batch[i * BENCH_BATCH_SIZE + c] = qDH_seed[c % BENCH_POOL_SIZE][i];
+      }
+    }
+    runBenchmark(options, robot_name, "massMatrix_batch",
+                 [&](int) {
+                   robot.massMatrix_batch(q_batch.data(), BENCH_BATCH_SIZE, B_batch.data());
+                   sink = sink + B_batch[0];
+                 },
+                 results, BENCH_BATCH_SIZE);
+
+    runBenchmark(options, robot_name, "forwardDynamics_batch",
+                 [&](int) {
+                   robot.forwardDynamics_batch(q_batch.data(), qd_batch.data(), tau_batch.data(), BENCH_BATCH_SIZE,
+                                               qdd_batch.data());
+                   sink = sink + qdd_batch[0];
+                 },
+                 results, BENCH_BATCH_SIZE);
+  }
+
+  /*=========INVERSE KINEMATICS=========*/
+
+  // the seeds are near the solution (qDH_seed) or random configurations (q0_p, far from the solution)
+  // success: converged within the tolerances and the hard joint limits (the iterated clik does not clamp the joints)
+  {
+    IKineOptions ik_options;
+    const Vector<> q0_dot = Zeros(numQ);
+    auto solved = [&](const IKineResult& result, long& jacobian_evaluations) {
+      jacobian_evaluations += result.jacobian_evaluations;
+      return result.status == IKINE_SUCCESS && !robot.exceededHardJointLimits(robot.joints_DH2Robot(q_out));
+    };
+    const vector<Vector<>>* seed_sets[2] = { &qDH_seed, &q0_p };
+    const string seed_suffixes[2] = { "", "_far_seed" };
+    for (int s = 0; s < 2; s++)
+    {
+      const vector<Vector<>>& seeds = *seed_sets[s];
+
+      const string ikine_name = "ikine" + seed_suffixes[s];
+      runBenchmark(options, robot_name, ikine_name,
+                   [&](int k) {
+                     IKineResult result = robot.ikine(b_T_d[k], seeds[k], ik_options, ws, q_out);
+                     sink = sink + result.iterations;
+                   },
+                   results);
+      setIKineStats(robot_name, ikine_name,
+                    [&](int k, long& jacobian_evaluations) {
+                      return solved(robot.ikine(b_T_d[k], seeds[k], ik_options, ws, q_out), jacobian_evaluations);
+                    },
+                    true, results);
+
+      // reference: iterated clik, same seeds and tolerances
+      const string clik_name = "ikine_iterated_clik" + seed_suffixes[s];
+      runBenchmark(options, robot_name, clik_name,
+                   [&](int k) {
+                     IKineResult result =
+                         ikineIteratedCLIK(robot, b_T_d[k], seeds[k], ik_options, q0_dot, ws, qpDH, q_out);
+                     sink = sink + result.iterations;
+                   },
+                   results);
+      setIKineStats(robot_name, clik_name,
+                    [&](int k, long& jacobian_evaluations) {
+                      return solved(ikineIteratedCLIK(robot, b_T_d[k], seeds[k], ik_options, q0_dot, ws, qpDH, q_out),
+                                    jacobian_evaluations);
+                    },
+                    true, results);
+
+      const string analytic_name = "ikine_analytic" + seed_suffixes[s];
+      runBenchmark(options, robot_name, analytic_name,
+                   [&](int k) { sink = sink + ikine_analytic(b_T_d[k], seeds[k], q_out); }, results);
+      setIKineStats(robot_name, analytic_name,
+                    [&](int k, long&) { return ikine_analytic(b_T_d[k], seeds[k], q_out); }, false, results);
+    }
+  }
+
+  // multi-start: the seeds are random configurations (far from the solution), the number of workers is swept
+  {
+    IKineOptions ik_options;
+    BenchOptions ms_options = options;
+    ms_options.iterations = max(1L, options.iterations / BENCH_MULTISTART_ITERATIONS_DIVISOR);
+
+    // independent generator, the inputs of the other benchmarks do not change
+    mt19937 ms_generator(BENCH_SEED + 1);
+    vector<vector<Vector<>>> seed_pool;
+    for (int j = 0; j < BENCH_MULTISTART_MAX_SEEDS; j++)
+    {
+      seed_pool.push_back(randomConfigurations(robot, ms_generator));
+    }
+
+    const int num_seeds_list[4] = { 1, 4, 8, 16 };
+    const int num_workers_list[4] = { 1, 2, 4, 8 };
+    for (int num_seeds : num_seeds_list)
+    {
+      vector<vector<Vector<>>> seeds(BENCH_POOL_SIZE);
+      for (int k = 0; k < BENCH_POOL_SIZE; k++)
+      {
+        for (int j = 0; j < num_seeds; j++)
+        {
+          seeds[k].push_back(seed_pool[j][k]);
+        }
+      }
+
+      for (int num_workers : num_workers_list)
+      {
+        if (num_workers > num_seeds)
+        {
+          break;
+        }
+        string name = "ikine_multistart_" + to_string(num_seeds) + "_seeds";
+        if (num_workers > 1)
+        {
+          name += "_" + to_string(num_workers) + "_workers";
+        }
+        runBenchmark(ms_options, robot_name, name,
+                     [&](int k) {
+                       int seed_index;
+                       IKineResult result =
+                           robot.ikine_multistart(b_T_d[k], seeds[k], q_out, seed_index, ik_options, num_workers);
+                       sink = sink + result.iterations + seed_index;
+                     },
+                     results);
+      }
+    }
+  }
+}
+
+/*
+    Format an optional value of the results, empty_value if the value is negative (not applicable)
+*/
+string optionalValue(double value, const string& empty_value)
+{
+  if (value < 0.0)
+  {
+    return empty_value;
+  }
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.4f", value);
+  return buffer;
+}
+
+/*
+    Write the results as JSON
+*/
+void writeJSON(FILE* out, const vector<BenchResult>& results)
+{
+  fprintf(out, "{\n  \"seed\": %d,\n  \"benchmarks\": [\n", BENCH_SEED);
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const BenchResult& r = results[i];
+    fprintf(out,
+            "    {\"robot\": \"%s\", \"name\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.2f, "
+            "\"allocs_per_op\": %.3f, \"p50_ns\": %.2f, \"p99_ns\": %.2f, \"success_rate\": %s, "
+            "\"jacobian_evaluations\": %s}%s\n",
+            r.robot.c_str(), r.name.c_str(), r.iterations, r.ns_per_op, r.allocs_per_op, r.p50_ns, r.p99_ns,
+            optionalValue(r.success_rate, "null").c_str(), optionalValue(r.jacobian_evaluations, "null").c_str(),
+            (i + 1 < results.size()) ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+/*
+    Write the results as CSV
+*/
+void writeCSV(FILE* out, const vector<BenchResult>& results)
+{
+  fprintf(out, "robot,name,iterations,ns_per_op,allocs_per_op,p50_ns,p99_ns,success_rate,jacobian_evaluations\n");
+  for (const BenchResult& r : results)
+  {
+    fprintf(out, "%s,%s,%ld,%.2f,%.3f,%.2f,%.2f,%s,%s\n", r.robot.c_str(), r.name.c_str(), r.iterations, r.ns_per_op,
+            r.allocs_per_op, r.p50_ns, r.p99_ns, optionalValue(r.success_rate, "").c_str(),
+            optionalValue(r.jacobian_evaluations, "").c_str());
+  }
+}
+
+/*
+    Parse the command line, exit on error
+*/
+BenchOptions parseOptions(int argc, char** argv)
+{
+  BenchOptions options;
+  for (int i = 1; i < argc; i++)
+  {
+    const string arg(argv[i]);
+    if (arg.compare(0, 9, "--format=") == 0)
+    {
+      options.format = arg.substr(9);
+    }
+    else if (arg.compare(0, 13, "--iterations=") == 0)
+    {
+      options.iterations = atol(arg.substr(13).c_str());
+    }
+    else if (arg.compare(0, 9, "--filter=") == 0)
+    {
+      options.filter = arg.substr(9);
+    }
+    else if (arg.compare(0, 9, "--output=") == 0)
+    {
+      options.output = arg.substr(9);
+    }
+    else
+    {
+      fprintf(stderr,
+              "Usage: %s [--format=json|csv] [--iterations=N] [--filter=SUBSTRING] [--output=FILE]\n", argv[0]);
+      exit(-1);
+    }
+  }
+  if ((options.format != "json" && options.format != "csv") || options.iterations <= 0)
+  {
+    fprintf(stderr, "Invalid options: format must be json or csv, iterations must be positive\n");
+    exit(-1);
+  }
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  const BenchOptions options = parseOptions(argc, argv);
+
+  vector<BenchResult> results;
+
+  {
+    LBRiiwa7 robot("iiwa");
+    LBRiiwa7Fixed fixed;
+    benchmarkRobot(options, LBRIIWA7_MODEL_STR, robot, fixed,
+                   [&robot](const Matrix<4, 4>& b_T_e, const Vector<>& qDH_seed, Vector<>& q_DH) {
+                     return robot.ikine_analytic(b_T_e, robot.arm_angle(qDH_seed), qDH_seed, q_DH);
+                   },
+                   results);
+  }
+
+  {
+    MotomanSIA5F robot("sia5f");
+    MotomanSIA5FFixed fixed;
+    benchmarkRobot(options, MOTOMANSIA5F_MODEL_STR, robot, fixed,
+                   [&robot](const Matrix<4, 4>& b_T_e, const Vector<>& qDH_seed, Vector<>& q_DH) {
+                     return robot.ikine_analytic(b_T_e, qDH_seed, q_DH);
+                   },
+                   results);
+  }
+
+  FILE* out = stdout;
+  if (!options.output.empty())
+  {
+    out = fopen(options.output.c_str(), "w");
+    if (out == nullptr)
+    {
+      fprintf(stderr, "Cannot open %s\n", options.output.c_str());
+      return -1;
+    }
+  }
+
+  if (options.format == "json")
+  {
+    writeJSON(out, results);
+  }
+  else
+  {
+    writeCSV(out, results);
+  }
+
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+
+  return 0;
+}
@@ -0,0 +1,271 @@
+/*
+
+    Batched Kinematics
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <thread>
+#include "sun_robot_lib/Robot.h"
+#include "BatchKinematicsKernels.h"
+
+//! Minimum number of configurations computed by each thread of the batched functions
+#define BATCH_MIN_CONF_PER_THREAD 256
+
+using namespace TooN;
+using namespace std;
+
+namespace sun
+{
+namespace batch
+{
+/*=========KERNEL ENTRY POINTS=========*/
+
+void fkine_scalar(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* b_T_e)
+{
+  fkine_kernel<PackScalar>(chain, q_DH, num_conf, begin, end, b_T_e);
+}
+
+#if defined(__SSE2__)
+void fkine_sse2(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* b_T_e)
+{
+  int end_simd = begin + ((end - begin) / PackSSE2::width) * PackSSE2::width;
+  fkine_kernel<PackSSE2>(chain, q_DH, num_conf, begin, end_simd, b_T_e);
+  fkine_kernel<PackScalar>(chain, q_DH, num_conf, end_simd, end, b_T_e);
+}
+#endif
+
+void jacob_scalar(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* jacob,
+                  double* b_T_e)
+{
+  jacob_kernel<PackScalar>(chain, q_DH, num_conf, begin, end, jacob, b_T_e);
+}
+
+#if defined(__SSE2__)
+void jacob_sse2(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* jacob,
+                double* b_T_e)
+{
+  int end_simd = begin + ((end - begin) / PackSSE2::width) * PackSSE2::width;
+  jacob_kernel<PackSSE2>(chain, q_DH, num_conf, begin, end_simd, jacob, b_T_e);
+  jacob_kernel<PackScalar>(chain, q_DH, num_conf, end_simd, end, jacob, b_T_e);
+}
+#endif
+
+/*=========END KERNEL ENTRY POINTS=========*/
+
+}  // namespace batch
+
+namespace
+{
+enum BatchBackend
+{
+  BATCH_BACKEND_SCALAR,
+  BATCH_BACKEND_SSE2,
+  BATCH_BACKEND_AVX2
+};
+
+/*
+    Select the best kernels supported by the running CPU
+*/
+BatchBackend detectBatchBackend()
+{
+#if defined(SUN_ROBOT_LIB_HAVE_AVX2)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+  {
+    return BATCH_BACKEND_AVX2;
+  }
+#endif
+#if defined(__SSE2__)
+  return BATCH_BACKEND_SSE2;
+#else
+  return BATCH_BACKEND_SCALAR;
+#endif
+}
+
+BatchBackend batchBackend()
+{
+  static const BatchBackend backend = detectBatchBackend();
+  return backend;
+}
+
+/*
+    Build the plain view of the chain used by the kernels
+*/
+batch::ChainView makeChainView(const CompiledChain& chain, const RigidTransform& b_T_0, const RigidTransform& n_T_e)
+{
+  batch::ChainView view;
+  view.num_joints = chain.num_joints;
+  view.a = chain.a.data();
+  view.sin_alpha = chain.sin_alpha.data();
+  view.cos_alpha = chain.cos_alpha.data();
+  view.d = chain.d.data();
+  view.theta = chain.theta.data();
+  view.prismatic_mask = chain.prismatic_mask;
+  for (int r = 0; r < 3; r++)
+  {
+    for (int c = 0; c < 3; c++)
+    {
+      view.b_T_0[r * 4 + c] = b_T_0.R(r, c);
+      view.n_T_e[r * 4 + c] = n_T_e.R(r, c);
+    }
+    view.b_T_0[r * 4 + 3] = b_T_0.p[r];
+    view.n_T_e[r * 4 + 3] = n_T_e.p[r];
+  }
+  return view;
+}
+
+/*
+    Split [0,num_conf) in contiguous chunks and call kernel(begin,end) on each of them,
+    one chunk per thread (the last chunk runs in the calling thread)
+*/
+template <class Kernel>
+void runChunks(int num_conf, int num_threads, const Kernel& kernel)
+{
+  int max_threads = num_conf / BATCH_MIN_CONF_PER_THREAD;
+  if (num_threads > max_threads)
+  {
+    num_threads = max_threads;
+  }
+  if (num_threads <= 1)
+  {
+    kernel(0, num_conf);
+    return;
+  }
+
+  // chunks multiple of 4 configurations, so that only the last chunk has a scalar tail
+  int chunk = (num_conf + num_threads - 1) / num_threads;
+  chunk = ((chunk + 3) / 4) * 4;
+
+  vector<thread> workers;
+  int begin = 0;
+  while (num_conf - begin > chunk)
+  {
+    workers.push_back(thread(kernel, begin, begin + chunk));
+    begin += chunk;
+  }
+  kernel(begin, num_conf);
+
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+}
+
+}  // namespace
+
+/*
+    Name of the kernels used by the batched functions on this CPU ("avx2", "sse2" or "scalar")
+*/
+string Robot::getBatchBackend()
+{
+  switch (batchBackend())
+  {
+    case BATCH_BACKEND_AVX2:
+      return string("avx2");
+    case BATCH_BACKEND_SSE2:
+      return string("sse2");
+    default:
+      return string("scalar");
+  }
+}
+
+/*
+    Batched fkine to the end-effector (struct-of-arrays layout)
+    Inputs:
+        - q_DH: joint positions, q_DH[j*num_conf + k] is the j-th joint of the k-th configuration
+        - num_conf: number of configurations
+        - num_threads: the batch is split in chunks computed in parallel (1 = calling thread only)
+    Outputs:
+        - b_T_e: poses, b_T_e[(r*4+c)*num_conf + k] is the element (r,c) of the k-th pose, r=0,1,2
+                 (the last row is always [0 0 0 1] and it is not stored), size = 12*num_conf
+*/
+void Robot::fkine_batch(const double* q_DH, int num_conf, double* b_T_e, int num_threads) const
+{
+  const batch::ChainView chain = makeChainView(getCompiledChain(), _b_T_0, _n_T_e);
+  const BatchBackend backend = batchBackend();
+
+  runChunks(num_conf, num_threads, [&chain, backend, q_DH, num_conf, b_T_e](int begin, int end) {
+    switch (backend)
+    {
+#if defined(SUN_ROBOT_LIB_HAVE_AVX2)
+      case BATCH_BACKEND_AVX2:
+      {
+        batch::fkine_avx2(chain, q_DH, num_conf, begin, end, b_T_e);
+        break;
+      }
+#endif
+#if defined(__SSE2__)
+      case BATCH_BACKEND_SSE2:
+      {
+        batch::fkine_sse2(chain, q_DH, num_conf, begin, end, b_T_e);
+        break;
+      }
+#endif
+      default:
+      {
+        batch::fkine_scalar(chain, q_DH, num_conf, begin, end, b_T_e);
+      }
+    }
+  });
+}
+
+/*
+    Batched geometric jacobian in frame {end-effector} w.r.t. base frame (struct-of-arrays layout)
+    Inputs:
+        - q_DH: joint positions, q_DH[j*num_conf + k] is the j-th joint of the k-th configuration
+        - num_conf: number of configurations
+        - num_threads: the batch is split in chunks computed in parallel (1 = calling thread only)
+    Outputs:
+        - jacob: jacobians, jacob[(r*NUM_JOINT+c)*num_conf + k] is the element (r,c) of the k-th jacobian,
+                 size = 6*NUM_JOINT*num_conf
+        - b_T_e: poses as in fkine_batch, it can be null
+*/
+void Robot::jacob_geometric_batch(const double* q_DH, int num_conf, double* jacob, double* b_T_e,
+                                  int num_threads) const
+{
+  const batch::ChainView chain = makeChainView(getCompiledChain(), _b_T_0, _n_T_e);
+  const BatchBackend backend = batchBackend();
+
+  runChunks(num_conf, num_threads, [&chain, backend, q_DH, num_conf, jacob, b_T_e](int begin, int end) {
+    switch (backend)
+    {
+#if defined(SUN_ROBOT_LIB_HAVE_AVX2)
+      case BATCH_BACKEND_AVX2:
+      {
+        batch::jacob_avx2(chain, q_DH, num_conf, begin, end, jacob, b_T_e);
+        break;
+      }
+#endif
+#if defined(__SSE2__)
+      case BATCH_BACKEND_SSE2:
+      {
+        batch::jacob_sse2(chain, q_DH, num_conf, begin, end, jacob, b_T_e);
+        break;
+      }
+#endif
+      default:
+      {
+        batch::jacob_scalar(chain, q_DH, num_conf, begin, end, jacob, b_T_e);
+      }
+    }
+  });
+}
+
+}  // namespace sun
@@ -0,0 +1,49 @@
+/*
+
+    Batched Kinematics, AVX2 kernels
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+// This translation unit is compiled with -mavx2 -mfma,
+// its functions are called only if the running CPU supports them
+
+#include "BatchKinematicsKernels.h"
+
+namespace sun
+{
+namespace batch
+{
+void fkine_avx2(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* b_T_e)
+{
+  int end_simd = begin + ((end - begin) / PackAVX2::width) * PackAVX2::width;
+  fkine_kernel<PackAVX2>(chain, q_DH, num_conf, begin, end_simd, b_T_e);
+  fkine_kernel<PackScalar>(chain, q_DH, num_conf, end_simd, end, b_T_e);
+}
+
+void jacob_avx2(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* jacob,
+                double* b_T_e)
+{
+  int end_simd = begin + ((end - begin) / PackAVX2::width) * PackAVX2::width;
+  jacob_kernel<PackAVX2>(chain, q_DH, num_conf, begin, end_simd, jacob, b_T_e);
+  jacob_kernel<PackScalar>(chain, q_DH, num_conf, end_simd, end, jacob, b_T_e);
+}
+
+}  // namespace batch
+}  // namespace sun
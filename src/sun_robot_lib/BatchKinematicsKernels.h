@@ -0,0 +1,452 @@
+/*
+
+    Batched Kinematics Kernels (private header)
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef BATCHKINEMATICSKERNELS_H
+#define BATCHKINEMATICSKERNELS_H
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+//! Max number of joints of the batched kernels (same as COMPILEDCHAIN_MAX_JOINTS)
+#define BATCH_MAX_JOINTS 64
+
+namespace sun
+{
+namespace batch
+{
+//! Plain view of a compiled chain used by the batched kernels
+struct ChainView
+{
+  int num_joints;
+  const double* a;
+  const double* sin_alpha;
+  const double* cos_alpha;
+  const double* d;
+  const double* theta;
+  uint64_t prismatic_mask;
+  double b_T_0[12];  // first 3 rows of b_T_0 (row-major)
+  double n_T_e[12];  // first 3 rows of n_T_e (row-major)
+};
+
+/*
+    Kernel entry points, the configurations [begin,end) are computed
+    q_DH[j*num_conf + k] is the j-th joint of the k-th configuration
+    b_T_e[(r*4+c)*num_conf + k] is the element (r,c) of the k-th pose (r<3)
+*/
+void fkine_scalar(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* b_T_e);
+#if defined(__SSE2__)
+void fkine_sse2(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* b_T_e);
+#endif
+#if defined(SUN_ROBOT_LIB_HAVE_AVX2)
+void fkine_avx2(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* b_T_e);
+#endif
+
+/*
+    jacob[(r*num_joints+c)*num_conf + k] is the element (r,c) of the k-th jacobian
+    b_T_e can be null
+*/
+void jacob_scalar(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* jacob,
+                  double* b_T_e);
+#if defined(__SSE2__)
+void jacob_sse2(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* jacob,
+                double* b_T_e);
+#endif
+#if defined(SUN_ROBOT_LIB_HAVE_AVX2)
+void jacob_avx2(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* jacob,
+                double* b_T_e);
+#endif
+
+namespace
+{
+/*=========PACKS=========*/
+// A pack holds "width" lanes, one configuration per lane.
+// Arithmetic uses the GCC/Clang vector extensions, so the same kernel source serves all the packs.
+
+struct PackScalar
+{
+  typedef double type;
+  static const int width = 1;
+  static inline type set1(double a)
+  {
+    return a;
+  }
+  static inline type load(const double* p)
+  {
+    return *p;
+  }
+  static inline void store(double* p, type v)
+  {
+    *p = v;
+  }
+  static inline void sincos(type x, type& s, type& c)
+  {
+    s = std::sin(x);
+    c = std::cos(x);
+  }
+};
+
+#if defined(__SSE2__)
+struct PackSSE2
+{
+  typedef __m128d type;
+  static const int width = 2;
+  static inline type set1(double a)
+  {
+    return _mm_set1_pd(a);
+  }
+  static inline type load(const double* p)
+  {
+    return _mm_loadu_pd(p);
+  }
+  static inline void store(double* p, type v)
+  {
+    _mm_storeu_pd(p, v);
+  }
+  // floor of non negative values smaller than 2^31
+  static inline type floor_nonneg(type v)
+  {
+    return _mm_cvtepi32_pd(_mm_cvttpd_epi32(v));
+  }
+  static inline type gt(type a, type b)
+  {
+    return _mm_cmpgt_pd(a, b);
+  }
+  static inline type select(type mask, type a, type b)
+  {
+    return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+  }
+  static inline void sincos(type x, type& s, type& c);
+};
+#endif
+
+#if defined(__AVX2__)
+struct PackAVX2
+{
+  typedef __m256d type;
+  static const int width = 4;
+  static inline type set1(double a)
+  {
+    return _mm256_set1_pd(a);
+  }
+  static inline type load(const double* p)
+  {
+    return _mm256_loadu_pd(p);
+  }
+  static inline void store(double* p, type v)
+  {
+    _mm256_storeu_pd(p, v);
+  }
+  static inline type floor_nonneg(type v)
+  {
+    return _mm256_floor_pd(v);
+  }
+  static inline type gt(type a, type b)
+  {
+    return _mm256_cmp_pd(a, b, _CMP_GT_OQ);
+  }
+  static inline type select(type mask, type a, type b)
+  {
+    return _mm256_blendv_pd(b, a, mask);
+  }
+  static inline void sincos(type x, type& s, type& c);
+};
+#endif
+
+/*
+    Vectorized sin and cos (Cephes algorithm)
+    The argument is reduced to [-pi/4,pi/4] with a 3-part Cody-Waite reduction,
+    then a polynomial approximation is used. Accurate to ~1 ulp for |x| < 2^30.
+*/
+template <class P>
+inline void sincos_poly(typename P::type x, typename P::type& s, typename P::type& c)
+{
+  typedef typename P::type V;
+
+  const V zero = P::set1(0.0);
+  const V half = P::set1(0.5);
+  const V one = P::set1(1.0);
+
+  const V neg_x = zero - x;
+  const V x_is_neg = P::gt(zero, x);
+  const V ax = P::select(x_is_neg, neg_x, x);
+
+  // octant (rounded to the even one), and quadrant in [0,3]
+  V y = P::floor_nonneg(ax * P::set1(1.27323954473516268615));  // 4/pi
+  y = P::set1(2.0) * P::floor_nonneg((y + one) * half);
+  const V quad = y * half - P::set1(4.0) * P::floor_nonneg(y * P::set1(0.125));
+
+  // extended precision modular arithmetic
+  V z = ((ax - y * P::set1(7.85398125648498535156E-1)) - y * P::set1(3.77489470793079817668E-8)) -
+        y * P::set1(2.69515142907905952645E-15);
+  const V zz = z * z;
+
+  V ps = P::set1(1.58962301576546568060E-10);
+  ps = ps * zz + P::set1(-2.50507477628578072866E-8);
+  ps = ps * zz + P::set1(2.75573136213857245213E-6);
+  ps = ps * zz + P::set1(-1.98412698295895385996E-4);
+  ps = ps * zz + P::set1(8.33333333332211858878E-3);
+  ps = ps * zz + P::set1(-1.66666666666666307295E-1);
+  ps = z + z * zz * ps;
+
+  V pc = P::set1(-1.13585365213876817300E-11);
+  pc = pc * zz + P::set1(2.08757008419747316778E-9);
+  pc = pc * zz + P::set1(-2.75573141792967388112E-7);
+  pc = pc * zz + P::set1(2.48015872888517045348E-5);
+  pc = pc * zz + P::set1(-1.38888888888730564116E-3);
+  pc = pc * zz + P::set1(4.16666666666665929218E-2);
+  pc = one - half * zz + zz * zz * pc;
+
+  // quadrant 1 and 3 swap sin and cos
+  const V odd = quad - P::set1(2.0) * P::floor_nonneg(quad * half);
+  const V swap = P::gt(odd, half);
+  const V s0 = P::select(swap, pc, ps);
+  const V c0 = P::select(swap, ps, pc);
+
+  // sin is negative in quadrants 2,3 - cos is negative in quadrants 1,2
+  const V s_neg = P::gt(quad, P::set1(1.5));
+  const V c_neg = P::select(P::gt(quad, half), P::gt(P::set1(2.5), quad), zero);
+  const V s1 = P::select(s_neg, zero - s0, s0);
+  s = P::select(x_is_neg, zero - s1, s1);
+  c = P::select(c_neg, zero - c0, c0);
+}
+
+#if defined(__SSE2__)
+inline void PackSSE2::sincos(type x, type& s, type& c)
+{
+  sincos_poly<PackSSE2>(x, s, c);
+}
+#endif
+
+#if defined(__AVX2__)
+inline void PackAVX2::sincos(type x, type& s, type& c)
+{
+  sincos_poly<PackAVX2>(x, s, c);
+}
+#endif
+
+/*=========END PACKS=========*/
+
+/*
+    Frame stored as columns of the rotation matrix and position, one lane per configuration
+*/
+template <class P>
+struct FramePack
+{
+  typename P::type x[3];  // first column of the rotation matrix
+  typename P::type y[3];  // second column of the rotation matrix
+  typename P::type z[3];  // third column of the rotation matrix
+  typename P::type p[3];  // position
+
+  //! Broadcast a 3x4 row-major matrix to all the lanes
+  inline void set(const double* T)
+  {
+    for (int r = 0; r < 3; r++)
+    {
+      x[r] = P::set1(T[r * 4 + 0]);
+      y[r] = P::set1(T[r * 4 + 1]);
+      z[r] = P::set1(T[r * 4 + 2]);
+      p[r] = P::set1(T[r * 4 + 3]);
+    }
+  }
+
+  /*
+      Post multiply by the DH matrix of link i (structure-aware affine product)
+      With R=[x y z]:
+          x' = ct*x + st*y
+          w  = ct*y - st*x
+          y' = ca*w + sa*z
+          z' = ca*z - sa*w
+          p' = p + a*x' + d*z
+  */
+  inline void mult_DH(const ChainView& chain, int i, typename P::type ct, typename P::type st, typename P::type d)
+  {
+    typedef typename P::type V;
+    const V sa = P::set1(chain.sin_alpha[i]);
+    const V ca = P::set1(chain.cos_alpha[i]);
+    const bool has_a = (chain.a[i] != 0.0);
+    const V a = P::set1(chain.a[i]);
+    for (int r = 0; r < 3; r++)
+    {
+      const V xr = ct * x[r] + st * y[r];
+      const V wr = ct * y[r] - st * x[r];
+      p[r] = p[r] + d * z[r];
+      if (has_a)
+      {
+        p[r] = p[r] + a * xr;
+      }
+      x[r] = xr;
+      y[r] = ca * wr + sa * z[r];
+      z[r] = ca * z[r] - sa * wr;
+    }
+  }
+
+  //! Post multiply by a constant 3x4 row-major transformation
+  inline void mult_const(const double* T)
+  {
+    typedef typename P::type V;
+    for (int r = 0; r < 3; r++)
+    {
+      const V xr = x[r], yr = y[r], zr = z[r];
+      x[r] = xr * P::set1(T[0]) + yr * P::set1(T[4]) + zr * P::set1(T[8]);
+      y[r] = xr * P::set1(T[1]) + yr * P::set1(T[5]) + zr * P::set1(T[9]);
+      z[r] = xr * P::set1(T[2]) + yr * P::set1(T[6]) + zr * P::set1(T[10]);
+      p[r] = p[r] + xr * P::set1(T[3]) + yr * P::set1(T[7]) + zr * P::set1(T[11]);
+    }
+  }
+
+  //! Store the lanes starting from configuration k
+  inline void store(double* out, int num_conf, int k) const
+  {
+    for (int r = 0; r < 3; r++)
+    {
+      P::store(out + (r * 4 + 0) * num_conf + k, x[r]);
+      P::store(out + (r * 4 + 1) * num_conf + k, y[r]);
+      P::store(out + (r * 4 + 2) * num_conf + k, z[r]);
+      P::store(out + (r * 4 + 3) * num_conf + k, p[r]);
+    }
+  }
+};
+
+/*
+    Move the frame from link i-1 to link i for the configurations loaded from q_DH
+*/
+template <class P>
+inline void step_joint(const ChainView& chain, int i, const double* q_DH, int num_conf, int k, FramePack<P>& T)
+{
+  typedef typename P::type V;
+  const V q = P::load(q_DH + i * num_conf + k);
+  V st, ct, d;
+  if ((chain.prismatic_mask >> i) & uint64_t(1))
+  {
+    st = P::set1(std::sin(chain.theta[i]));
+    ct = P::set1(std::cos(chain.theta[i]));
+    d = q;
+  }
+  else
+  {
+    P::sincos(q, st, ct);
+    d = P::set1(chain.d[i]);
+  }
+  T.mult_DH(chain, i, ct, st, d);
+}
+
+/*
+    fkine of the configurations [begin,end), end-begin must be a multiple of P::width
+*/
+template <class P>
+void fkine_kernel(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* b_T_e)
+{
+  for (int k = begin; k < end; k += P::width)
+  {
+    FramePack<P> T;
+    T.set(chain.b_T_0);
+    for (int i = 0; i < chain.num_joints; i++)
+    {
+      step_joint<P>(chain, i, q_DH, num_conf, k, T);
+    }
+    T.mult_const(chain.n_T_e);
+    T.store(b_T_e, num_conf, k);
+  }
+}
+
+/*
+    geometric jacobian (and optionally fkine) of the configurations [begin,end),
+    end-begin must be a multiple of P::width
+    The frames of each lane are kept on the stack and reused for all the columns
+*/
+template <class P>
+void jacob_kernel(const ChainView& chain, const double* q_DH, int num_conf, int begin, int end, double* jacob,
+                  double* b_T_e)
+{
+  typedef typename P::type V;
+  const int n = chain.num_joints;
+
+  V z[BATCH_MAX_JOINTS][3];  // z axis of frame i-1
+  V p[BATCH_MAX_JOINTS][3];  // origin of frame i-1
+
+  for (int k = begin; k < end; k += P::width)
+  {
+    FramePack<P> T;
+    T.set(chain.b_T_0);
+    for (int i = 0; i < n; i++)
+    {
+      for (int r = 0; r < 3; r++)
+      {
+        z[i][r] = T.z[r];
+        p[i][r] = T.p[r];
+      }
+      step_joint<P>(chain, i, q_DH, num_conf, k, T);
+    }
+    T.mult_const(chain.n_T_e);
+    if (b_T_e)
+    {
+      T.store(b_T_e, num_conf, k);
+    }
+
+    const V zero = P::set1(0.0);
+    for (int i = 0; i < n; i++)
+    {
+      V col[6];
+      if ((chain.prismatic_mask >> i) & uint64_t(1))
+      {
+        col[0] = z[i][0];
+        col[1] = z[i][1];
+        col[2] = z[i][2];
+        col[3] = zero;
+        col[4] = zero;
+        col[5] = zero;
+      }
+      else
+      {
+        // z_i_1 ^ (p_e - p_i_1)
+        const V dx = T.p[0] - p[i][0];
+        const V dy = T.p[1] - p[i][1];
+        const V dz = T.p[2] - p[i][2];
+        col[0] = z[i][1] * dz - z[i][2] * dy;
+        col[1] = z[i][2] * dx - z[i][0] * dz;
+        col[2] = z[i][0] * dy - z[i][1] * dx;
+        col[3] = z[i][0];
+        col[4] = z[i][1];
+        col[5] = z[i][2];
+      }
+      for (int r = 0; r < 6; r++)
+      {
+        P::store(jacob + (r * n + i) * num_conf + k, col[r]);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+}  // namespace batch
+}  // namespace sun
+
+#endif
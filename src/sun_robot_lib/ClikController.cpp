@@ -0,0 +1,301 @@
+/*
+
+    Stateful CLIK Controller
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <chrono>
+#include "sun_robot_lib/ClikController.h"
+
+using namespace TooN;
+using namespace std;
+
+namespace sun
+{
+/*======CONSTRUCTORS======*/
+
+/*
+    Full constructor
+    The null space objective is disabled (gain_null_space = 0), the mask is all ones
+*/
+ClikController::ClikController(Robot& robot, double gain, double Ts)
+  : _robot(robot)
+  , _ws(robot.getNumJoints())
+  , _gain(gain)
+  , _Ts(Ts)
+  , _gain_null_space(0.0)
+  , _mask(Ones)
+  , _desired_configuration(Zeros(robot.getNumJoints()))
+  , _null_space_scale(Zeros(robot.getNumJoints()))
+  , _q0_p(Zeros(robot.getNumJoints()))
+  , _qpDH(Zeros(robot.getNumJoints()))
+  , _error(Zeros)
+  , _total_ns(0.0)
+{
+}
+
+/*======END CONSTRUCTORS======*/
+
+/*=========GETTERS=========*/
+
+/*
+    get the controlled robot
+*/
+Robot& ClikController::getRobot() const
+{
+  return _robot;
+}
+
+/*
+    get the CLIK gain
+*/
+double ClikController::getGain() const
+{
+  return _gain;
+}
+
+/*
+    get the sampling time
+*/
+double ClikController::getTs() const
+{
+  return _Ts;
+}
+
+/*
+    get the null space gain
+*/
+double ClikController::getNullSpaceGain() const
+{
+  return _gain_null_space;
+}
+
+/*
+    get the operative space mask
+*/
+const Vector<6, int>& ClikController::getMask() const
+{
+  return _mask;
+}
+
+/*
+    get the quaternion at the last step
+*/
+const UnitQuaternion& ClikController::getQuaternion() const
+{
+  return _Q;
+}
+
+/*
+    get the joint velocity of the last step
+*/
+const Vector<>& ClikController::getJointVelocity() const
+{
+  return _qpDH;
+}
+
+/*
+    get the error of the last step
+*/
+const Vector<6>& ClikController::getError() const
+{
+  return _error;
+}
+
+/*
+    get the timing statistics of step()
+*/
+const ClikTimingStats& ClikController::getTimingStats() const
+{
+  return _stats;
+}
+
+/*=========END GETTERS=========*/
+
+/*=========SETTERS=========*/
+
+/*
+    set the CLIK gain
+*/
+void ClikController::setGain(double gain)
+{
+  _gain = gain;
+}
+
+/*
+    set the sampling time
+*/
+void ClikController::setTs(double Ts)
+{
+  _Ts = Ts;
+}
+
+/*
+    set the operative space mask
+*/
+void ClikController::setMask(const Vector<6, int>& mask)
+{
+  _mask = mask;
+}
+
+/*
+    set the joint mask (empty = all the joints are active)
+*/
+void ClikController::setJointMask(const vector<bool>& joint_mask)
+{
+  if (!joint_mask.empty() && (int)joint_mask.size() != _robot.getNumJoints())
+  {
+    cout << ROBOT_ERROR_COLOR "[ClikController] Error in setJointMask(): joint_mask has size " << joint_mask.size()
+         << " but the robot has " << _robot.getNumJoints() << " joints" ROBOT_CRESET << endl;
+    exit(-1);
+  }
+  _joint_mask = joint_mask;
+}
+
+/*
+    set the null space objective: minimize the weighted distance from desired_configuration (DH convention)
+    The scale of each joint is precomputed here as in Robot::grad_fcst_target_configuration,
+    so that step() computes the gradient without allocations
+*/
+void ClikController::setNullSpaceObjective(double gain_null_space, const Vector<>& desired_configuration,
+                                           const Vector<>& desired_configuration_joint_weights)
+{
+  const int numQ = _robot.getNumJoints();
+  if (desired_configuration.size() != numQ || desired_configuration_joint_weights.size() != numQ)
+  {
+    cout << ROBOT_ERROR_COLOR "[ClikController] Error in setNullSpaceObjective(): wrong size of the inputs, the "
+                              "robot has "
+         << numQ << " joints" ROBOT_CRESET << endl;
+    exit(-1);
+  }
+
+  _gain_null_space = gain_null_space;
+  _desired_configuration = desired_configuration;
+
+  double sum_w = 0.0;
+  for (int i = 0; i < numQ; i++)
+  {
+    sum_w += desired_configuration_joint_weights[i];
+  }
+
+  const CompiledChain& chain = _robot.getCompiledChain();
+  for (int i = 0; i < numQ; i++)
+  {
+    const double lower = chain.soft_limit_lower[i];
+    const double higher = chain.soft_limit_higher[i];
+    if (isinf(lower) || isinf(higher))
+    {
+      _null_space_scale[i] = 0.0;
+    }
+    else
+    {
+      const double range = fabs(chain.joint_Robot2DH(i, higher) - chain.joint_Robot2DH(i, lower));
+      _null_space_scale[i] = desired_configuration_joint_weights[i] / range / sum_w;
+    }
+  }
+}
+
+/*=========END SETTERS=========*/
+
+/*
+    Reset the quaternion continuity state to the identity, the outputs and the timing statistics
+*/
+void ClikController::reset()
+{
+  _Q = UnitQuaternion();
+  _qpDH = Zeros;
+  _error = Zeros;
+  resetTimingStats();
+}
+
+/*
+    Reset as above, the quaternion continuity state is the orientation of the end-effector in qDH
+*/
+void ClikController::reset(const Vector<>& qDH)
+{
+  reset();
+  _robot.fkine_all(qDH, _ws);
+  _Q = UnitQuaternion(_ws.all_T.back().R);
+}
+
+/*
+    Reset the timing statistics only
+*/
+void ClikController::resetTimingStats()
+{
+  _stats = ClikTimingStats();
+  _total_ns = 0.0;
+}
+
+/*
+    CLIK step
+    Outputs:
+        return: qDH_k+1 joints at time k+1 (valid until the next step)
+    This function does not allocate memory
+*/
+const Vector<>& ClikController::step(const Vector<>& qDH_k, const Vector<3>& pd, const UnitQuaternion& Qd,
+                                     const Vector<3>& dpd, const Vector<3>& omegad)
+{
+  const auto t_start = chrono::steady_clock::now();
+
+  const int numQ = _ws.getNumJoints();
+
+  // Null space objective
+  if (_gain_null_space != 0.0)
+  {
+    for (int i = 0; i < numQ; i++)
+    {
+      _q0_p[i] = -(qDH_k[i] - _desired_configuration[i]) * _null_space_scale[i];
+    }
+  }
+
+  const UnitQuaternion oldQ = _Q;
+  if (_joint_mask.empty())
+  {
+    _robot.clik(qDH_k, pd, Qd, oldQ, dpd, omegad, _mask, _gain, _Ts, _gain_null_space, _q0_p, _ws,
+                // Return Vars
+                _qpDH, _error, _Q);
+  }
+  else
+  {
+    _robot.clik(qDH_k, pd, Qd, oldQ, dpd, omegad, _mask, _joint_mask, _gain, _Ts, _gain_null_space, _q0_p, _ws,
+                // Return Vars
+                _qpDH, _error, _Q);
+  }
+
+  // Timing
+  const double dt_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - t_start).count();
+  _stats.num_steps++;
+  _stats.last_ns = dt_ns;
+  if (_stats.num_steps == 1 || dt_ns < _stats.min_ns)
+  {
+    _stats.min_ns = dt_ns;
+  }
+  if (_stats.num_steps == 1 || dt_ns > _stats.max_ns)
+  {
+    _stats.max_ns = dt_ns;
+  }
+  _total_ns += dt_ns;
+  _stats.mean_ns = _total_ns / _stats.num_steps;
+
+  return _ws.qDH_k1;
+}
+
+}  // namespace sun
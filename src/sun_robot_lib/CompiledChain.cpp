@@ -0,0 +1,323 @@
+/*
+
+    Compiled Kinematic Chain
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "sun_robot_lib/CompiledChain.h"
+
+using namespace TooN;
+using namespace std;
+
+namespace sun
+{
+namespace
+{
+/*
+    Special values of the link twist
+*/
+enum DHAlphaType
+{
+  DH_ALPHA_GENERAL = 0,
+  DH_ALPHA_ZERO,
+  DH_ALPHA_PLUS_PI_2,
+  DH_ALPHA_MINUS_PI_2,
+  DH_ALPHA_NUM_TYPES
+};
+
+/*
+    T = T*A(a,alpha,d,theta) for the DH pattern given by the template parameters
+    (see RigidTransform::postMultDH, here the zero terms are skipped and the sign flips are folded)
+*/
+template <int ALPHA, bool HAS_A, bool HAS_D>
+void postMultDHKernel(double a, double sin_alpha, double cos_alpha, double d, double sin_theta, double cos_theta,
+                      RigidTransform& T)
+{
+  for (int r = 0; r < 3; r++)
+  {
+    const double x = T.R(r, 0);
+    const double y = T.R(r, 1);
+    const double z = T.R(r, 2);
+    const double xn = x * cos_theta + y * sin_theta;
+    const double u = y * cos_theta - x * sin_theta;
+    T.R(r, 0) = xn;
+    switch (ALPHA)
+    {
+      case DH_ALPHA_ZERO:
+      {
+        T.R(r, 1) = u;
+        break;
+      }
+      case DH_ALPHA_PLUS_PI_2:
+      {
+        T.R(r, 1) = z;
+        T.R(r, 2) = -u;
+        break;
+      }
+      case DH_ALPHA_MINUS_PI_2:
+      {
+        T.R(r, 1) = -z;
+        T.R(r, 2) = u;
+        break;
+      }
+      default:
+      {
+        T.R(r, 1) = u * cos_alpha + z * sin_alpha;
+        T.R(r, 2) = z * cos_alpha - u * sin_alpha;
+      }
+    }
+    if (HAS_A)
+    {
+      T.p[r] += a * xn;
+    }
+    if (HAS_D)
+    {
+      T.p[r] += d * z;
+    }
+  }
+}
+
+template <int ALPHA>
+CompiledChain::DHKernel selectDHKernel(bool has_a, bool has_d)
+{
+  if (has_a)
+  {
+    return has_d ? &postMultDHKernel<ALPHA, true, true> : &postMultDHKernel<ALPHA, true, false>;
+  }
+  return has_d ? &postMultDHKernel<ALPHA, false, true> : &postMultDHKernel<ALPHA, false, false>;
+}
+
+/*
+    Select the compose routine of a link
+*/
+CompiledChain::DHKernel selectDHKernel(double sin_alpha, double cos_alpha, bool has_a, bool has_d)
+{
+  if (fabs(sin_alpha) < COMPILEDCHAIN_DH_EPS && fabs(cos_alpha - 1.0) < COMPILEDCHAIN_DH_EPS)
+  {
+    return selectDHKernel<DH_ALPHA_ZERO>(has_a, has_d);
+  }
+  if (fabs(cos_alpha) < COMPILEDCHAIN_DH_EPS && fabs(sin_alpha - 1.0) < COMPILEDCHAIN_DH_EPS)
+  {
+    return selectDHKernel<DH_ALPHA_PLUS_PI_2>(has_a, has_d);
+  }
+  if (fabs(cos_alpha) < COMPILEDCHAIN_DH_EPS && fabs(sin_alpha + 1.0) < COMPILEDCHAIN_DH_EPS)
+  {
+    return selectDHKernel<DH_ALPHA_MINUS_PI_2>(has_a, has_d);
+  }
+  return selectDHKernel<DH_ALPHA_GENERAL>(has_a, has_d);
+}
+
+}  // namespace
+
+/*======CONSTRUCTORS======*/
+
+/*
+    Empty chain
+*/
+CompiledChain::CompiledChain() : num_joints(0), prismatic_mask(0)
+{
+}
+
+/*======END CONSTRUCTORS======*/
+
+/*
+    Flatten the vector of links into the table
+    specialize: if true the compose routine of each link is specialized on its DH pattern,
+    otherwise the general routine is used for all the links
+*/
+void CompiledChain::build(const vector<RobotLinkPtr>& links, bool specialize)
+{
+  num_joints = links.size();
+
+  if (num_joints > COMPILEDCHAIN_MAX_JOINTS)
+  {
+    cout << ROBOT_ERROR_COLOR "[CompiledChain] Error in build( const vector<RobotLinkPtr>& links ): too many links ["
+         << num_joints << "]" ROBOT_CRESET << endl;
+    exit(-1);
+  }
+
+  a.resize(num_joints);
+  sin_alpha.resize(num_joints);
+  cos_alpha.resize(num_joints);
+  d.resize(num_joints);
+  theta.resize(num_joints);
+  sin_theta.resize(num_joints);
+  cos_theta.resize(num_joints);
+  dh_kernel.resize(num_joints);
+  robot2dh_offset.resize(num_joints);
+  robot2dh_sign.resize(num_joints);
+  hard_limit_lower.resize(num_joints);
+  hard_limit_higher.resize(num_joints);
+  soft_limit_lower.resize(num_joints);
+  soft_limit_higher.resize(num_joints);
+  hard_velocity_limit.resize(num_joints);
+  soft_velocity_limit.resize(num_joints);
+  mass.resize(num_joints);
+  com.resize(num_joints);
+  inertia.resize(num_joints);
+  prismatic_mask = 0;
+
+  for (int i = 0; i < num_joints; i++)
+  {
+    const RobotLink& link = *links[i];
+
+    switch (link.type())
+    {
+      case 'p':  // Prismatic
+      {
+        prismatic_mask |= (uint64_t(1) << i);
+        break;
+      }
+
+      case 'r':  // Revolute
+      {
+        break;
+      }
+
+      default:
+      {
+        cout << ROBOT_ERROR_COLOR "[CompiledChain] Error in build( const vector<RobotLinkPtr>& links ): invalid "
+                                  "links["
+             << i << "].type()=" << link.type() << ROBOT_CRESET << endl;
+        exit(-1);
+      }
+    }
+
+    a[i] = link.getDH_a();
+    sin_alpha[i] = sin(link.getDH_alpha());
+    cos_alpha[i] = cos(link.getDH_alpha());
+    d[i] = link.getDH_d();
+    theta[i] = link.getDH_theta();
+
+    // the joint variable is never considered zero
+    if (!specialize)
+    {
+      sin_theta[i] = sin(theta[i]);
+      cos_theta[i] = cos(theta[i]);
+      dh_kernel[i] = &postMultDHKernel<DH_ALPHA_GENERAL, true, true>;
+    }
+    else if (isPrismatic(i))
+    {
+      sin_theta[i] = sin(theta[i]);
+      cos_theta[i] = cos(theta[i]);
+      dh_kernel[i] = selectDHKernel(sin_alpha[i], cos_alpha[i], a[i] != 0.0, true);
+    }
+    else
+    {
+      sin_theta[i] = 0.0;
+      cos_theta[i] = 1.0;
+      dh_kernel[i] = selectDHKernel(sin_alpha[i], cos_alpha[i], a[i] != 0.0, d[i] != 0.0);
+    }
+
+    robot2dh_offset[i] = link.getRobot2DH_offset();
+    robot2dh_sign[i] = link.getRobot2DH_flip() ? -1.0 : 1.0;
+
+    Vector<2> limits = link.getHardJointLimits();
+    hard_limit_lower[i] = limits[0];
+    hard_limit_higher[i] = limits[1];
+    limits = link.getSoftJointLimits();
+    soft_limit_lower[i] = limits[0];
+    soft_limit_higher[i] = limits[1];
+    hard_velocity_limit[i] = link.getHardVelocityLimit();
+    soft_velocity_limit[i] = link.getSoftVelocityLimit();
+
+    mass[i] = link.getMass();
+    com[i] = link.getCOM();
+    inertia[i] = link.getInertia();
+  }
+}
+
+/*
+    Return true if the i-th joint is prismatic
+*/
+bool CompiledChain::isPrismatic(int i) const
+{
+  return ((prismatic_mask >> i) & uint64_t(1)) != 0;
+}
+
+/*
+    Compute the transform matrix of the i-th link
+    input q_DH in DH convention
+*/
+Matrix<4, 4> CompiledChain::A(int i, double q_DH) const
+{
+  const bool prismatic = isPrismatic(i);
+  const double th = prismatic ? theta[i] : q_DH;
+  const double dd = prismatic ? q_DH : d[i];
+
+  const double sa = sin_alpha[i];
+  const double ca = cos_alpha[i];
+
+  const double st = sin(th);
+  const double ct = cos(th);
+
+  // standard DH
+  return Data(ct, -st * ca, st * sa, a[i] * ct, st, ct * ca, -ct * sa, a[i] * st, 0.0, sa, ca, dd, 0.0, 0.0, 0.0, 1.0);
+}
+
+/*
+    Post-multiply T by the transform matrix of the i-th link: T = T*A_i(q_DH)
+    input q_DH in DH convention
+*/
+void CompiledChain::postMultA(int i, double q_DH, RigidTransform& T) const
+{
+  if (isPrismatic(i))
+  {
+    dh_kernel[i](a[i], sin_alpha[i], cos_alpha[i], q_DH, sin_theta[i], cos_theta[i], T);
+  }
+  else
+  {
+    dh_kernel[i](a[i], sin_alpha[i], cos_alpha[i], d[i], sin(q_DH), cos(q_DH), T);
+  }
+}
+
+/*
+    Transform the i-th joint from robot to DH convention
+*/
+double CompiledChain::joint_Robot2DH(int i, double q_Robot) const
+{
+  return robot2dh_sign[i] * q_Robot + robot2dh_offset[i];
+}
+
+/*
+    Transform the i-th joint from DH to robot convention
+*/
+double CompiledChain::joint_DH2Robot(int i, double q_DH) const
+{
+  return robot2dh_sign[i] * (q_DH - robot2dh_offset[i]);
+}
+
+/*
+    Transform the i-th joint velocity from robot to DH convention
+*/
+double CompiledChain::jointvel_Robot2DH(int i, double q_vel_Robot) const
+{
+  return robot2dh_sign[i] * q_vel_Robot;
+}
+
+/*
+    Transform the i-th joint velocity from DH to robot convention
+*/
+double CompiledChain::jointvel_DH2Robot(int i, double q_vel_DH) const
+{
+  return robot2dh_sign[i] * q_vel_DH;
+}
+
+}  // namespace sun
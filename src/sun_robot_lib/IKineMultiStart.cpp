@@ -0,0 +1,364 @@
+/*
+
+    Multi-start Inverse Kinematics
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <condition_variable>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <random>
+#include "sun_robot_lib/Robot.h"
+
+using namespace TooN;
+using namespace std;
+
+namespace sun
+{
+/*
+    Persistent workers of ikine_multistart
+    Each thread owns a clone of the robot, the clones are rebuilt when the kinematics id of the robot changes.
+    The threads wait for a job (a new generation), the workers with index >= the number of workers of the job
+    skip it. The threads are created on demand and joined by the destructor.
+*/
+class IKineWorkerPool
+{
+public:
+  /*
+      State shared by the workers of a call of ikine_multistart
+  */
+  struct State
+  {
+    const Matrix<4, 4>* b_T_e;
+    const vector<Vector<>>* qDH_seeds;
+    const IKineOptions* options;
+
+    // next seed to solve
+    atomic<int> next_seed;
+    // set by the first accepted solution, cancels the other solves
+    atomic<bool> found;
+
+    // protected by mutex
+    mutex mtx;
+    IKineResult result;
+    Vector<> q_DH;
+    int seed_index;
+    double best_error;
+    int num_completed;  // solves not cancelled
+
+    explicit State(int num_joints) : q_DH(Zeros(num_joints))
+    {
+    }
+  };
+
+  //! Locked by the call of ikine_multistart that is using the pool
+  mutex busy;
+
+  IKineWorkerPool() : _kinematics_id(0), _job(nullptr), _num_workers(0), _generation(0), _pending(0), _stop(false)
+  {
+  }
+
+  ~IKineWorkerPool()
+  {
+    {
+      lock_guard<mutex> lock(_mutex);
+      _stop = true;
+    }
+    _start.notify_all();
+    for (auto& worker : _threads)
+    {
+      worker.join();
+    }
+  }
+
+  /*
+      Solve the seeds of state with robot in the calling thread and num_workers threads of the pool,
+      return when all the workers are done (busy must be locked)
+  */
+  void run(const Robot& robot, int num_workers, State& state)
+  {
+    unique_lock<mutex> lock(_mutex);
+
+    // no worker is running, the clones can be replaced
+    const uint64_t kinematics_id = robot._kinematics_id;
+    if (kinematics_id != _kinematics_id)
+    {
+      for (auto& clone : _clones)
+      {
+        clone.reset(robot.clone());
+      }
+      _kinematics_id = kinematics_id;
+    }
+    while ((int)_threads.size() < num_workers)
+    {
+      _clones.push_back(unique_ptr<Robot>(robot.clone()));
+      // the new thread starts from the current generation, so it takes the job below
+      _threads.push_back(thread(&IKineWorkerPool::workerLoop, this, (int)_threads.size(), _generation));
+    }
+
+    _job = &state;
+    _num_workers = num_workers;
+    _pending = num_workers;
+    _generation++;
+    lock.unlock();
+    _start.notify_all();
+
+    solve(robot, state);
+
+    lock.lock();
+    _done.wait(lock, [this] { return _pending == 0; });
+    _job = nullptr;
+  }
+
+  /*
+      Solve the seeds of state until they are finished, a solution is found or the caller cancels the search
+  */
+  static void solve(const Robot& robot, State& state)
+  {
+    const int numQ = robot.getNumJoints();
+    const int num_seeds = state.qDH_seeds->size();
+    KinematicsWorkspace ws(numQ);
+    Vector<> q_DH = Zeros(numQ);
+
+    while (!stopped(state))
+    {
+      const int i = state.next_seed.fetch_add(1);
+      if (i >= num_seeds)
+      {
+        return;
+      }
+
+      IKineResult result =
+          robot.ikine_internal(*state.b_T_e, (*state.qDH_seeds)[i], *state.options, &state.found, ws, q_DH);
+      if (result.status == IKINE_CANCELLED)
+      {
+        return;
+      }
+
+      const bool accepted =
+          result.status == IKINE_SUCCESS && !robot.exceededSoftJointLimits(robot.joints_DH2Robot(q_DH));
+      if (result.status == IKINE_SUCCESS && !accepted)
+      {
+        result.status = IKINE_SOFT_LIMITS;
+      }
+      const double error = result.error_position + result.error_orientation;
+
+      lock_guard<mutex> lock(state.mtx);
+      state.num_completed++;
+      if (state.found.load())
+      {
+        return;
+      }
+      // an accepted solution always replaces the best one; otherwise keep the lowest error
+      // (ties are broken by the seed index, so that the result does not depend on the scheduling)
+      if (accepted || state.seed_index < 0 || error < state.best_error ||
+          (error == state.best_error && i < state.seed_index))
+      {
+        state.result = result;
+        state.q_DH = q_DH;
+        state.seed_index = i;
+        state.best_error = error;
+      }
+      if (accepted)
+      {
+        state.found.store(true);
+        return;
+      }
+    }
+  }
+
+private:
+  // protected by _mutex
+  mutex _mutex;
+  condition_variable _start;
+  condition_variable _done;
+  vector<unique_ptr<Robot>> _clones;
+  vector<thread> _threads;
+  uint64_t _kinematics_id;  // of the clones
+  State* _job;
+  int _num_workers;
+  uint64_t _generation;
+  int _pending;
+  bool _stop;
+
+  /*
+      Return true if the workers must stop: a solution is found or the caller cancelled the search
+  */
+  static bool stopped(const State& state)
+  {
+    return state.found.load() || (state.options->cancel != nullptr && state.options->cancel->load());
+  }
+
+  /*
+      Loop of the thread index: wait for a job and solve it with its clone
+  */
+  void workerLoop(int index, uint64_t generation)
+  {
+    unique_lock<mutex> lock(_mutex);
+    while (true)
+    {
+      _start.wait(lock, [this, generation] { return _stop || _generation != generation; });
+      if (_stop)
+      {
+        return;
+      }
+      generation = _generation;
+      if (index >= _num_workers)
+      {
+        continue;
+      }
+      const Robot& robot = *_clones[index];
+      State& state = *_job;
+      lock.unlock();
+
+      solve(robot, state);
+
+      lock.lock();
+      if (--_pending == 0)
+      {
+        _done.notify_one();
+      }
+    }
+  }
+};
+
+/*
+    Multi-start inverse kinematics
+    The seeds are solved with ikine by the calling thread and num_threads-1 threads of _ikine_pool,
+    each thread of the pool uses its own clone() of the robot. If the pool is used by another call,
+    the seeds are solved in the calling thread only.
+    The first solution within the tolerances and the soft joint limits cancels the remaining solves,
+    the workers poll also options.cancel of the caller.
+    Outputs:
+        return: the result of the accepted solve, otherwise the result of the solve with the lowest error
+                (status IKINE_CANCELLED if the caller cancelled the search)
+        q_DH: the solution in DH convention, must be of size NUM_JOINT
+        seed_index: index in qDH_seeds of the returned solution (-1 if no solve was completed)
+*/
+IKineResult Robot::ikine_multistart(const Matrix<4, 4>& b_T_e, const vector<Vector<>>& qDH_seeds,
+                                    // Return Vars
+                                    Vector<>& q_DH, int& seed_index, const IKineOptions& options,
+                                    int num_threads) const
+{
+  if (qDH_seeds.empty())
+  {
+    cout << ROBOT_ERROR_COLOR "[Robot] Error in ikine_multistart( ... ): no seeds" ROBOT_CRESET << endl;
+    exit(-1);
+  }
+
+  IKineWorkerPool::State state(getNumJoints());
+  state.b_T_e = &b_T_e;
+  state.qDH_seeds = &qDH_seeds;
+  state.options = &options;
+  state.next_seed.store(0);
+  state.found.store(false);
+  state.seed_index = -1;
+  state.best_error = 0.0;
+  state.num_completed = 0;
+
+  if (num_threads > (int)qDH_seeds.size())
+  {
+    num_threads = qDH_seeds.size();
+  }
+
+  // the chain (and the kinematics id of the clones) is up to date
+  getCompiledChain();
+
+  shared_ptr<IKineWorkerPool> pool;
+  if (num_threads > 1)
+  {
+    lock_guard<mutex> lock(_ikine_pool_mutex);
+    if (!_ikine_pool)
+    {
+      _ikine_pool = make_shared<IKineWorkerPool>();
+    }
+    pool = _ikine_pool;
+  }
+
+  if (pool && pool->busy.try_lock())
+  {
+    pool->run(*this, num_threads - 1, state);
+    pool->busy.unlock();
+  }
+  else
+  {
+    IKineWorkerPool::solve(*this, state);
+  }
+
+  // without an accepted solution, the seeds are not all solved only if the caller cancelled the search
+  if (!state.found.load() && state.num_completed < (int)qDH_seeds.size())
+  {
+    state.result.status = IKINE_CANCELLED;
+  }
+
+  q_DH = state.q_DH;
+  seed_index = state.seed_index;
+  return state.result;
+}
+
+/*
+    Multi-start inverse kinematics with random seeds
+    The first seed is qDH_seed, the other num_seeds-1 seeds are uniformly distributed within the soft joint limits
+    (the hard limits if the soft ones are infinite, the joint of qDH_seed if also the hard limits are infinite)
+*/
+IKineResult Robot::ikine_multistart(const Matrix<4, 4>& b_T_e, const Vector<>& qDH_seed, int num_seeds,
+                                    unsigned int random_seed,
+                                    // Return Vars
+                                    Vector<>& q_DH, int& seed_index, const IKineOptions& options,
+                                    int num_threads) const
+{
+  const int numQ = getNumJoints();
+  mt19937 generator(random_seed);
+  uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  // sampling interval of each joint: the soft limits, the hard limits if the soft ones are infinite,
+  // the joint of qDH_seed if also the hard limits are infinite
+  vector<Vector<2>> intervals(numQ);
+  vector<bool> sampled(numQ);
+  for (int i = 0; i < numQ; i++)
+  {
+    intervals[i] = _links[i]->getSoftJointLimits();
+    if (isinf(intervals[i][0]) || isinf(intervals[i][1]))
+    {
+      intervals[i] = _links[i]->getHardJointLimits();
+    }
+    sampled[i] = !isinf(intervals[i][0]) && !isinf(intervals[i][1]);
+  }
+
+  vector<Vector<>> qDH_seeds;
+  qDH_seeds.push_back(qDH_seed);
+  Vector<> q_R = joints_DH2Robot(qDH_seed);
+  for (int k = 1; k < num_seeds; k++)
+  {
+    for (int i = 0; i < numQ; i++)
+    {
+      if (sampled[i])
+      {
+        q_R[i] = intervals[i][0] + (intervals[i][1] - intervals[i][0]) * uniform(generator);
+      }
+    }
+    qDH_seeds.push_back(joints_Robot2DH(q_R));
+  }
+
+  return ikine_multistart(b_T_e, qDH_seeds, q_DH, seed_index, options, num_threads);
+}
+
+}  // namespace sun
@@ -0,0 +1,295 @@
+/*
+
+    Trajectory Inverse Kinematics
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <thread>
+#include <memory>
+#include "sun_robot_lib/Robot.h"
+
+//! Minimum number of samples of each parallel segment of ikine_trajectory
+#define IKTRAJ_MIN_SAMPLES_PER_THREAD 256
+
+//! Stride of the coarse sequential pass that seeds the segments of ikine_trajectory
+#define IKTRAJ_COARSE_STRIDE 16
+
+//! Two solutions of the same sample closer than this (joint norm) are on the same branch
+#define IKTRAJ_STITCH_TOL 1.0E-3
+
+using namespace TooN;
+using namespace std;
+
+namespace sun
+{
+namespace
+{
+/*
+    Solve the k-th sample of the path warm-starting from the previous solutions in q_DH
+    the samples from first are warm-started: the sample first is seeded with qDH_first_seed, the next one with
+    the previous solution, the others with the linear extrapolation of the last two solutions
+    (the previous solution if the extrapolated seed fails)
+    ws and seed are work variables of size NUM_JOINT, the solution is q_k (q_DH is not modified)
+*/
+IKineResult solveSample(const Robot& robot, const vector<Matrix<4, 4>>& b_T_e, int k, int first,
+                        const Vector<>& qDH_first_seed, const IKineOptions& options, KinematicsWorkspace& ws,
+                        Vector<>& seed, const double* q_DH,
+                        // Return Vars
+                        Vector<>& q_k)
+{
+  const int numQ = ws.getNumJoints();
+  const double* q_prev = q_DH + (k - 1) * numQ;
+  if (k == first)
+  {
+    return robot.ikine(b_T_e[k], qDH_first_seed, options, ws, q_k);
+  }
+  if (k == first + 1)
+  {
+    for (int i = 0; i < numQ; i++)
+    {
+      seed[i] = q_prev[i];
+    }
+    return robot.ikine(b_T_e[k], seed, options, ws, q_k);
+  }
+
+  // linear extrapolation of the last two samples
+  const double* q_prev_prev = q_prev - numQ;
+  for (int i = 0; i < numQ; i++)
+  {
+    seed[i] = 2.0 * q_prev[i] - q_prev_prev[i];
+  }
+  IKineResult result = robot.ikine(b_T_e[k], seed, options, ws, q_k);
+  if (result.status != IKINE_SUCCESS)
+  {
+    for (int i = 0; i < numQ; i++)
+    {
+      seed[i] = q_prev[i];
+    }
+    result = robot.ikine(b_T_e[k], seed, options, ws, q_k);
+  }
+  return result;
+}
+
+/*
+    Store q_k and the error of result as the k-th sample
+*/
+void storeSample(const Vector<>& q_k, const IKineResult& result, int k,
+                 // Return Vars
+                 double* q_DH, double* error)
+{
+  const int numQ = q_k.size();
+  double* q_out = q_DH + k * numQ;
+  for (int i = 0; i < numQ; i++)
+  {
+    q_out[i] = q_k[i];
+  }
+  error[2 * k] = result.error_position;
+  error[2 * k + 1] = result.error_orientation;
+}
+
+/*
+    Solve the samples [begin,end) of the path warm-starting from the previous solutions (see solveSample)
+    ws, seed and q_k are work variables of size NUM_JOINT
+*/
+void solveSegment(const Robot& robot, const vector<Matrix<4, 4>>& b_T_e, int begin, int end, int first,
+                  const Vector<>& qDH_first_seed, const IKineOptions& options, KinematicsWorkspace& ws, Vector<>& seed,
+                  Vector<>& q_k,
+                  // Return Vars
+                  double* q_DH, double* error)
+{
+  for (int k = begin; k < end; k++)
+  {
+    const IKineResult result = solveSample(robot, b_T_e, k, first, qDH_first_seed, options, ws, seed, q_DH, q_k);
+    storeSample(q_k, result, k, q_DH, error);
+  }
+}
+
+/*
+    Return true if the k-th sample is not within the tolerances of options
+*/
+bool sampleFailed(const double* error, int k, const IKineOptions& options)
+{
+  return error[2 * k] > options.tolerance_position || error[2 * k + 1] > options.tolerance_orientation;
+}
+
+/*
+    Joint distance between q_k and the k-th sample of q_DH
+*/
+double sampleDistance(const Vector<>& q_k, const double* q_DH, int k)
+{
+  const int numQ = q_k.size();
+  double dist_sq = 0.0;
+  for (int i = 0; i < numQ; i++)
+  {
+    const double d = q_k[i] - q_DH[k * numQ + i];
+    dist_sq += d * d;
+  }
+  return sqrt(dist_sq);
+}
+
+}  // namespace
+
+/*
+    Trajectory inverse kinematics
+    Each sample is solved with ikine, warm-started from the previous solutions.
+    With num_threads > 1 the path is split in segments solved in parallel, seeded by a coarse sequential pass
+    and stitched at the boundaries: a segment on a different branch or with failed samples is solved again
+    sequentially.
+    Outputs:
+        return: number of samples that did not converge within the tolerances
+        q_DH: joint positions, q_DH[k*NUM_JOINT + j] is the j-th joint of the k-th sample
+        qDH_dot: joint velocities (backward differences, zero for the first sample), same layout of q_DH
+        error: error[2*k] and error[2*k+1] are the position and orientation error norms of the k-th sample
+*/
+int Robot::ikine_trajectory(const vector<Matrix<4, 4>>& b_T_e, double Ts, const Vector<>& qDH_seed,
+                            // Return Vars
+                            double* q_DH, double* qDH_dot, double* error, const IKineOptions& options,
+                            int num_threads) const
+{
+  const int numQ = getNumJoints();
+  const int num_samples = b_T_e.size();
+  if (num_samples == 0)
+  {
+    return 0;
+  }
+
+  int max_threads = num_samples / IKTRAJ_MIN_SAMPLES_PER_THREAD;
+  if (num_threads > max_threads)
+  {
+    num_threads = max_threads;
+  }
+
+  KinematicsWorkspace ws(numQ);
+  Vector<> seed = Zeros(numQ);
+  Vector<> q_k = Zeros(numQ);
+
+  if (num_threads <= 1)
+  {
+    solveSegment(*this, b_T_e, 0, num_samples, 0, qDH_seed, options, ws, seed, q_k, q_DH, error);
+  }
+  else
+  {
+    vector<int> segment_begin(num_threads + 1);
+    const int chunk = (num_samples + num_threads - 1) / num_threads;
+    for (int s = 0; s < num_threads; s++)
+    {
+      segment_begin[s] = s * chunk;
+    }
+    segment_begin[num_threads] = num_samples;
+
+    // coarse sequential pass: seeds of the first sample of each segment
+    // (a failed solve does not move the seed, the segment is checked by the stitching anyway)
+    vector<Vector<>> segment_seed(num_threads, Zeros(numQ));
+    segment_seed[0] = qDH_seed;
+    Vector<> q_coarse = qDH_seed;
+    int k = 0;
+    for (int s = 1; s < num_threads; s++)
+    {
+      while (k + IKTRAJ_COARSE_STRIDE < segment_begin[s])
+      {
+        k += IKTRAJ_COARSE_STRIDE;
+        if (ikine(b_T_e[k], q_coarse, options, ws, q_k).status == IKINE_SUCCESS)
+        {
+          q_coarse = q_k;
+        }
+      }
+      k = segment_begin[s];
+      if (ikine(b_T_e[k], q_coarse, options, ws, q_k).status == IKINE_SUCCESS)
+      {
+        q_coarse = q_k;
+      }
+      segment_seed[s] = q_coarse;
+    }
+
+    // parallel segments, each worker owns a clone
+    vector<unique_ptr<Robot>> robots;
+    for (int s = 1; s < num_threads; s++)
+    {
+      robots.push_back(unique_ptr<Robot>(clone()));
+    }
+    vector<thread> workers;
+    for (int s = 1; s < num_threads; s++)
+    {
+      const Robot* robot = robots[s - 1].get();
+      const Vector<>* first_seed = &segment_seed[s];
+      const int begin = segment_begin[s];
+      const int end = segment_begin[s + 1];
+      workers.push_back(thread([robot, &b_T_e, begin, end, first_seed, &options, q_DH, error, numQ]() {
+        KinematicsWorkspace ws_s(numQ);
+        Vector<> seed_s = Zeros(numQ);
+        Vector<> q_k_s = Zeros(numQ);
+        solveSegment(*robot, b_T_e, begin, end, begin, *first_seed, options, ws_s, seed_s, q_k_s, q_DH, error);
+      }));
+    }
+    solveSegment(*this, b_T_e, segment_begin[0], segment_begin[1], 0, qDH_seed, options, ws, seed, q_k, q_DH,
+                 error);
+
+    for (auto& worker : workers)
+    {
+      worker.join();
+    }
+
+    // stitching, in order: the first sample of each segment is solved again as in the sequential pass
+    // (from the final samples of the previous segment), the segment is kept if this solution succeeds and is
+    // on the same branch and all its samples succeeded, otherwise the rest of the segment is solved again
+    // sequentially
+    for (int s = 1; s < num_threads; s++)
+    {
+      const int begin = segment_begin[s];
+      const int end = segment_begin[s + 1];
+      const IKineResult result = solveSample(*this, b_T_e, begin, 0, qDH_seed, options, ws, seed, q_DH, q_k);
+      bool keep = result.status == IKINE_SUCCESS && sampleDistance(q_k, q_DH, begin) <= IKTRAJ_STITCH_TOL;
+      for (int j = begin; keep && j < end; j++)
+      {
+        keep = !sampleFailed(error, j, options);
+      }
+      if (!keep)
+      {
+        storeSample(q_k, result, begin, q_DH, error);
+        solveSegment(*this, b_T_e, begin + 1, end, 0, qDH_seed, options, ws, seed, q_k, q_DH, error);
+      }
+    }
+  }
+
+  // velocities
+  for (int i = 0; i < numQ; i++)
+  {
+    qDH_dot[i] = 0.0;
+  }
+  for (int k = 1; k < num_samples; k++)
+  {
+    for (int i = 0; i < numQ; i++)
+    {
+      qDH_dot[k * numQ + i] = (q_DH[k * numQ + i] - q_DH[(k - 1) * numQ + i]) / Ts;
+    }
+  }
+
+  int num_failed = 0;
+  for (int k = 0; k < num_samples; k++)
+  {
+    if (sampleFailed(error, k, options))
+    {
+      num_failed++;
+    }
+  }
+  return num_failed;
+}
+
+}  // namespace sun
@@ -0,0 +1,76 @@
+/*
+
+    Kinematics Cache
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "sun_robot_lib/KinematicsCache.h"
+
+using namespace TooN;
+using namespace std;
+
+namespace sun
+{
+/*======CONSTRUCTORS======*/
+
+/*
+    Construct an empty cache for a robot with num_joints joints
+*/
+KinematicsCache::KinematicsCache(int num_joints)
+  : _num_joints(num_joints)
+  , _kinematics_id(0)
+  , _num_valid_frames(0)
+  , _num_valid_columns(0)
+  , _last_recomputed_links(0)
+  , q_DH(Zeros(num_joints))
+  , all_T(num_joints + 1)
+  , jacob(Zeros(6, num_joints))
+{
+}
+
+/*======END CONSTRUCTORS======*/
+
+/*
+    Force the recomputation of the whole chain at the next call
+*/
+void KinematicsCache::invalidate()
+{
+  _kinematics_id = 0;
+  _num_valid_frames = 0;
+  _num_valid_columns = 0;
+}
+
+/*
+    get number of joints
+*/
+int KinematicsCache::getNumJoints() const
+{
+  return _num_joints;
+}
+
+/*
+    Number of links recomputed by the last call (0 if the joints did not change)
+*/
+int KinematicsCache::getLastRecomputedLinks() const
+{
+  return _last_recomputed_links;
+}
+
+}  // namespace sun
@@ -0,0 +1,70 @@
+/*
+
+    Kinematics Workspace
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "sun_robot_lib/KinematicsWorkspace.h"
+
+using namespace TooN;
+using namespace std;
+
+namespace sun
+{
+/*======CONSTRUCTORS======*/
+
+/*
+    Construct a workspace for a robot with num_joints joints
+*/
+KinematicsWorkspace::KinematicsWorkspace(int num_joints)
+  : _num_joints(num_joints)
+  , all_T(num_joints + 1)
+  , jacob(Zeros(6, num_joints))
+  , J_pinv_dls(Zeros(num_joints, 6))
+  , null_proj(Zeros(num_joints, num_joints))
+  , qDH_k1(Zeros(num_joints))
+  , jacob_dot(Zeros(6, num_joints))
+  , joint_axis_dot(num_joints, Zeros)
+  , joint_origin_dot(num_joints + 1, Zeros)
+  , q0_pp(Zeros(num_joints))
+  , active_joints(num_joints)
+  , link_force(num_joints, Zeros)
+  , link_moment(num_joints, Zeros)
+  , joint_motion(num_joints, Zeros)
+  , body_inertia(num_joints, Zeros)
+  , body_bias(num_joints, Zeros)
+  , body_acc_bias(num_joints, Zeros)
+  , joint_inertia_force(num_joints, Zeros)
+  , joint_inertia(num_joints)
+  , joint_bias_torque(num_joints)
+{
+}
+
+/*======END CONSTRUCTORS======*/
+
+/*
+    get number of joints
+*/
+int KinematicsWorkspace::getNumJoints() const
+{
+  return _num_joints;
+}
+
+}  // namespace sun
@@ -22,12 +22,325 @@
 */
 
 #include "sun_robot_lib/Robot.h"
+#include <atomic>
+#include "TooN/Cholesky.h"
 
 using namespace TooN;
 using namespace std;
 
 namespace sun
 {
+namespace
+{
+//! Source of the kinematics ids, shared by all the robots (0 is reserved for the empty cache)
+atomic<uint64_t> kinematics_id_counter(0);
+
+/*
+    Pose error of b_T_e w.r.t. the desired pose b_T_d
+    position error and rotation vector (angle*axis) of the orientation error, both in base frame
+*/
+Vector<6> poseError(const RigidTransform& b_T_d, const RigidTransform& b_T_e)
+{
+  Vector<6> error;
+  error.slice<0, 3>() = b_T_d.p - b_T_e.p;
+
+  UnitQuaternion deltaQ = UnitQuaternion(b_T_d.R) / UnitQuaternion(b_T_e.R);
+  double s = deltaQ.getS();
+  Vector<3> v = deltaQ.getV();
+  // shortest rotation
+  if (s < 0.0)
+  {
+    s = -s;
+    v = -v;
+  }
+  const double norm_v = norm(v);
+  if (norm_v < 1.0E-12)
+  {
+    error.slice<3, 3>() = 2.0 * v;
+  }
+  else
+  {
+    error.slice<3, 3>() = (2.0 * atan2(norm_v, s) / norm_v) * v;
+  }
+
+  return error;
+}
+
+//! All the rows of the task, used by the unmasked clik
+const int clik_all_rows[6] = { 0, 1, 2, 3, 4, 5 };
+
+/*
+    Active rows of the mask, return the number of active rows m
+*/
+int maskRows(const Vector<6, int>& mask, int rows[6])
+{
+  int m = 0;
+  for (int i = 0; i < 6; i++)
+  {
+    if (mask[i] != 0)
+    {
+      rows[m++] = i;
+    }
+  }
+  return m;
+}
+
+/*
+    Indices of the active joints of joint_mask into active_joints (already of size NUM_JOINT),
+    return the number of active joints
+*/
+int activeJoints(const vector<bool>& joint_mask, vector<int>& active_joints)
+{
+  int n = 0;
+  for (int i = 0; i < (int)joint_mask.size(); i++)
+  {
+    if (joint_mask[i])
+    {
+      active_joints[n++] = i;
+    }
+  }
+  return n;
+}
+
+//! Indices of all the columns, used as cols argument of clikCholeskyStep when no joint is locked
+struct AllColumns
+{
+  int operator[](int c) const
+  {
+    return c;
+  }
+};
+
+/*
+    DLS step of clik with 6x6 Cholesky solves on the reduced task made of the m rows rows[0..m-1]
+    and the n columns cols[0..n-1] of jacob (use AllColumns() and n = NUM_JOINT for all the joints)
+    qpDH = Jm^T*y, (Jm*Jm^T + damping_sq*I)*y = vel_e(rows)
+    null space: qpDH += gain_null_space*( q0_p - Jm^T*(Jm*Jm^T + damping_sq*I)^-1*Jm*q0_p )
+    The m x m system is stored in the first rows of a 6x6 matrix, the remaining block is the identity
+    (it does not affect the solution of the first m rows)
+    qpDH must be of size NUM_JOINT, the elements of the columns not in cols are not modified
+    This function does not allocate memory
+*/
+template <class JacobType, class Columns>
+void clikCholeskyStep(const JacobType& jacob, const int* rows, int m, const Columns& cols, int n,
+                      const Vector<6>& vel_e, double damping_sq, double gain_null_space, const Vector<>& q0_p,
+                      // Return Vars
+                      Vector<>& qpDH)
+{
+  Matrix<6, 6> JJt = Identity;
+  Vector<6> vel_m = Zeros;
+  for (int a = 0; a < m; a++)
+  {
+    for (int b = a; b < m; b++)
+    {
+      double acc = 0.0;
+      for (int c = 0; c < n; c++)
+      {
+        acc += jacob(rows[a], cols[c]) * jacob(rows[b], cols[c]);
+      }
+      JJt(a, b) = acc;
+      JJt(b, a) = acc;
+    }
+    JJt(a, a) += damping_sq;
+    vel_m[a] = vel_e[rows[a]];
+  }
+  Cholesky<6> JJt_chol(JJt);
+
+  const Vector<6> y = JJt_chol.backsub(vel_m);
+  for (int c = 0; c < n; c++)
+  {
+    double acc = 0.0;
+    for (int a = 0; a < m; a++)
+    {
+      acc += jacob(rows[a], cols[c]) * y[a];
+    }
+    qpDH[cols[c]] = acc;
+  }
+
+  // Null space
+  if (gain_null_space != 0.0)
+  {
+    Vector<6> Jq0 = Zeros;
+    for (int a = 0; a < m; a++)
+    {
+      double acc = 0.0;
+      for (int c = 0; c < n; c++)
+      {
+        acc += jacob(rows[a], cols[c]) * q0_p[cols[c]];
+      }
+      Jq0[a] = acc;
+    }
+    const Vector<6> z = JJt_chol.backsub(Jq0);
+    for (int c = 0; c < n; c++)
+    {
+      double acc = 0.0;
+      for (int a = 0; a < m; a++)
+      {
+        acc += jacob(rows[a], cols[c]) * z[a];
+      }
+      qpDH[cols[c]] += gain_null_space * (q0_p[cols[c]] - acc);
+    }
+  }
+}
+
+/*
+    Same step of clikCholeskyStep with the explicit DLS pseudo-inverse and null space projector (CLIK_SOLVER_PINV)
+    J_pinv_dls = J^T*(J*J^T + damping_sq*I)^-1 is written in the rows cols[0..n-1] and in the first m columns,
+    null_proj = I - J_pinv_dls*J in the rows and columns cols[0..n-1] (only if gain_null_space is not zero)
+    qpDH must be of size NUM_JOINT
+    This function does not allocate memory
+*/
+template <class JacobType, class Columns>
+void clikPinvStep(const JacobType& jacob, const int* rows, int m, const Columns& cols, int n, const Vector<6>& vel_e,
+                  double damping_sq, double gain_null_space, const Vector<>& q0_p, Matrix<Dynamic, 6>& J_pinv_dls,
+                  Matrix<>& null_proj,
+                  // Return Vars
+                  Vector<>& qpDH)
+{
+  Matrix<6, 6> JJt = Identity;
+  for (int a = 0; a < m; a++)
+  {
+    for (int b = a; b < m; b++)
+    {
+      double acc = 0.0;
+      for (int c = 0; c < n; c++)
+      {
+        acc += jacob(rows[a], cols[c]) * jacob(rows[b], cols[c]);
+      }
+      JJt(a, b) = acc;
+      JJt(b, a) = acc;
+    }
+    JJt(a, a) += damping_sq;
+  }
+  Cholesky<6> JJt_chol(JJt);
+  const Matrix<6, 6> JJt_inv = JJt_chol.get_inverse();
+
+  for (int c = 0; c < n; c++)
+  {
+    double qp = 0.0;
+    for (int a = 0; a < m; a++)
+    {
+      double acc = 0.0;
+      for (int b = 0; b < m; b++)
+      {
+        acc += jacob(rows[b], cols[c]) * JJt_inv(b, a);
+      }
+      J_pinv_dls(cols[c], a) = acc;
+      qp += acc * vel_e[rows[a]];
+    }
+    qpDH[cols[c]] = qp;
+  }
+
+  // Null space
+  if (gain_null_space != 0.0)
+  {
+    for (int c = 0; c < n; c++)
+    {
+      for (int d = 0; d < n; d++)
+      {
+        double acc = 0.0;
+        for (int a = 0; a < m; a++)
+        {
+          acc += J_pinv_dls(cols[c], a) * jacob(rows[a], cols[d]);
+        }
+        null_proj(cols[c], cols[d]) = ((c == d) ? 1.0 : 0.0) - acc;
+      }
+    }
+    for (int c = 0; c < n; c++)
+    {
+      double acc = 0.0;
+      for (int d = 0; d < n; d++)
+      {
+        acc += null_proj(cols[c], cols[d]) * q0_p[cols[d]];
+      }
+      qpDH[cols[c]] += gain_null_space * acc;
+    }
+  }
+}
+
+/*
+    DLS step of clik on the m rows rows[0..m-1] and the n columns cols[0..n-1] of jacob
+    the other joints have zero velocity
+    m <= n: qpDH = J^T*y, (J*J^T + damping_sq*I)*y = vel_e(rows)
+    m > n:  (J^T*J + damping_sq*I)*qpDH = J^T*vel_e(rows) (same solution, smaller system)
+    null space: qpDH += gain_null_space*( q0_p - J^T*(J*J^T + damping_sq*I)^-1*J*q0_p )
+                      = gain_null_space*( q0_p - (J^T*J + damping_sq*I)^-1*J^T*J*q0_p )
+    The system is stored in the first rows of a 6x6 matrix, the remaining block is the identity
+    qpDH must be of size NUM_JOINT
+    This function does not allocate memory
+*/
+void clikReducedStep(const Matrix<6, Dynamic>& jacob, const int* rows, int m, const int* cols, int n,
+                     const Vector<6>& vel_e, double damping_sq, double gain_null_space, const Vector<>& q0_p,
+                     // Return Vars
+                     Vector<>& qpDH)
+{
+  qpDH = Zeros;
+  if (n == 0)
+  {
+    return;
+  }
+
+  if (m <= n)
+  {
+    clikCholeskyStep(jacob, rows, m, cols, n, vel_e, damping_sq, gain_null_space, q0_p, qpDH);
+    return;
+  }
+
+  // m > n: n x n system
+  Matrix<6, 6> JtJ = Identity;
+  Vector<6> Jt_vel = Zeros;
+  for (int a = 0; a < n; a++)
+  {
+    for (int b = a; b < n; b++)
+    {
+      double acc = 0.0;
+      for (int r = 0; r < m; r++)
+      {
+        acc += jacob(rows[r], cols[a]) * jacob(rows[r], cols[b]);
+      }
+      JtJ(a, b) = acc;
+      JtJ(b, a) = acc;
+    }
+    JtJ(a, a) += damping_sq;
+    double acc = 0.0;
+    for (int r = 0; r < m; r++)
+    {
+      acc += jacob(rows[r], cols[a]) * vel_e[rows[r]];
+    }
+    Jt_vel[a] = acc;
+  }
+  Cholesky<6> JtJ_chol(JtJ);
+
+  const Vector<6> x = JtJ_chol.backsub(Jt_vel);
+  for (int a = 0; a < n; a++)
+  {
+    qpDH[cols[a]] = x[a];
+  }
+
+  // Null space
+  if (gain_null_space != 0.0)
+  {
+    // J^T*J*q0_p = (J^T*J + damping_sq*I)*q0_p - damping_sq*q0_p
+    Vector<6> JtJq0 = Zeros;
+    for (int a = 0; a < n; a++)
+    {
+      double acc = 0.0;
+      for (int b = 0; b < n; b++)
+      {
+        acc += JtJ(a, b) * q0_p[cols[b]];
+      }
+      JtJq0[a] = acc - damping_sq * q0_p[cols[a]];
+    }
+    const Vector<6> z = JtJ_chol.backsub(JtJq0);
+    for (int a = 0; a < n; a++)
+    {
+      qpDH[cols[a]] += gain_null_space * (q0_p[cols[a]] - z[a]);
+    }
+  }
+}
+
+}  // namespace
+
 /*=========CONSTRUCTORS=========*/
 
 /*
@@ -36,20 +349,30 @@ namespace sun
 */
 Robot::Robot()
 {
-  _b_T_0 = Identity;
-  _n_T_e = Identity;
+  _b_T_0 = RigidTransform();
+  _n_T_e = RigidTransform();
   _name = string("Robot_No_Name");
   _model = string("Robot_No_Model");
   _dls_joint_speed_saturation = 2.0;
+  _clik_solver = CLIK_SOLVER_PINV;
+  _gravity = makeVector(0.0, 0.0, -ROBOT_GRAVITY_ACCELERATION);
+  _chain_links_version = 0;
+  _specialize_dh_kernels = true;
+  compile();
 }
 
 Robot::Robot(const string& name)
 {
-  _b_T_0 = Identity;
-  _n_T_e = Identity;
+  _b_T_0 = RigidTransform();
+  _n_T_e = RigidTransform();
   _name = name;
   _model = string("Robot_No_Model");
   _dls_joint_speed_saturation = 2.0;
+  _clik_solver = CLIK_SOLVER_PINV;
+  _gravity = makeVector(0.0, 0.0, -ROBOT_GRAVITY_ACCELERATION);
+  _chain_links_version = 0;
+  _specialize_dh_kernels = true;
+  compile();
 }
 
 /*
@@ -57,13 +380,21 @@ Robot::Robot(const string& name)
 */
 Robot::Robot(const vector<RobotLinkPtr>& links, const Matrix<4, 4>& b_T_0, const Matrix<4, 4>& n_T_e,
              double dls_joint_speed_saturation, const string& name)
-  : _b_T_0(b_T_0), _n_T_e(n_T_e), _dls_joint_speed_saturation(dls_joint_speed_saturation), _name(name)
+  : _b_T_0(b_T_0)
+  , _n_T_e(n_T_e)
+  , _dls_joint_speed_saturation(dls_joint_speed_saturation)
+  , _clik_solver(CLIK_SOLVER_PINV)
+  , _gravity(makeVector(0.0, 0.0, -ROBOT_GRAVITY_ACCELERATION))
+  , _name(name)
+  , _chain_links_version(0)
+  , _specialize_dh_kernels(true)
 {
   // Clone links
   for (const auto& link : links)
   {
     _links.push_back(RobotLinkPtr(link->clone()));
   }
+  compile();
 }
 
 /*
@@ -72,8 +403,16 @@ Robot::Robot(const vector<RobotLinkPtr>& links, const Matrix<4, 4>& b_T_0, const
 */
 Robot::Robot(const Matrix<4, 4>& b_T_0, const Matrix<4, 4>& n_T_e, double dls_joint_speed_saturation,
              const string& name)
-  : _b_T_0(b_T_0), _n_T_e(n_T_e), _dls_joint_speed_saturation(dls_joint_speed_saturation), _name(name)
+  : _b_T_0(b_T_0)
+  , _n_T_e(n_T_e)
+  , _dls_joint_speed_saturation(dls_joint_speed_saturation)
+  , _clik_solver(CLIK_SOLVER_PINV)
+  , _gravity(makeVector(0.0, 0.0, -ROBOT_GRAVITY_ACCELERATION))
+  , _name(name)
+  , _chain_links_version(0)
+  , _specialize_dh_kernels(true)
 {
+  compile();
 }
 
 /*
@@ -84,6 +423,8 @@ Robot::Robot(const Robot& robot)
   _b_T_0 = robot._b_T_0;
   _n_T_e = robot._n_T_e;
   _dls_joint_speed_saturation = robot._dls_joint_speed_saturation;
+  _clik_solver = robot._clik_solver;
+  _gravity = robot._gravity;
   _name = robot._name;
   _model = robot._model;
   // Clone links
@@ -91,6 +432,15 @@ Robot::Robot(const Robot& robot)
   {
     _links.push_back(RobotLinkPtr(link->clone()));
   }
+  // the clones have the same versions of the links of robot
+  {
+    lock_guard<mutex> lock(robot._chain_mutex);
+    _chain = robot._chain;
+    _chain_links_version = robot._chain_links_version.load();
+  }
+  _specialize_dh_kernels = robot._specialize_dh_kernels;
+  // same kinematics, a cache filled by robot is still valid
+  _kinematics_id = robot._kinematics_id;
 }
 
 /*=====END CONSTRUCTORS=========*/
@@ -109,6 +459,50 @@ void Robot::checkHomog(const Matrix<4, 4>& M)
   }
 }
 
+/*
+    Sum of the versions of the links
+    The versions are unique and increase at every modification of a link, so the sum changes if a link is
+    modified or replaced through the reference returned by getLink
+    This function does not allocate memory
+*/
+uint64_t Robot::linksVersion() const
+{
+  uint64_t version = 0;
+  for (const auto& link : _links)
+  {
+    version += link->getVersion();
+  }
+  return version;
+}
+
+/*
+    Return true if the compiled chain is up to date with the links
+    This function does not allocate memory
+*/
+bool Robot::isCompiledChainUpToDate() const
+{
+  return _chain_links_version.load(memory_order_acquire) == linksVersion();
+}
+
+/*
+    Build the compiled chain and assign a new kinematics id, _chain_mutex must be locked
+*/
+void Robot::buildCompiledChain() const
+{
+  _chain.build(_links, _specialize_dh_kernels);
+  newKinematicsId();
+  // published after the build: a thread that reads the new version sees the new chain
+  _chain_links_version.store(linksVersion(), memory_order_release);
+}
+
+/*
+    Assign a new kinematics id, the KinematicsCache filled with the old id will be recomputed
+*/
+void Robot::newKinematicsId() const
+{
+  _kinematics_id = ++kinematics_id_counter;
+}
+
 /*
     Display robot in smart way
 */
@@ -175,7 +569,7 @@ void Robot::display()
     else
       cout << "╩";
   }
-  cout << endl << "0_T_b = " << endl << _b_T_0 << endl << "n_T_e = " << endl << _n_T_e << endl;
+  cout << endl << "0_T_b = " << endl << _b_T_0.toMatrix() << endl << "n_T_e = " << endl << _n_T_e.toMatrix() << endl;
 }
 
 /*
@@ -204,6 +598,30 @@ double Robot::getDLSJointSpeedSaturation() const
   return _dls_joint_speed_saturation;
 }
 
+/*
+    get the solver of the DLS step of clik
+*/
+CLIKSolver Robot::getCLIKSolver() const
+{
+  return _clik_solver;
+}
+
+/*
+    get the gravity acceleration vector in base frame
+*/
+Vector<3> Robot::getGravity() const
+{
+  return _gravity;
+}
+
+/*
+    get true if the DH compose routines of the compiled chain are specialized on the DH pattern of each link
+*/
+bool Robot::getDHKernelSpecialization() const
+{
+  return _specialize_dh_kernels;
+}
+
 /*
     get number of joints
 */
@@ -217,7 +635,7 @@ int Robot::getNumJoints() const
 */
 Matrix<4, 4> Robot::getbT0() const
 {
-  return _b_T_0;
+  return _b_T_0.toMatrix();
 }
 
 /*
@@ -237,6 +655,7 @@ vector<RobotLinkPtr> Robot::getLinks() const
 /*
     get reference of link i
     Note: smart_pointer
+    Note: the link can be modified through the reference, the modification is detected by the version of the link
 */
 RobotLinkPtr& Robot::getLink(int i)
 {
@@ -248,7 +667,7 @@ RobotLinkPtr& Robot::getLink(int i)
 */
 Matrix<4, 4> Robot::getnTe() const
 {
-  return _n_T_e;
+  return _n_T_e.toMatrix();
 }
 
 /*
@@ -302,6 +721,25 @@ Robot* Robot::clone() const
   return new Robot(*this);
 }
 
+/*
+    Get the flattened kinematic chain
+    The chain is compiled here if a link was modified through the reference returned by getLink
+    (double-checked under _chain_mutex, concurrent calls on a const Robot are safe)
+*/
+const CompiledChain& Robot::getCompiledChain() const
+{
+  if (!isCompiledChainUpToDate())
+  {
+    lock_guard<mutex> lock(_chain_mutex);
+    // another thread may have built the chain meanwhile
+    if (!isCompiledChainUpToDate())
+    {
+      buildCompiledChain();
+    }
+  }
+  return _chain;
+}
+
 /*=========END GETTERS=========*/
 
 /*=========SETTERS=========*/
@@ -314,13 +752,40 @@ void Robot::setDLSJointSpeedSaturation(double dls_joint_speed_saturation)
   _dls_joint_speed_saturation = dls_joint_speed_saturation;
 }
 
+/*
+    set the solver of the DLS step of clik
+*/
+void Robot::setCLIKSolver(CLIKSolver clik_solver)
+{
+  _clik_solver = clik_solver;
+}
+
+/*
+    set the gravity acceleration vector in base frame
+*/
+void Robot::setGravity(const Vector<3>& gravity)
+{
+  _gravity = gravity;
+}
+
+/*
+    set if the DH compose routines of the compiled chain are specialized on the DH pattern of each link
+    The chain is compiled again by the next kinematic call
+*/
+void Robot::setDHKernelSpecialization(bool specialize)
+{
+  _specialize_dh_kernels = specialize;
+  compile();
+}
+
 /*
     Set Transformation matrix of link_0 w.r.t. base frame
 */
 void Robot::setbT0(const Matrix<4, 4>& b_T_0)
 {
   checkHomog(b_T_0);
-  _b_T_0 = b_T_0;
+  _b_T_0 = RigidTransform(b_T_0);
+  newKinematicsId();
 }
 
 /*
@@ -333,6 +798,7 @@ void Robot::setLinks(const vector<RobotLinkPtr>& links)
   {
     _links.push_back(RobotLinkPtr(element->clone()));
   }
+  compile();
 }
 
 /*
@@ -341,6 +807,7 @@ void Robot::setLinks(const vector<RobotLinkPtr>& links)
 void Robot::push_back_link(const RobotLink& link)
 {
   _links.push_back(RobotLinkPtr(link.clone()));
+  compile();
 }
 
 /*
@@ -368,6 +835,7 @@ Robot Robot::operator+(const RobotLink& link) const
 void Robot::pop_back_link()
 {
   _links.pop_back();  // delete?
+  compile();
 }
 
 /*
@@ -376,7 +844,8 @@ void Robot::pop_back_link()
 void Robot::setnTe(const Matrix<4, 4>& n_T_e)
 {
   checkHomog(n_T_e);
-  _n_T_e = n_T_e;
+  _n_T_e = RigidTransform(n_T_e);
+  newKinematicsId();
 }
 
 /*
@@ -395,6 +864,17 @@ void Robot::setModel(const string& model)
   _model = model;
 }
 
+/*
+    Flatten the links into the compiled chain (contiguous arrays with precomputed constants)
+    The chain is compiled by the constructors and by the functions that modify the links,
+    a link modified through the reference returned by getLink is detected by the next kinematic call
+*/
+void Robot::compile()
+{
+  lock_guard<mutex> lock(_chain_mutex);
+  buildCompiledChain();
+}
+
 /*=========END SETTERS=========*/
 
 /*=========CONVERSIONS=========*/
@@ -404,10 +884,11 @@ void Robot::setModel(const string& model)
 */
 Vector<> Robot::joints_Robot2DH(const Vector<>& q_Robot) const
 {
-  Vector<> q_DH = Zeros(getNumJoints());
-  for (int i = 0; i < getNumJoints(); i++)
+  const CompiledChain& chain = getCompiledChain();
+  Vector<> q_DH = Zeros(chain.num_joints);
+  for (int i = 0; i < chain.num_joints; i++)
   {
-    q_DH[i] = _links[i]->joint_Robot2DH(q_Robot[i]);
+    q_DH[i] = chain.joint_Robot2DH(i, q_Robot[i]);
   }
   return q_DH;
 }
@@ -417,10 +898,11 @@ Vector<> Robot::joints_Robot2DH(const Vector<>& q_Robot) const
 */
 Vector<> Robot::joints_DH2Robot(const Vector<>& q_DH) const
 {
-  Vector<> q_Robot = Zeros(getNumJoints());
-  for (int i = 0; i < getNumJoints(); i++)
+  const CompiledChain& chain = getCompiledChain();
+  Vector<> q_Robot = Zeros(chain.num_joints);
+  for (int i = 0; i < chain.num_joints; i++)
   {
-    q_Robot[i] = _links[i]->joint_DH2Robot(q_DH[i]);
+    q_Robot[i] = chain.joint_DH2Robot(i, q_DH[i]);
   }
   return q_Robot;
 }
@@ -430,10 +912,11 @@ Vector<> Robot::joints_DH2Robot(const Vector<>& q_DH) const
 */
 Vector<> Robot::jointsvel_Robot2DH(const Vector<>& q_dot_Robot) const
 {
-  Vector<> q_dot_DH = Zeros(getNumJoints());
-  for (int i = 0; i < getNumJoints(); i++)
+  const CompiledChain& chain = getCompiledChain();
+  Vector<> q_dot_DH = Zeros(chain.num_joints);
+  for (int i = 0; i < chain.num_joints; i++)
   {
-    q_dot_DH[i] = _links[i]->jointvel_Robot2DH(q_dot_Robot[i]);
+    q_dot_DH[i] = chain.jointvel_Robot2DH(i, q_dot_Robot[i]);
   }
   return q_dot_DH;
 }
@@ -443,10 +926,11 @@ Vector<> Robot::jointsvel_Robot2DH(const Vector<>& q_dot_Robot) const
 */
 Vector<> Robot::jointsvel_DH2Robot(const Vector<>& q_dot_DH) const
 {
-  Vector<> q_dot_Robot = Zeros(getNumJoints());
-  for (int i = 0; i < getNumJoints(); i++)
+  const CompiledChain& chain = getCompiledChain();
+  Vector<> q_dot_Robot = Zeros(chain.num_joints);
+  for (int i = 0; i < chain.num_joints; i++)
   {
-    q_dot_Robot[i] = _links[i]->jointvel_DH2Robot(q_dot_DH[i]);
+    q_dot_Robot[i] = chain.jointvel_DH2Robot(i, q_dot_DH[i]);
   }
   return q_dot_Robot;
 }
@@ -461,10 +945,11 @@ Vector<> Robot::jointsvel_DH2Robot(const Vector<>& q_dot_DH) const
 */
 vector<bool> Robot::checkHardJointLimits(const Vector<>& q_Robot) const
 {
-  vector<bool> out;
-  for (int i = 0; i < getNumJoints(); i++)
+  const CompiledChain& chain = getCompiledChain();
+  vector<bool> out(chain.num_joints);
+  for (int i = 0; i < chain.num_joints; i++)
   {
-    out.push_back(_links[i]->exceededHardJointLimits(q_Robot[i]));
+    out[i] = (q_Robot[i] <= chain.hard_limit_lower[i] || q_Robot[i] >= chain.hard_limit_higher[i]);
   }
   return out;
 }
@@ -492,10 +977,11 @@ bool Robot::exceededHardJointLimits(const Vector<>& q_Robot) const
 */
 vector<bool> Robot::checkSoftJointLimits(const Vector<>& q_R) const
 {
-  vector<bool> out;
-  for (int i = 0; i < getNumJoints(); i++)
+  const CompiledChain& chain = getCompiledChain();
+  vector<bool> out(chain.num_joints);
+  for (int i = 0; i < chain.num_joints; i++)
   {
-    out.push_back(_links[i]->exceededSoftJointLimits(q_R[i]));
+    out[i] = (q_R[i] <= chain.soft_limit_lower[i] || q_R[i] >= chain.soft_limit_higher[i]);
   }
   return out;
 }
@@ -523,10 +1009,11 @@ bool Robot::exceededSoftJointLimits(const Vector<>& q_R) const
 */
 vector<bool> Robot::checkHardVelocityLimits(const Vector<>& q_dot) const
 {
-  vector<bool> out;
-  for (int i = 0; i < getNumJoints(); i++)
+  const CompiledChain& chain = getCompiledChain();
+  vector<bool> out(chain.num_joints);
+  for (int i = 0; i < chain.num_joints; i++)
   {
-    out.push_back(_links[i]->exceededHardVelocityLimit(q_dot[i]));
+    out[i] = (abs(q_dot[i]) >= chain.hard_velocity_limit[i]);
   }
   return out;
 }
@@ -554,10 +1041,11 @@ bool Robot::exceededHardVelocityLimits(const Vector<>& q_dot) const
 */
 vector<bool> Robot::checkSoftVelocityLimits(const Vector<>& q_dot) const
 {
-  vector<bool> out;
-  for (int i = 0; i < getNumJoints(); i++)
+  const CompiledChain& chain = getCompiledChain();
+  vector<bool> out(chain.num_joints);
+  for (int i = 0; i < chain.num_joints; i++)
   {
-    out.push_back(_links[i]->exceededSoftVelocityLimit(q_dot[i]));
+    out[i] = (abs(q_dot[i]) >= chain.soft_velocity_limit[i]);
   }
   return out;
 }
@@ -588,6 +1076,7 @@ bool Robot::exceededSoftVelocityLimits(const Vector<>& q_dot) const
     This function compute the fkine to joint "n_joint" given the last transformation to joint n_joint-1
     - q_DH_j is the joint position of the i-th link
     - b_T_j_1 is the transformation of the link j-1 w.r.t base frame
+    Deprecated, the kinematic functions use the CompiledChain
 */
 Matrix<4, 4> Robot::fkine_internal(const double& q_DH_j, const Matrix<4, 4>& b_T_j_1, int n_joint) const
 {
@@ -595,23 +1084,15 @@ Matrix<4, 4> Robot::fkine_internal(const double& q_DH_j, const Matrix<4, 4>& b_T
 }
 
 /*
-    fkine to n_joint-th link
-    j_T_f will be post multiplyed to the result
-    if n_joint = NUM_JOINT+1 then the result is b_T_e*j_T_f
-*/
-Matrix<4, 4> Robot::fkine(const Vector<>& q_DH, int n_joint, const Matrix<4, 4>& j_T_f) const
-{
-  return (fkine(q_DH, n_joint) * j_T_f);
-}
-
-/*
-    fkine to n_joint-th link
+    Internal fkine to n_joint-th link
     if n_joint = NUM_JOINT+1 then the result is b_T_e
 */
-Matrix<4, 4> Robot::fkine(const Vector<>& q_DH, int n_joint) const
+RigidTransform Robot::fkine_rigid(const Vector<>& q_DH, int n_joint) const
 {
+  const CompiledChain& chain = getCompiledChain();
+
   // Start from frame 0
-  Matrix<4, 4> b_T_j = _b_T_0;
+  RigidTransform b_T_j = _b_T_0;
 
   // check if the final frame is {end-effector}
   bool ee = false;
@@ -623,18 +1104,37 @@ Matrix<4, 4> Robot::fkine(const Vector<>& q_DH, int n_joint) const
 
   for (int i = 0; i < n_joint; i++)
   {
-    b_T_j = fkine_internal(q_DH[i], b_T_j, i);
+    chain.postMultA(i, q_DH[i], b_T_j);
   }
 
   // if the final frame is the {end-effector} then add it
   if (ee)
   {
-    b_T_j = b_T_j * _n_T_e;
+    b_T_j *= _n_T_e;
   }
 
   return b_T_j;
 }
 
+/*
+    fkine to n_joint-th link
+    j_T_f will be post multiplyed to the result
+    if n_joint = NUM_JOINT+1 then the result is b_T_e*j_T_f
+*/
+Matrix<4, 4> Robot::fkine(const Vector<>& q_DH, int n_joint, const Matrix<4, 4>& j_T_f) const
+{
+  return (fkine_rigid(q_DH, n_joint) * RigidTransform(j_T_f)).toMatrix();
+}
+
+/*
+    fkine to n_joint-th link
+    if n_joint = NUM_JOINT+1 then the result is b_T_e
+*/
+Matrix<4, 4> Robot::fkine(const Vector<>& q_DH, int n_joint) const
+{
+  return fkine_rigid(q_DH, n_joint).toMatrix();
+}
+
 /*
     fkine to the end-effector
 */
@@ -650,7 +1150,7 @@ Matrix<4, 4> Robot::fkine(const Vector<>& q_DH) const
 */
 Matrix<4, 4> Robot::fkine(const Vector<>& q_DH, const Matrix<4, 4>& e_T_f) const
 {
-  return (fkine(q_DH) * e_T_f);
+  return fkine(q_DH, getNumJoints() + 1, e_T_f);
 }
 
 /*
@@ -660,7 +1160,26 @@ Matrix<4, 4> Robot::fkine(const Vector<>& q_DH, const Matrix<4, 4>& e_T_f) const
 */
 vector<Matrix<4, 4>> Robot::fkine_all(const Vector<>& q_DH, int n_joint) const
 {
-  vector<Matrix<4, 4>> out;
+  vector<RigidTransform> all_T;
+  fkine_all_internal(q_DH, n_joint, all_T);
+
+  vector<Matrix<4, 4>> out(all_T.size());
+  for (size_t i = 0; i < all_T.size(); i++)
+  {
+    all_T[i].toMatrix(out[i]);
+  }
+  return out;
+}
+
+/*
+    Internal fkine_all
+    all_T is resized to n_joint+1 (NUM_JOINT+1 if the final frame is the {end-effector})
+*/
+void Robot::fkine_all_internal(const Vector<>& q_DH, int n_joint, vector<RigidTransform>& out) const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  out.clear();
 
   // Start from frame 0
   out.push_back(_b_T_0);
@@ -673,66 +1192,142 @@ vector<Matrix<4, 4>> Robot::fkine_all(const Vector<>& q_DH, int n_joint) const
     ee = true;
   }
 
+  out.reserve(n_joint + 1);
   for (int i = 0; i < n_joint; i++)
   {
-    out.push_back(fkine_internal(q_DH[i], out.back(), i));
+    out.push_back(out.back());
+    chain.postMultA(i, q_DH[i], out.back());
   }
 
   // if the final frame is the {end-effector} then add it to the last element
   if (ee)
   {
-    out.back() = out.back() * _n_T_e;
+    out.back() *= _n_T_e;
   }
-
-  return out;
 }
 
-/*========END FKINE=========*/
-
-/*========Jacobians=========*/
-
 /*
-    Internal computation of the position part of the jacobian in the frame {f}
-    The input is a vector of all transformation the considered joints i.e.
-    [ b_T_0 , b_T_1, ... , (b_T_j*j_T_f) ] (size = joints+1)
+    This function computes all the transformation up to the end-effector into the workspace
+    The result is ws.all_T = [ b_T_0 , b_T_1, ... , b_T_e ] (size = NUM_JOINT+1)
+    This function does not allocate memory
 */
-Matrix<3, Dynamic> Robot::jacob_p_internal(const vector<Matrix<4, 4>>& all_T) const
+void Robot::fkine_all(const Vector<>& q_DH, KinematicsWorkspace& ws) const
 {
-  int numQ = all_T.size() - 1;
+  const CompiledChain& chain = getCompiledChain();
 
-  Matrix<3, Dynamic> Jp = Zeros(3, numQ);
+  // Start from frame 0
+  ws.all_T[0] = _b_T_0;
 
-  Vector<3> p_e = all_T.back().T()[3].slice<0, 3>();
+  for (int i = 0; i < chain.num_joints; i++)
+  {
+    ws.all_T[i + 1] = ws.all_T[i];
+    chain.postMultA(i, q_DH[i], ws.all_T[i + 1]);
+  }
 
-  for (int i = 0; i < numQ; i++)
+  // the final frame is the {end-effector}
+  ws.all_T.back() *= _n_T_e;
+}
+
+/*
+    Update the frames of the cache to q_DH, starting from the first joint that changed
+    The whole chain is recomputed if the kinematics of the robot changed after the last update
+*/
+void Robot::updateKinematicsCache(const Vector<>& q_DH, KinematicsCache& cache) const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  if (cache._num_joints != chain.num_joints)
+  {
+    cout << ROBOT_ERROR_COLOR "[Robot] Error in updateKinematicsCache(): the cache has " << cache._num_joints
+         << " joints, the robot has " << chain.num_joints << ROBOT_CRESET << endl;
+    exit(-1);
+  }
+
+  if (cache._kinematics_id != _kinematics_id)
   {
-    Vector<3> z_i_1 = all_T[i].T()[2].slice<0, 3>();
+    cache._kinematics_id = _kinematics_id;
+    cache._num_valid_frames = 0;
+    cache._num_valid_columns = 0;
+    cache.all_T[0] = _b_T_0;
+  }
 
-    switch (_links[i]->type())
+  // first joint that changed
+  int first = cache._num_valid_frames;
+  for (int i = 0; i < first; i++)
+  {
+    if (q_DH[i] != cache.q_DH[i])
     {
-      case 'p':  // Prismatic
-      {
-        Jp.T()[i] = z_i_1;
+      first = i;
+      break;
+    }
+  }
 
-        break;
-      }
+  cache._last_recomputed_links = chain.num_joints - first;
+  if (first == chain.num_joints)
+  {
+    return;
+  }
 
-      case 'r':  // Revolute
-      {
-        Vector<3> p_i_1 = all_T[i].T()[3].slice<0, 3>();
+  for (int i = first; i < chain.num_joints; i++)
+  {
+    cache.q_DH[i] = q_DH[i];
+    cache.all_T[i + 1] = cache.all_T[i];
+    chain.postMultA(i, q_DH[i], cache.all_T[i + 1]);
+  }
+  cache.b_T_e = cache.all_T.back();
+  cache.b_T_e *= _n_T_e;
 
-        Jp.T()[i] = z_i_1 ^ (p_e - p_i_1);
+  cache._num_valid_frames = chain.num_joints;
+  if (cache._num_valid_columns > first)
+  {
+    cache._num_valid_columns = first;
+  }
+}
 
-        break;
-      }
+/*
+    Incremental fkine to the end-effector
+    Only the links from the first joint that changed w.r.t. the last call with the same cache are recomputed
+    The result is also in cache.b_T_e, the frames in cache.all_T
+    This function does not allocate memory
+*/
+Matrix<4, 4> Robot::fkine(const Vector<>& q_DH, KinematicsCache& cache) const
+{
+  updateKinematicsCache(q_DH, cache);
+  return cache.b_T_e.toMatrix();
+}
 
-      default:
-      {
-        cout << ROBOT_ERROR_COLOR "[Robot] Error in jacob_p_internal( const vector<Matrix<4,4>>& all_T ): invalid "
-                                  "_links["
-             << i << "].type()=" << _links[i]->type() << ROBOT_CRESET << endl;
-        exit(-1);
-      }
+/*========END FKINE=========*/
+
+/*========Jacobians=========*/
+
+/*
+    Internal computation of the position part of the jacobian in the frame {f}
+    The input is a vector of all transformation the considered joints i.e.
+    [ b_T_0 , b_T_1, ... , (b_T_j*j_T_f) ] (size = joints+1)
+*/
+Matrix<3, Dynamic> Robot::jacob_p_internal(const vector<RigidTransform>& all_T) const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  int numQ = all_T.size() - 1;
+
+  Matrix<3, Dynamic> Jp = Zeros(3, numQ);
+
+  const Vector<3>& p_e = all_T.back().p;
+
+  for (int i = 0; i < numQ; i++)
+  {
+    Vector<3> z_i_1 = all_T[i].z();
+
+    if (chain.isPrismatic(i))
+    {
+      Jp.T()[i] = z_i_1;
+    }
+    else  // Revolute
+    {
+      const Vector<3>& p_i_1 = all_T[i].p;
+
+      Jp.T()[i] = z_i_1 ^ (p_e - p_i_1);
     }
   }
 
@@ -744,43 +1339,290 @@ Matrix<3, Dynamic> Robot::jacob_p_internal(const vector<Matrix<4, 4>>& all_T) co
     The input is a vector of all transformation the considered joints i.e.
     [ b_T_0 , b_T_1, ... , (b_T_j*j_T_f) ] (size = joints+1)
 */
-Matrix<3, Dynamic> Robot::jacob_o_geometric_internal(const vector<Matrix<4, 4>>& all_T) const
+Matrix<3, Dynamic> Robot::jacob_o_geometric_internal(const vector<RigidTransform>& all_T) const
 {
+  const CompiledChain& chain = getCompiledChain();
+
   int numQ = all_T.size() - 1;
 
   Matrix<3, Dynamic> Jo_geometric = Zeros(3, numQ);
 
   for (int i = 0; i < numQ; i++)
   {
-    switch (_links[i]->type())
+    if (chain.isPrismatic(i))
     {
-      case 'p':  // Prismatic
-      {
-        Jo_geometric.T()[i] = Zeros;
+      Jo_geometric.T()[i] = Zeros;
+    }
+    else  // Revolute
+    {
+      Vector<3> z_i_1 = all_T[i].z();
 
-        break;
-      }
+      Jo_geometric.T()[i] = z_i_1;
+    }
+  }
 
-      case 'r':  // Revolute
-      {
-        Vector<3> z_i_1 = all_T[i].T()[2].slice<0, 3>();
+  return Jo_geometric;
+}
 
-        Jo_geometric.T()[i] = z_i_1;
+/*
+    Deprecated: Matrix<4,4> version of jacob_p_internal, forwards to the RigidTransform version
+*/
+Matrix<3, Dynamic> Robot::jacob_p_internal(const vector<Matrix<4, 4>>& all_T) const
+{
+  return jacob_p_internal(vector<RigidTransform>(all_T.begin(), all_T.end()));
+}
 
-        break;
-      }
+/*
+    Deprecated: Matrix<4,4> version of jacob_o_geometric_internal, forwards to the RigidTransform version
+*/
+Matrix<3, Dynamic> Robot::jacob_o_geometric_internal(const vector<Matrix<4, 4>>& all_T) const
+{
+  return jacob_o_geometric_internal(vector<RigidTransform>(all_T.begin(), all_T.end()));
+}
 
-      default:
+/*
+    Internal computation of the full geometric jacobian in the frame {f}
+    Position and orientation columns are filled in a single loop over the frames
+    The input is a vector of all transformation the considered joints i.e.
+    [ b_T_0 , b_T_1, ... , (b_T_j*j_T_f) ] (size = joints+1)
+    J_geo must be already of size 6 x joints
+*/
+void Robot::jacob_geometric_internal(const vector<RigidTransform>& all_T, Matrix<6, Dynamic>& J_geo) const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  int numQ = all_T.size() - 1;
+
+  const Vector<3>& p_e = all_T.back().p;
+
+  for (int i = 0; i < numQ; i++)
+  {
+    Vector<3> z_i_1 = all_T[i].z();
+
+    if (chain.isPrismatic(i))
+    {
+      J_geo.T()[i].slice<0, 3>() = z_i_1;
+      J_geo.T()[i].slice<3, 3>() = Zeros;
+    }
+    else  // Revolute
+    {
+      const Vector<3>& p_i_1 = all_T[i].p;
+
+      J_geo.T()[i].slice<0, 3>() = z_i_1 ^ (p_e - p_i_1);
+      J_geo.T()[i].slice<3, 3>() = z_i_1;
+    }
+  }
+}
+
+/*
+    Internal computation of the rows of the geometric jacobian in the frame {f}
+    Only the position rows (if position is true) and the orientation rows (if orientation is true) are computed,
+    the other rows of J_geo are set to zero
+    J_geo must be already of size 6 x joints
+*/
+void Robot::jacob_geometric_internal(const vector<RigidTransform>& all_T, bool position, bool orientation,
+                                     Matrix<6, Dynamic>& J_geo) const
+{
+  if (position && orientation)
+  {
+    jacob_geometric_internal(all_T, J_geo);
+    return;
+  }
+
+  const CompiledChain& chain = getCompiledChain();
+
+  int numQ = all_T.size() - 1;
+
+  const Vector<3>& p_e = all_T.back().p;
+
+  for (int i = 0; i < numQ; i++)
+  {
+    Vector<3> z_i_1 = all_T[i].z();
+
+    if (position)
+    {
+      if (chain.isPrismatic(i))
+      {
+        J_geo.T()[i].slice<0, 3>() = z_i_1;
+      }
+      else  // Revolute
       {
-        cout << ROBOT_ERROR_COLOR "[Robot] Error in jacob_o_geometric_internal( const vector<Matrix<4,4>>& all_T ): "
-                                  "invalid _links["
-             << i << "].type()=" << _links[i]->type() << ROBOT_CRESET << endl;
-        exit(-1);
+        J_geo.T()[i].slice<0, 3>() = z_i_1 ^ (p_e - all_T[i].p);
       }
     }
+    else
+    {
+      J_geo.T()[i].slice<0, 3>() = Zeros;
+    }
+
+    if (orientation && !chain.isPrismatic(i))
+    {
+      J_geo.T()[i].slice<3, 3>() = z_i_1;
+    }
+    else  // Prismatic or orientation rows not required
+    {
+      J_geo.T()[i].slice<3, 3>() = Zeros;
+    }
   }
+}
 
-  return Jo_geometric;
+/*
+    Internal computation of the columns of the active joints of the geometric jacobian in the frame {f}
+    joint_mask[i] is false if the i-th joint is locked, the column of a locked joint is set to zero
+    J_geo must be already of size 6 x joints
+*/
+void Robot::jacob_geometric_internal(const vector<RigidTransform>& all_T, const vector<bool>& joint_mask,
+                                     Matrix<6, Dynamic>& J_geo) const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  int numQ = all_T.size() - 1;
+
+  const Vector<3>& p_e = all_T.back().p;
+
+  for (int i = 0; i < numQ; i++)
+  {
+    if (!joint_mask[i])
+    {
+      J_geo.T()[i] = Zeros;
+      continue;
+    }
+
+    Vector<3> z_i_1 = all_T[i].z();
+
+    if (chain.isPrismatic(i))
+    {
+      J_geo.T()[i].slice<0, 3>() = z_i_1;
+      J_geo.T()[i].slice<3, 3>() = Zeros;
+    }
+    else  // Revolute
+    {
+      J_geo.T()[i].slice<0, 3>() = z_i_1 ^ (p_e - all_T[i].p);
+      J_geo.T()[i].slice<3, 3>() = z_i_1;
+    }
+  }
+}
+
+/*
+    Internal computation of the velocities of the frames given the frames all_T and the joint velocities
+    axis_dot[i] is the time derivative of the axis z_i of all_T[i] (size = joints)
+    origin_dot[i] is the velocity of the origin of all_T[i] (size = joints+1, origin_dot.back() is the velocity of p_e)
+*/
+void Robot::frames_velocity_internal(const vector<RigidTransform>& all_T, const Vector<>& qDH_dot,
+                                     vector<Vector<3>>& axis_dot, vector<Vector<3>>& origin_dot) const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  int numQ = all_T.size() - 1;
+
+  // The base frame is fixed
+  Vector<3> omega = Zeros;     // angular velocity of the frame all_T[i]
+  Vector<3> velocity = Zeros;  // velocity of the origin of all_T[i]
+
+  for (int i = 0; i < numQ; i++)
+  {
+    const Vector<3> z_i_1 = all_T[i].z();
+    const Vector<3> r = all_T[i + 1].p - all_T[i].p;
+
+    axis_dot[i] = omega ^ z_i_1;
+    origin_dot[i] = velocity;
+
+    if (chain.isPrismatic(i))
+    {
+      velocity += (omega ^ r) + qDH_dot[i] * z_i_1;
+    }
+    else  // Revolute, the origin of all_T[i] lies on the axis
+    {
+      omega += qDH_dot[i] * z_i_1;
+      velocity += omega ^ r;
+    }
+  }
+
+  origin_dot[numQ] = velocity;
+}
+
+/*
+    Internal computation of the time derivative of the geometric jacobian in the frame {f}
+    axis_dot and origin_dot are the velocities of the frames all_T (see frames_velocity_internal)
+    J_geo_dot must be already of size 6 x joints
+*/
+void Robot::jacob_geometric_dot_internal(const vector<RigidTransform>& all_T, const vector<Vector<3>>& axis_dot,
+                                         const vector<Vector<3>>& origin_dot, Matrix<6, Dynamic>& J_geo_dot) const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  int numQ = all_T.size() - 1;
+
+  const Vector<3>& p_e = all_T.back().p;
+  const Vector<3>& p_e_dot = origin_dot[numQ];
+
+  for (int i = 0; i < numQ; i++)
+  {
+    if (chain.isPrismatic(i))
+    {
+      J_geo_dot.T()[i].slice<0, 3>() = axis_dot[i];
+      J_geo_dot.T()[i].slice<3, 3>() = Zeros;
+    }
+    else  // Revolute
+    {
+      // d/dt( z_i_1 ^ (p_e - p_i_1) )
+      J_geo_dot.T()[i].slice<0, 3>() =
+          (axis_dot[i] ^ (p_e - all_T[i].p)) + (all_T[i].z() ^ (p_e_dot - origin_dot[i]));
+      J_geo_dot.T()[i].slice<3, 3>() = axis_dot[i];
+    }
+  }
+}
+
+/*
+    Internal computation of the drift term J_geo_dot*qDH_dot in the frame {f}
+    This is the acceleration [linear; angular] of the frame {f} for zero joint accelerations,
+    computed in a single forward recursion over the frames all_T (J_geo_dot is not formed)
+*/
+Vector<6> Robot::jacob_geometric_dot_qdot_internal(const vector<RigidTransform>& all_T, const Vector<>& qDH_dot) const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  int numQ = all_T.size() - 1;
+
+  Vector<3> omega = Zeros;      // angular velocity of the frame all_T[i]
+  Vector<3> omega_dot = Zeros;  // angular acceleration of the frame all_T[i]
+  Vector<3> acc = Zeros;        // linear acceleration of the origin of all_T[i]
+
+  for (int i = 0; i < numQ; i++)
+  {
+    const Vector<3> z_i_1 = all_T[i].z();
+    const Vector<3> r = all_T[i + 1].p - all_T[i].p;
+
+    if (chain.isPrismatic(i))
+    {
+      acc += (omega_dot ^ r) + (omega ^ (omega ^ r)) + 2.0 * qDH_dot[i] * (omega ^ z_i_1);
+    }
+    else  // Revolute
+    {
+      omega_dot += qDH_dot[i] * (omega ^ z_i_1);
+      omega += qDH_dot[i] * z_i_1;
+      acc += (omega_dot ^ r) + (omega ^ (omega ^ r));
+    }
+  }
+
+  Vector<6> J_dot_q_dot;
+  J_dot_q_dot.slice<0, 3>() = acc;
+  J_dot_q_dot.slice<3, 3>() = omega_dot;
+  return J_dot_q_dot;
+}
+
+/*
+    Check the sizes of the inputs of the jacobian derivative functions, exit on error
+*/
+void Robot::checkJacobDotSizes(const char* function_name, const Vector<>& q_DH, const Vector<>& qDH_dot) const
+{
+  const int numQ = getNumJoints();
+  if (q_DH.size() != numQ || qDH_dot.size() != numQ)
+  {
+    cout << ROBOT_ERROR_COLOR "[Robot] Error in " << function_name
+         << "(): invalid size of the inputs, the robot has " << numQ << " joints" ROBOT_CRESET << endl;
+    exit(-1);
+  }
 }
 
 /*
@@ -791,8 +1633,9 @@ Matrix<3, Dynamic> Robot::jacob_o_geometric_internal(const vector<Matrix<4, 4>>&
 */
 Matrix<3, Dynamic> Robot::jacob_p(const Vector<>& q_DH, int n_joint, const Matrix<4, 4>& j_T_f) const
 {
-  vector<Matrix<4, 4>> all_T = fkine_all(q_DH, n_joint);
-  all_T.back() = all_T.back() * j_T_f;
+  vector<RigidTransform> all_T;
+  fkine_all_internal(q_DH, n_joint, all_T);
+  all_T.back() *= RigidTransform(j_T_f);
   return jacob_p_internal(all_T);
 }
 
@@ -803,7 +1646,9 @@ Matrix<3, Dynamic> Robot::jacob_p(const Vector<>& q_DH, int n_joint, const Matri
 */
 Matrix<3, Dynamic> Robot::jacob_p(const Vector<>& q_DH, int n_joint) const
 {
-  return jacob_p_internal(fkine_all(q_DH, n_joint));
+  vector<RigidTransform> all_T;
+  fkine_all_internal(q_DH, n_joint, all_T);
+  return jacob_p_internal(all_T);
 }
 
 /*
@@ -822,8 +1667,9 @@ Matrix<3, Dynamic> Robot::jacob_p(const Vector<>& q_DH) const
 */
 Matrix<3, Dynamic> Robot::jacob_o_geometric(const Vector<>& q_DH, int n_joint, const Matrix<4, 4>& j_T_f) const
 {
-  vector<Matrix<4, 4>> all_T = fkine_all(q_DH, n_joint);
-  all_T.back() = all_T.back() * j_T_f;
+  vector<RigidTransform> all_T;
+  fkine_all_internal(q_DH, n_joint, all_T);
+  all_T.back() *= RigidTransform(j_T_f);
   return jacob_o_geometric_internal(all_T);
 }
 
@@ -834,7 +1680,9 @@ Matrix<3, Dynamic> Robot::jacob_o_geometric(const Vector<>& q_DH, int n_joint, c
 */
 Matrix<3, Dynamic> Robot::jacob_o_geometric(const Vector<>& q_DH, int n_joint) const
 {
-  return jacob_o_geometric_internal(fkine_all(q_DH, n_joint));
+  vector<RigidTransform> all_T;
+  fkine_all_internal(q_DH, n_joint, all_T);
+  return jacob_o_geometric_internal(all_T);
 }
 
 /*
@@ -853,16 +1701,16 @@ Matrix<3, Dynamic> Robot::jacob_o_geometric(const Vector<>& q_DH) const
 */
 Matrix<6, Dynamic> Robot::jacob_geometric(const Vector<>& q_DH, int n_joint, const Matrix<4, 4>& j_T_f) const
 {
-  vector<Matrix<4, 4>> all_T = fkine_all(q_DH, n_joint);
-  all_T.back() = all_T.back() * j_T_f;
+  vector<RigidTransform> all_T;
+  fkine_all_internal(q_DH, n_joint, all_T);
+  all_T.back() *= RigidTransform(j_T_f);
 
   if (n_joint == getNumJoints() + 1)
     n_joint--;
 
   Matrix<6, Dynamic> J_geo = Zeros(6, n_joint);
 
-  J_geo.slice(0, 0, 3, n_joint) = jacob_p_internal(all_T);
-  J_geo.slice(3, 0, 3, n_joint) = jacob_o_geometric_internal(all_T);
+  jacob_geometric_internal(all_T, J_geo);
 
   return J_geo;
 }
@@ -874,15 +1722,15 @@ Matrix<6, Dynamic> Robot::jacob_geometric(const Vector<>& q_DH, int n_joint, con
 */
 Matrix<6, Dynamic> Robot::jacob_geometric(const Vector<>& q_DH, int n_joint) const
 {
-  vector<Matrix<4, 4>> all_T = fkine_all(q_DH, n_joint);
+  vector<RigidTransform> all_T;
+  fkine_all_internal(q_DH, n_joint, all_T);
 
   if (n_joint == getNumJoints() + 1)
     n_joint--;
 
   Matrix<6, Dynamic> J_geo = Zeros(6, n_joint);
 
-  J_geo.slice(0, 0, 3, n_joint) = jacob_p_internal(all_T);
-  J_geo.slice(3, 0, 3, n_joint) = jacob_o_geometric_internal(all_T);
+  jacob_geometric_internal(all_T, J_geo);
 
   return J_geo;
 }
@@ -895,6 +1743,135 @@ Matrix<6, Dynamic> Robot::jacob_geometric(const Vector<>& q_DH) const
   return jacob_geometric(q_DH, getNumJoints() + 1);
 }
 
+/*
+    Compute the geometric jacobian in frame {end-effector} w.r.t. base frame into the workspace
+    The result is ws.jacob, also ws.all_T is updated (ws.all_T.back() is b_T_e)
+    This function does not allocate memory
+*/
+const Matrix<6, Dynamic>& Robot::jacob_geometric(const Vector<>& q_DH, KinematicsWorkspace& ws) const
+{
+  fkine_all(q_DH, ws);
+  jacob_geometric_internal(ws.all_T, ws.jacob);
+  return ws.jacob;
+}
+
+/*
+    Compute the geometric jacobian in frame {end-effector} w.r.t. base frame into the workspace,
+    only the columns of the active joints (the column of a locked joint is zero)
+    The result is ws.jacob, also ws.all_T is updated (ws.all_T.back() is b_T_e)
+    This function does not allocate memory
+*/
+const Matrix<6, Dynamic>& Robot::jacob_geometric(const Vector<>& q_DH, const vector<bool>& joint_mask,
+                                                 KinematicsWorkspace& ws) const
+{
+  fkine_all(q_DH, ws);
+  jacob_geometric_internal(ws.all_T, joint_mask, ws.jacob);
+  return ws.jacob;
+}
+
+/*
+    Incremental geometric jacobian in frame {end-effector} w.r.t. base frame
+    The frames are updated as in the incremental fkine, the columns of the unchanged joints are reused
+    (only their position part is updated to the new end-effector position).
+    The result is cache.jacob, also cache.b_T_e is updated
+    This function does not allocate memory
+*/
+const Matrix<6, Dynamic>& Robot::jacob_geometric(const Vector<>& q_DH, KinematicsCache& cache) const
+{
+  updateKinematicsCache(q_DH, cache);
+
+  const int numQ = cache._num_joints;
+  const int first = cache._num_valid_columns;
+  if (first == numQ)
+  {
+    return cache.jacob;
+  }
+
+  const CompiledChain& chain = getCompiledChain();
+  const Vector<3>& p_e = cache.b_T_e.p;
+
+  // unchanged joints: z_i_1 is the orientation part of the column
+  for (int i = 0; i < first; i++)
+  {
+    if (!chain.isPrismatic(i))
+    {
+      const Vector<3>& p_i_1 = cache.all_T[i].p;
+      cache.jacob.T()[i].slice<0, 3>() = cache.jacob.T()[i].slice<3, 3>() ^ (p_e - p_i_1);
+    }
+  }
+
+  for (int i = first; i < numQ; i++)
+  {
+    Vector<3> z_i_1 = cache.all_T[i].z();
+
+    if (chain.isPrismatic(i))
+    {
+      cache.jacob.T()[i].slice<0, 3>() = z_i_1;
+      cache.jacob.T()[i].slice<3, 3>() = Zeros;
+    }
+    else  // Revolute
+    {
+      const Vector<3>& p_i_1 = cache.all_T[i].p;
+
+      cache.jacob.T()[i].slice<0, 3>() = z_i_1 ^ (p_e - p_i_1);
+      cache.jacob.T()[i].slice<3, 3>() = z_i_1;
+    }
+  }
+
+  cache._num_valid_columns = numQ;
+  return cache.jacob;
+}
+
+/*
+    Fused fkine and geometric jacobian in frame {end-effector} w.r.t. base frame
+    The kinematic chain is traversed only once, the frames are shared between the fkine and the jacobian
+    Outputs:
+        return: geometric jacobian (6 x NUM_JOINT)
+        b_T_e: end-effector pose
+        all_T: all the transformations [ b_T_0 , b_T_1, ... , b_T_e ] (size = NUM_JOINT+1)
+*/
+Matrix<6, Dynamic> Robot::fkine_jacob_geometric(const Vector<>& q_DH,
+                                                // Return Vars
+                                                Matrix<4, 4>& b_T_e, vector<Matrix<4, 4>>& all_T) const
+{
+  vector<RigidTransform> all_T_rigid;
+  fkine_all_internal(q_DH, getNumJoints() + 1, all_T_rigid);
+
+  all_T.resize(all_T_rigid.size());
+  for (size_t i = 0; i < all_T_rigid.size(); i++)
+  {
+    all_T_rigid[i].toMatrix(all_T[i]);
+  }
+  b_T_e = all_T.back();
+
+  Matrix<6, Dynamic> J_geo = Zeros(6, getNumJoints());
+
+  jacob_geometric_internal(all_T_rigid, J_geo);
+
+  return J_geo;
+}
+
+/*
+    Fused fkine and geometric jacobian in frame {end-effector} w.r.t. base frame
+    Outputs:
+        return: geometric jacobian (6 x NUM_JOINT)
+        b_T_e: end-effector pose
+*/
+Matrix<6, Dynamic> Robot::fkine_jacob_geometric(const Vector<>& q_DH,
+                                                // Return Vars
+                                                Matrix<4, 4>& b_T_e) const
+{
+  vector<RigidTransform> all_T;
+  fkine_all_internal(q_DH, getNumJoints() + 1, all_T);
+  all_T.back().toMatrix(b_T_e);
+
+  Matrix<6, Dynamic> J_geo = Zeros(6, getNumJoints());
+
+  jacob_geometric_internal(all_T, J_geo);
+
+  return J_geo;
+}
+
 /*
     Ginven the jacobian b_J in frame {b} and the rotation matrix u_R_b of frame {b} w.r.t. frame {u},
     compute the jacobian w.r.t frame {u} (pag 113)
@@ -929,6 +1906,58 @@ Matrix<> Robot::change_jacob_frame(Matrix<> b_J, const Matrix<3, 3>& u_R_b)
   }
 }
 
+/*
+    Compute the time derivative of the geometric jacobian in frame {end-effector} w.r.t. base frame
+    The columns are computed analytically in O(NUM_JOINT) from the frames of fkine_all
+    and the velocities of the joint axes and of the frame origins
+*/
+Matrix<6, Dynamic> Robot::jacob_geometric_dot(const Vector<>& q_DH, const Vector<>& qDH_dot) const
+{
+  KinematicsWorkspace ws(getNumJoints());
+  return jacob_geometric_dot(q_DH, qDH_dot, ws);
+}
+
+/*
+    Compute the time derivative of the geometric jacobian in frame {end-effector} w.r.t. base frame
+    into the workspace
+    The result is ws.jacob_dot, also ws.all_T, ws.jacob, ws.joint_axis_dot and ws.joint_origin_dot are updated
+    This function does not allocate memory
+*/
+const Matrix<6, Dynamic>& Robot::jacob_geometric_dot(const Vector<>& q_DH, const Vector<>& qDH_dot,
+                                                     KinematicsWorkspace& ws) const
+{
+  checkJacobDotSizes("jacob_geometric_dot", q_DH, qDH_dot);
+  fkine_all(q_DH, ws);
+  jacob_geometric_internal(ws.all_T, ws.jacob);
+  frames_velocity_internal(ws.all_T, qDH_dot, ws.joint_axis_dot, ws.joint_origin_dot);
+  jacob_geometric_dot_internal(ws.all_T, ws.joint_axis_dot, ws.joint_origin_dot, ws.jacob_dot);
+  return ws.jacob_dot;
+}
+
+/*
+    Compute the drift term J_dot*qDH_dot of the geometric jacobian in frame {end-effector} w.r.t. base frame
+    This is the end-effector acceleration [linear; angular] for zero joint accelerations
+*/
+Vector<6> Robot::jacob_geometric_dot_qdot(const Vector<>& q_DH, const Vector<>& qDH_dot) const
+{
+  checkJacobDotSizes("jacob_geometric_dot_qdot", q_DH, qDH_dot);
+  vector<RigidTransform> all_T;
+  fkine_all_internal(q_DH, getNumJoints() + 1, all_T);
+  return jacob_geometric_dot_qdot_internal(all_T, qDH_dot);
+}
+
+/*
+    Compute the drift term J_dot*qDH_dot of the geometric jacobian in frame {end-effector} w.r.t. base frame
+    ws.all_T is updated as fkine_all
+    This function does not allocate memory
+*/
+Vector<6> Robot::jacob_geometric_dot_qdot(const Vector<>& q_DH, const Vector<>& qDH_dot, KinematicsWorkspace& ws) const
+{
+  checkJacobDotSizes("jacob_geometric_dot_qdot", q_DH, qDH_dot);
+  fkine_all(q_DH, ws);
+  return jacob_geometric_dot_qdot_internal(ws.all_T, qDH_dot);
+}
+
 /*========END Jacobians=========*/
 
 /*========CLIK=========*/
@@ -961,6 +1990,14 @@ Vector<> Robot::clik(const Vector<>& qDH_k, const Vector<6>& error, const Matrix
   // Method with the DLS
   Vector<6> vel_e = (veld + gain * error);
   double damping = norm(vel_e) / _dls_joint_speed_saturation;
+
+  if (_clik_solver == CLIK_SOLVER_CHOLESKY)
+  {
+    clikCholeskyStep(jacob, clik_all_rows, 6, AllColumns(), jacob.num_cols(), vel_e,
+                     max(damping * damping, ROBOT_DLS_MIN_DAMPING_SQ), gain_null_space, q0_p, qpDH);
+    return (qDH_k + qpDH * Ts);
+  }
+
   Matrix<> J_pinv_dls = pinv_DLS(jacob, damping);
   qpDH = J_pinv_dls * vel_e;
 
@@ -973,6 +2010,207 @@ Vector<> Robot::clik(const Vector<>& qDH_k, const Vector<6>& error, const Matrix
   return (qDH_k + qpDH * Ts);
 }
 
+/*
+    Very General CLIK, allocation-free version
+    The Jacobian calculated in qDH_k has to be in ws.jacob (use appropriate jacob function here)
+    The DLS pseudo inverse and the null space projector are computed into the workspace
+    Inputs:
+        - qDH_k: joints at time k
+        - error: error vector (use the appropriate error type here)
+        - veld: desired velocity
+        - gain: CLIK Gain
+        - Ts: sampling time
+        - gain_null_space: Gain for second objective
+        - q0_p: velocity to be projected into the null space
+        - ws: workspace
+    Outputs:
+        return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1)
+        qpDH: joints velocity at time k+1 (must be of size NUM_JOINT)
+*/
+const Vector<>& Robot::clik(const Vector<>& qDH_k, const Vector<6>& error, const Vector<6>& veld, double gain,
+                            double Ts, double gain_null_space, const Vector<>& q0_p, KinematicsWorkspace& ws,
+                            // Return Vars
+                            Vector<>& qpDH)
+{
+  const int numQ = ws.getNumJoints();
+
+  // Method with the DLS
+  Vector<6> vel_e = (veld + gain * error);
+  double damping = norm(vel_e) / _dls_joint_speed_saturation;
+  double damping_sq = max(damping * damping, ROBOT_DLS_MIN_DAMPING_SQ);
+
+  if (_clik_solver == CLIK_SOLVER_CHOLESKY)
+  {
+    clikCholeskyStep(ws.jacob, clik_all_rows, 6, AllColumns(), numQ, vel_e, damping_sq, gain_null_space, q0_p, qpDH);
+    for (int i = 0; i < numQ; i++)
+    {
+      ws.qDH_k1[i] = qDH_k[i] + qpDH[i] * Ts;
+    }
+    return ws.qDH_k1;
+  }
+
+  // J_pinv_dls = J^T * ( J*J^T + damping^2*I )^-1
+  // Only fixed size temporaries are used here, the dynamic ones are in the workspace
+  Matrix<6, 6> JJt = ws.jacob * ws.jacob.T();
+  for (int i = 0; i < 6; i++)
+  {
+    JJt(i, i) += damping_sq;
+  }
+  Cholesky<6> JJt_chol(JJt);
+  Matrix<6, 6> JJt_inv = JJt_chol.get_inverse();
+
+  for (int i = 0; i < numQ; i++)
+  {
+    for (int j = 0; j < 6; j++)
+    {
+      double acc = 0.0;
+      for (int k = 0; k < 6; k++)
+      {
+        acc += ws.jacob(k, i) * JJt_inv(k, j);
+      }
+      ws.J_pinv_dls(i, j) = acc;
+    }
+  }
+
+  for (int i = 0; i < numQ; i++)
+  {
+    qpDH[i] = ws.J_pinv_dls[i] * vel_e;
+  }
+
+  // Null space
+  if (gain_null_space != 0.0)
+  {
+    // null_proj = I - J_pinv_dls * J
+    for (int i = 0; i < numQ; i++)
+    {
+      for (int j = 0; j < numQ; j++)
+      {
+        ws.null_proj(i, j) = ((i == j) ? 1.0 : 0.0) - ws.J_pinv_dls[i] * ws.jacob.T()[j];
+      }
+    }
+    for (int i = 0; i < numQ; i++)
+    {
+      qpDH[i] += gain_null_space * (ws.null_proj[i] * q0_p);
+    }
+  }
+
+  for (int i = 0; i < numQ; i++)
+  {
+    ws.qDH_k1[i] = qDH_k[i] + qpDH[i] * Ts;
+  }
+
+  return ws.qDH_k1;
+}
+
+/*
+    DLS step of the masked clik on the reduced task
+    Only the active rows of the mask (m rows) are used: the m x m system (J_m*J_m^T + damping^2*I) is solved with a
+    Cholesky factorization (CLIK_SOLVER_CHOLESKY) or inverted to build the DLS pseudo-inverse and the null space
+    projector into J_pinv_dls and null_proj (CLIK_SOLVER_PINV), the masked rows are never part of the problem.
+    The result is the same of the full DLS with the masked rows of jacob, error and veld set to zero.
+    jacob: 6 x NUM_JOINT, only the active rows are read
+    Outputs:
+        qpDH: joints velocity (must be of size NUM_JOINT)
+    This function does not allocate memory
+*/
+void Robot::clik_masked(const Vector<6>& error, const Vector<6>& veld, const Vector<6, int>& mask, double gain,
+                        double gain_null_space, const Vector<>& q0_p, const Matrix<6, Dynamic>& jacob,
+                        Matrix<Dynamic, 6>& J_pinv_dls, Matrix<>& null_proj,
+                        // Return Vars
+                        Vector<>& qpDH) const
+{
+  int rows[6];
+  const int m = maskRows(mask, rows);
+
+  Vector<6> vel_e = Zeros;
+  for (int a = 0; a < m; a++)
+  {
+    vel_e[rows[a]] = veld[rows[a]] + gain * error[rows[a]];
+  }
+  double damping = norm(vel_e) / _dls_joint_speed_saturation;
+  double damping_sq = max(damping * damping, ROBOT_DLS_MIN_DAMPING_SQ);
+
+  if (_clik_solver == CLIK_SOLVER_PINV)
+  {
+    clikPinvStep(jacob, rows, m, AllColumns(), jacob.num_cols(), vel_e, damping_sq, gain_null_space, q0_p, J_pinv_dls,
+                 null_proj, qpDH);
+    return;
+  }
+
+  clikCholeskyStep(jacob, rows, m, AllColumns(), jacob.num_cols(), vel_e, damping_sq, gain_null_space, q0_p, qpDH);
+}
+
+/*
+    DLS step of the clik on the reduced task (active rows of mask) in the reduced joint space
+    (active joints of joint_mask, the locked joints have zero velocity)
+    A min(m,n) x min(m,n) system is solved, m active rows and n active joints
+    ws.jacob: geometric jacobian, only the active rows and columns are read
+    Outputs:
+        qpDH: joints velocity (must be of size NUM_JOINT)
+    This function does not allocate memory
+*/
+void Robot::clik_joint_masked(const Vector<6>& error, const Vector<6>& veld, const Vector<6, int>& mask,
+                              const vector<bool>& joint_mask, double gain, double gain_null_space,
+                              const Vector<>& q0_p, KinematicsWorkspace& ws,
+                              // Return Vars
+                              Vector<>& qpDH) const
+{
+  if ((int)joint_mask.size() != ws.getNumJoints())
+  {
+    cout << ROBOT_ERROR_COLOR "[Robot] Error in clik( ... ): joint_mask has size " << joint_mask.size()
+         << " but the robot has " << ws.getNumJoints() << " joints" ROBOT_CRESET << endl;
+    exit(-1);
+  }
+
+  int rows[6];
+  const int m = maskRows(mask, rows);
+  const int n = activeJoints(joint_mask, ws.active_joints);
+
+  Vector<6> vel_e = Zeros;
+  for (int a = 0; a < m; a++)
+  {
+    vel_e[rows[a]] = veld[rows[a]] + gain * error[rows[a]];
+  }
+  double damping = norm(vel_e) / _dls_joint_speed_saturation;
+  double damping_sq = max(damping * damping, ROBOT_DLS_MIN_DAMPING_SQ);
+
+  if (_clik_solver == CLIK_SOLVER_PINV)
+  {
+    qpDH = Zeros;
+    clikPinvStep(ws.jacob, rows, m, ws.active_joints.data(), n, vel_e, damping_sq, gain_null_space, q0_p,
+                 ws.J_pinv_dls, ws.null_proj, qpDH);
+    return;
+  }
+
+  clikReducedStep(ws.jacob, rows, m, ws.active_joints.data(), n, vel_e, damping_sq, gain_null_space, q0_p, qpDH);
+}
+
+/*
+    Very General CLIK with locked joints, allocation-free version
+    Only the active joints of joint_mask move, the problem is solved in the reduced joint space
+    The Jacobian calculated in qDH_k has to be in ws.jacob (use jacob_geometric(q_DH, joint_mask, ws))
+    Outputs:
+        return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1), the locked joints are equal to qDH_k
+        qpDH: joints velocity at time k+1 (must be of size NUM_JOINT), zero for the locked joints
+*/
+const Vector<>& Robot::clik(const Vector<>& qDH_k, const Vector<6>& error, const Vector<6>& veld, double gain,
+                            double Ts, double gain_null_space, const Vector<>& q0_p, const vector<bool>& joint_mask,
+                            KinematicsWorkspace& ws,
+                            // Return Vars
+                            Vector<>& qpDH)
+{
+  const int numQ = ws.getNumJoints();
+
+  clik_joint_masked(error, veld, Ones, joint_mask, gain, gain_null_space, q0_p, ws, qpDH);
+
+  for (int i = 0; i < numQ; i++)
+  {
+    ws.qDH_k1[i] = qDH_k[i] + qpDH[i] * Ts;
+  }
+
+  return ws.qDH_k1;
+}
+
 /*
     Clik using Quaternions FULL VERSION
     Inputs:
@@ -1000,9 +2238,11 @@ Vector<> Robot::clik(const Vector<>& qDH_k, const Vector<3>& pd, const UnitQuate
                      // Return Vars
                      Vector<>& qpDH, Vector<6>& error, UnitQuaternion& actualQ)
 {
+  // fkine and geometric Jacobian in a single pass
+  Matrix<4, 4> b_T_e;
+  Matrix<6, Dynamic> jacob = fkine_jacob_geometric(qDH_k, b_T_e);
+
   // Compute Error
-  // fkine
-  Matrix<4, 4> b_T_e = fkine(qDH_k);
   Vector<3> position = b_T_e.T()[3].slice<0, 3>();
   actualQ = UnitQuaternion(b_T_e, oldQ);
   // positionError
@@ -1011,8 +2251,152 @@ Vector<> Robot::clik(const Vector<>& qDH_k, const Vector<3>& pd, const UnitQuate
   UnitQuaternion deltaQ = Qd / actualQ;
   error.slice<3, 3>() = deltaQ.getV();
 
-  // Use the geometric Jacobian
-  Matrix<> jacob = jacob_geometric(qDH_k);
+  // Construct veld
+  Vector<6> veld;
+  veld.slice<0, 3>() = dpd;
+  veld.slice<3, 3>() = omegad;
+
+  // Apply mask
+  for (int i = 0; i < 6; i++)
+  {
+    if (mask[i] == 0)
+    {
+      error[i] = 0.0;
+      veld[i] = 0.0;
+    }
+  }
+
+  int rows[6];
+  if (maskRows(mask, rows) == 6)
+  {
+    // full task
+    return clik(qDH_k,            // Actual joints positions
+                error,            // Actual error
+                jacob,            // Jacobian calculated in qDH_k (use appropriate jacob function here)
+                veld,             // desired velocity
+                gain,             // CLIK Gain
+                Ts,               // sampling time
+                gain_null_space,  // Gain for second objective
+                q0_p,
+                // Return Vars
+                qpDH);
+  }
+
+  // Reduced task made of the active rows only
+  qpDH = Zeros(getNumJoints());
+  Matrix<Dynamic, 6> J_pinv_dls = Zeros(getNumJoints(), 6);
+  Matrix<> null_proj = Zeros(getNumJoints(), getNumJoints());
+  clik_masked(error, veld, mask, gain, gain_null_space, q0_p, jacob, J_pinv_dls, null_proj, qpDH);
+
+  return (qDH_k + qpDH * Ts);
+}
+
+/*
+    Clik using Quaternions FULL VERSION, allocation-free version
+    Same as the FULL VERSION but all the temporaries are stored in the workspace ws
+    Outputs:
+        return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1)
+        qpDH: joints velocity at time k+1 (must be of size NUM_JOINT)
+        error: error vector at time k
+        actualQ: Quaternion at time k (usefull for continuity in the next call of these functions)
+*/
+const Vector<>& Robot::clik(const Vector<>& qDH_k, const Vector<3>& pd, const UnitQuaternion& Qd,
+                            const UnitQuaternion& oldQ, const Vector<3>& dpd, const Vector<3>& omegad,
+                            const Vector<6, int>& mask, double gain, double Ts, double gain_null_space,
+                            const Vector<>& q0_p, KinematicsWorkspace& ws,
+                            // Return Vars
+                            Vector<>& qpDH, Vector<6>& error, UnitQuaternion& actualQ)
+{
+  const int numQ = ws.getNumJoints();
+
+  // fkine and the rows of the geometric Jacobian required by the mask
+  fkine_all(qDH_k, ws);
+  jacob_geometric_internal(ws.all_T, mask[0] != 0 || mask[1] != 0 || mask[2] != 0,
+                           mask[3] != 0 || mask[4] != 0 || mask[5] != 0, ws.jacob);
+  const RigidTransform& b_T_e = ws.all_T.back();
+
+  // Compute Error
+  const Vector<3>& position = b_T_e.p;
+  actualQ = UnitQuaternion(b_T_e.R, oldQ);
+  // positionError
+  error.slice<0, 3>() = pd - position;
+  // orientationError
+  UnitQuaternion deltaQ = Qd / actualQ;
+  error.slice<3, 3>() = deltaQ.getV();
+
+  // Construct veld
+  Vector<6> veld;
+  veld.slice<0, 3>() = dpd;
+  veld.slice<3, 3>() = omegad;
+
+  // Apply mask
+  for (int i = 0; i < 6; i++)
+  {
+    if (mask[i] == 0)
+    {
+      error[i] = 0.0;
+      veld[i] = 0.0;
+    }
+  }
+
+  int rows[6];
+  if (maskRows(mask, rows) == 6)
+  {
+    // full task
+    return clik(qDH_k,            // Actual joints positions
+                error,            // Actual error
+                veld,             // desired velocity
+                gain,             // CLIK Gain
+                Ts,               // sampling time
+                gain_null_space,  // Gain for second objective
+                q0_p,
+                ws,  // workspace (contains the Jacobian)
+                // Return Vars
+                qpDH);
+  }
+
+  // Reduced task made of the active rows only
+  clik_masked(error, veld, mask, gain, gain_null_space, q0_p, ws.jacob, ws.J_pinv_dls, ws.null_proj, qpDH);
+
+  for (int i = 0; i < numQ; i++)
+  {
+    ws.qDH_k1[i] = qDH_k[i] + qpDH[i] * Ts;
+  }
+
+  return ws.qDH_k1;
+}
+
+/*
+    Clik using Quaternions FULL VERSION with locked joints, allocation-free version
+    Only the active joints of joint_mask move, only the columns of the active joints are computed
+    and the problem is solved in the reduced joint space
+    Outputs:
+        return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1), the locked joints are equal to qDH_k
+        qpDH: joints velocity at time k+1 (must be of size NUM_JOINT), zero for the locked joints
+        error: error vector at time k
+        actualQ: Quaternion at time k (usefull for continuity in the next call of these functions)
+*/
+const Vector<>& Robot::clik(const Vector<>& qDH_k, const Vector<3>& pd, const UnitQuaternion& Qd,
+                            const UnitQuaternion& oldQ, const Vector<3>& dpd, const Vector<3>& omegad,
+                            const Vector<6, int>& mask, const vector<bool>& joint_mask, double gain, double Ts,
+                            double gain_null_space, const Vector<>& q0_p, KinematicsWorkspace& ws,
+                            // Return Vars
+                            Vector<>& qpDH, Vector<6>& error, UnitQuaternion& actualQ)
+{
+  const int numQ = ws.getNumJoints();
+
+  // fkine and the columns of the active joints of the geometric Jacobian
+  jacob_geometric(qDH_k, joint_mask, ws);
+  const RigidTransform& b_T_e = ws.all_T.back();
+
+  // Compute Error
+  const Vector<3>& position = b_T_e.p;
+  actualQ = UnitQuaternion(b_T_e.R, oldQ);
+  // positionError
+  error.slice<0, 3>() = pd - position;
+  // orientationError
+  UnitQuaternion deltaQ = Qd / actualQ;
+  error.slice<3, 3>() = deltaQ.getV();
 
   // Construct veld
   Vector<6> veld;
@@ -1025,21 +2409,46 @@ Vector<> Robot::clik(const Vector<>& qDH_k, const Vector<3>& pd, const UnitQuate
     if (mask[i] == 0)
     {
       error[i] = 0.0;
-      jacob[i] = Zeros;
       veld[i] = 0.0;
     }
   }
 
-  return clik(qDH_k,            // Actual joints positions
-              error,            // Actual error
-              jacob,            // Jacobian calculated in qDH_k (use appropriate jacob function here)
-              veld,             // desired velocity
+  // Reduced task in the reduced joint space
+  clik_joint_masked(error, veld, mask, joint_mask, gain, gain_null_space, q0_p, ws, qpDH);
+
+  for (int i = 0; i < numQ; i++)
+  {
+    ws.qDH_k1[i] = qDH_k[i] + qpDH[i] * Ts;
+  }
+
+  return ws.qDH_k1;
+}
+
+/*
+    Clik using Quaternions, allocation-free version
+    Same as the version without mask but all the temporaries are stored in the workspace ws
+    Outputs:
+        return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1)
+        qpDH: joints velocity at time k+1 (must be of size NUM_JOINT)
+        error: error vector at time k
+        actualQ: Quaternion at time k (usefull for continuity in the next call of these functions)
+*/
+const Vector<>& Robot::clik(const Vector<>& qDH_k, const Vector<3>& pd, const UnitQuaternion& Qd,
+                            const UnitQuaternion& oldQ, const Vector<3>& dpd, const Vector<3>& omegad, double gain,
+                            double Ts, double gain_null_space, const Vector<>& q0_p, KinematicsWorkspace& ws,
+                            // Return Vars
+                            Vector<>& qpDH, Vector<6>& error, UnitQuaternion& actualQ)
+{
+  return clik(qDH_k,  // Actual joints positions
+              pd, Qd,
+              oldQ,  // For Quaternion Continuity
+              dpd, omegad, Ones,
               gain,             // CLIK Gain
               Ts,               // sampling time
               gain_null_space,  // Gain for second objective
-              q0_p,
+              q0_p, ws,
               // Return Vars
-              qpDH);
+              qpDH, error, actualQ);
 }
 
 /*
@@ -1163,8 +2572,353 @@ Vector<> Robot::clik(const Vector<>& qDH_k, const Vector<3>& pd, const UnitQuate
               qpDH, error, actualQ);
 }
 
+/*
+    DLS step and integration of the second order clik on the m rows rows[0..m-1] of the task
+    The Jacobian calculated in qDH_k has to be in ws.jacob (only the rows in rows are read)
+    and the frames in ws.all_T
+    This function does not allocate memory
+*/
+const Vector<>& Robot::clik_second_order_internal(const Vector<>& qDH_k, const Vector<>& qpDH_k,
+                                                  const Vector<6>& error, const Vector<6>& veld, const Vector<6>& accd,
+                                                  const int* rows, int m, double gain_p, double gain_d, double Ts,
+                                                  double gain_null_space, const Vector<>& q0_p, KinematicsWorkspace& ws,
+                                                  // Return Vars
+                                                  Vector<>& qpDH_k1, Vector<>& qppDH) const
+{
+  const int numQ = ws.getNumJoints();
+
+  // Drift term from the frames of the jacobian
+  const Vector<6> J_dot_qp = jacob_geometric_dot_qdot_internal(ws.all_T, qpDH_k);
+
+  // acc_e = accd + gain_d*(veld - J*qpDH_k) + gain_p*error - J_dot*qpDH_k
+  Vector<6> acc_e = Zeros;
+  for (int a = 0; a < m; a++)
+  {
+    const int r = rows[a];
+    double vel = 0.0;
+    for (int c = 0; c < numQ; c++)
+    {
+      vel += ws.jacob(r, c) * qpDH_k[c];
+    }
+    acc_e[r] = accd[r] + gain_d * (veld[r] - vel) + gain_p * error[r] - J_dot_qp[r];
+  }
+
+  // The damping is computed on the velocity change in a sampling time
+  double damping = norm(acc_e) * Ts / _dls_joint_speed_saturation;
+
+  // Null space: the internal motion is always damped (gain_d), the velocity q0_p is tracked only if
+  // gain_null_space is not 0 (the damping then acts on the tracking error, no steady-state offset)
+  const double gain_null_space_d = gain_d + gain_null_space;
+  for (int i = 0; i < numQ; i++)
+  {
+    const double q0_p_i = (gain_null_space != 0.0) ? q0_p[i] : 0.0;
+    ws.q0_pp[i] = gain_null_space_d * (q0_p_i - qpDH_k[i]);
+  }
+
+  clikCholeskyStep(ws.jacob, rows, m, AllColumns(), numQ, acc_e, max(damping * damping, ROBOT_DLS_MIN_DAMPING_SQ),
+                   1.0, ws.q0_pp, qppDH);
+
+  // Constant acceleration during Ts (qpDH_k1 can be qpDH_k)
+  for (int i = 0; i < numQ; i++)
+  {
+    ws.qDH_k1[i] = qDH_k[i] + (qpDH_k[i] + 0.5 * qppDH[i] * Ts) * Ts;
+    qpDH_k1[i] = qpDH_k[i] + qppDH[i] * Ts;
+  }
+
+  return ws.qDH_k1;
+}
+
+/*
+    Very General second order (acceleration level) CLIK, allocation-free version
+    qppDH = J^#*( accd + gain_d*(veld - J*qpDH_k) + gain_p*error - J_dot*qpDH_k )
+            + (gain_d + gain_null_space)*(I - J^#*J)*(q0_p - qpDH_k)
+    q0_p is replaced by zero if gain_null_space is 0: the internal motion is always damped
+    The joints are integrated assuming a constant acceleration during the sampling time
+    The Jacobian calculated in qDH_k has to be in ws.jacob and the frames in ws.all_T
+    Outputs:
+        return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1)
+        qpDH_k1: joints velocity at time k+1 (must be of size NUM_JOINT, it can be qpDH_k)
+        qppDH: joints acceleration at time k (must be of size NUM_JOINT)
+*/
+const Vector<>& Robot::clik_second_order(const Vector<>& qDH_k, const Vector<>& qpDH_k, const Vector<6>& error,
+                                         const Vector<6>& veld, const Vector<6>& accd, double gain_p, double gain_d,
+                                         double Ts, double gain_null_space, const Vector<>& q0_p,
+                                         KinematicsWorkspace& ws,
+                                         // Return Vars
+                                         Vector<>& qpDH_k1, Vector<>& qppDH)
+{
+  return clik_second_order_internal(qDH_k, qpDH_k, error, veld, accd, clik_all_rows, 6, gain_p, gain_d, Ts,
+                                    gain_null_space, q0_p, ws, qpDH_k1, qppDH);
+}
+
+/*
+    Second order (acceleration level) Clik using Quaternions FULL VERSION, allocation-free version
+    Outputs:
+        return: qDH_k+1 joints at time k+1 (reference to ws.qDH_k1)
+        qpDH_k1: joints velocity at time k+1 (must be of size NUM_JOINT, it can be qpDH_k)
+        qppDH: joints acceleration at time k (must be of size NUM_JOINT)
+        error: error vector at time k
+        actualQ: Quaternion at time k (usefull for continuity in the next call of these functions)
+*/
+const Vector<>& Robot::clik_second_order(const Vector<>& qDH_k, const Vector<>& qpDH_k, const Vector<3>& pd,
+                                         const UnitQuaternion& Qd, const UnitQuaternion& oldQ, const Vector<3>& dpd,
+                                         const Vector<3>& omegad, const Vector<3>& ddpd, const Vector<3>& domegad,
+                                         const Vector<6, int>& mask, double gain_p, double gain_d, double Ts,
+                                         double gain_null_space, const Vector<>& q0_p, KinematicsWorkspace& ws,
+                                         // Return Vars
+                                         Vector<>& qpDH_k1, Vector<>& qppDH, Vector<6>& error,
+                                         UnitQuaternion& actualQ)
+{
+  // fkine and the rows of the geometric Jacobian required by the mask
+  fkine_all(qDH_k, ws);
+  jacob_geometric_internal(ws.all_T, mask[0] != 0 || mask[1] != 0 || mask[2] != 0,
+                           mask[3] != 0 || mask[4] != 0 || mask[5] != 0, ws.jacob);
+  const RigidTransform& b_T_e = ws.all_T.back();
+
+  // Compute Error
+  actualQ = UnitQuaternion(b_T_e.R, oldQ);
+  // positionError
+  error.slice<0, 3>() = pd - b_T_e.p;
+  // orientationError
+  UnitQuaternion deltaQ = Qd / actualQ;
+  error.slice<3, 3>() = deltaQ.getV();
+
+  // Construct veld and accd
+  Vector<6> veld;
+  veld.slice<0, 3>() = dpd;
+  veld.slice<3, 3>() = omegad;
+  Vector<6> accd;
+  accd.slice<0, 3>() = ddpd;
+  accd.slice<3, 3>() = domegad;
+
+  // Apply mask
+  for (int i = 0; i < 6; i++)
+  {
+    if (mask[i] == 0)
+    {
+      error[i] = 0.0;
+    }
+  }
+
+  int rows[6];
+  const int m = maskRows(mask, rows);
+
+  return clik_second_order_internal(qDH_k, qpDH_k, error, veld, accd, rows, m, gain_p, gain_d, Ts, gain_null_space,
+                                    q0_p, ws, qpDH_k1, qppDH);
+}
+
+/*
+    Second order (acceleration level) Clik using Quaternions FULL VERSION
+    Same as the allocation-free version, a workspace is allocated at each call
+*/
+Vector<> Robot::clik_second_order(const Vector<>& qDH_k, const Vector<>& qpDH_k, const Vector<3>& pd,
+                                  const UnitQuaternion& Qd, const UnitQuaternion& oldQ, const Vector<3>& dpd,
+                                  const Vector<3>& omegad, const Vector<3>& ddpd, const Vector<3>& domegad,
+                                  const Vector<6, int>& mask, double gain_p, double gain_d, double Ts,
+                                  double gain_null_space, const Vector<>& q0_p,
+                                  // Return Vars
+                                  Vector<>& qpDH_k1, Vector<>& qppDH, Vector<6>& error, UnitQuaternion& actualQ)
+{
+  KinematicsWorkspace ws(getNumJoints());
+  Vector<> qpDH_out = Zeros(getNumJoints());
+  Vector<> qppDH_out = Zeros(getNumJoints());
+
+  clik_second_order(qDH_k, qpDH_k, pd, Qd, oldQ, dpd, omegad, ddpd, domegad, mask, gain_p, gain_d, Ts,
+                    gain_null_space, q0_p, ws, qpDH_out, qppDH_out, error, actualQ);
+
+  qpDH_k1 = qpDH_out;
+  qppDH = qppDH_out;
+  return ws.qDH_k1;
+}
+
 /*========END CLIK=========*/
 
+/*========IKINE=========*/
+
+/*
+    Clamp the joints q_DH (DH convention) within the hard joint limits (ROBOT_IKINE_LIMIT_MARGIN inside)
+*/
+void Robot::clampToHardJointLimits(Vector<>& q_DH) const
+{
+  const CompiledChain& chain = getCompiledChain();
+  for (int i = 0; i < chain.num_joints; i++)
+  {
+    const double lower = chain.hard_limit_lower[i] + ROBOT_IKINE_LIMIT_MARGIN;
+    const double higher = chain.hard_limit_higher[i] - ROBOT_IKINE_LIMIT_MARGIN;
+    const double q_R = chain.joint_DH2Robot(i, q_DH[i]);
+    if (q_R < lower)
+    {
+      q_DH[i] = chain.joint_Robot2DH(i, lower);
+    }
+    else if (q_R > higher)
+    {
+      q_DH[i] = chain.joint_Robot2DH(i, higher);
+    }
+  }
+}
+
+/*
+    Iterative inverse kinematics (Levenberg-Marquardt with adaptive damping)
+    Each iteration solves (J*J^T + lambda*I)*y = e, dq = J^T*y with a 6x6 Cholesky factorization
+    lambda is decreased after an accepted step and increased after a rejected one,
+    the jacobian is evaluated only after the accepted steps.
+    Outputs:
+        return: status, iterations, jacobian evaluations and final error,
+                IKINE_INVALID_SIZE if qDH_seed, q_DH or ws are not of size NUM_JOINT
+        q_DH: solution in DH convention (the best iterate if the status is not IKINE_SUCCESS),
+              must be of size NUM_JOINT, not modified if the status is IKINE_INVALID_SIZE
+    This function does not allocate memory
+*/
+IKineResult Robot::ikine(const Matrix<4, 4>& b_T_e, const Vector<>& qDH_seed, const IKineOptions& options,
+                         KinematicsWorkspace& ws,
+                         // Return Vars
+                         Vector<>& q_DH) const
+{
+  return ikine_internal(b_T_e, qDH_seed, options, nullptr, ws, q_DH);
+}
+
+/*
+    Iterative inverse kinematics, see ikine
+    cancel_internal (may be null) is polled together with options.cancel, it is set by ikine_multistart
+*/
+IKineResult Robot::ikine_internal(const Matrix<4, 4>& b_T_e, const Vector<>& qDH_seed, const IKineOptions& options,
+                                  const atomic<bool>* cancel_internal, KinematicsWorkspace& ws,
+                                  // Return Vars
+                                  Vector<>& q_DH) const
+{
+  const int numQ = getNumJoints();
+
+  IKineResult result;
+
+  if (qDH_seed.size() != numQ || q_DH.size() != numQ || ws.getNumJoints() != numQ)
+  {
+    result.status = IKINE_INVALID_SIZE;
+    return result;
+  }
+
+  const RigidTransform b_T_d(b_T_e);
+
+  q_DH = qDH_seed;
+  if (options.clamp_joint_limits)
+  {
+    clampToHardJointLimits(q_DH);
+  }
+
+  Vector<6> error = poseError(b_T_d, fkine_rigid(q_DH, numQ + 1));
+  double cost = error * error;
+  double lambda = options.lambda_initial;
+  bool jacob_valid = false;
+
+  // ws.qDH_k1 is the trial point
+  Vector<>& q_trial = ws.qDH_k1;
+
+  while (true)
+  {
+    if (norm(error.slice<0, 3>()) <= options.tolerance_position &&
+        norm(error.slice<3, 3>()) <= options.tolerance_orientation)
+    {
+      result.status = IKINE_SUCCESS;
+      break;
+    }
+    if (result.iterations >= options.max_iterations)
+    {
+      result.status = IKINE_MAX_ITERATIONS;
+      break;
+    }
+    if ((options.cancel != nullptr && options.cancel->load(memory_order_relaxed)) ||
+        (cancel_internal != nullptr && cancel_internal->load(memory_order_relaxed)))
+    {
+      result.status = IKINE_CANCELLED;
+      break;
+    }
+    result.iterations++;
+
+    if (!jacob_valid)
+    {
+      jacob_geometric(q_DH, ws);
+      result.jacobian_evaluations++;
+      jacob_valid = true;
+    }
+
+    // (J*J^T + lambda*I)*y = e
+    Matrix<6, 6> JJt = ws.jacob * ws.jacob.T();
+    for (int i = 0; i < 6; i++)
+    {
+      JJt(i, i) += lambda;
+    }
+    Cholesky<6> JJt_chol(JJt);
+    const Vector<6> y = JJt_chol.backsub(error);
+
+    // q_trial = q + J^T*y
+    double step_sq = 0.0;
+    for (int j = 0; j < numQ; j++)
+    {
+      double dq = 0.0;
+      for (int r = 0; r < 6; r++)
+      {
+        dq += ws.jacob(r, j) * y[r];
+      }
+      q_trial[j] = q_DH[j] + dq;
+    }
+    if (options.clamp_joint_limits)
+    {
+      clampToHardJointLimits(q_trial);
+    }
+    for (int j = 0; j < numQ; j++)
+    {
+      step_sq += (q_trial[j] - q_DH[j]) * (q_trial[j] - q_DH[j]);
+    }
+    if (step_sq < options.tolerance_step * options.tolerance_step)
+    {
+      result.status = IKINE_STALLED;
+      break;
+    }
+
+    const Vector<6> error_trial = poseError(b_T_d, fkine_rigid(q_trial, numQ + 1));
+    const double cost_trial = error_trial * error_trial;
+
+    if (cost_trial < cost)
+    {
+      // accepted
+      q_DH = q_trial;
+      error = error_trial;
+      cost = cost_trial;
+      jacob_valid = false;
+      lambda = max(lambda * options.lambda_decrease, options.lambda_min);
+    }
+    else
+    {
+      // rejected
+      lambda *= options.lambda_increase;
+      if (lambda > options.lambda_max)
+      {
+        result.status = IKINE_STALLED;
+        break;
+      }
+    }
+  }
+
+  result.error_position = norm(error.slice<0, 3>());
+  result.error_orientation = norm(error.slice<3, 3>());
+
+  return result;
+}
+
+/*
+    Iterative inverse kinematics (Levenberg-Marquardt with adaptive damping)
+    Same as above, the workspace is allocated internally
+*/
+IKineResult Robot::ikine(const Matrix<4, 4>& b_T_e, const Vector<>& qDH_seed,
+                         // Return Vars
+                         Vector<>& q_DH, const IKineOptions& options) const
+{
+  KinematicsWorkspace ws(getNumJoints());
+  q_DH = Zeros(getNumJoints());
+  return ikine(b_T_e, qDH_seed, options, ws, q_DH);
+}
+
+/*========END IKINE=========*/
+
 /*====== COST FUNCTIONS FOR NULL SPACE ======*/
 
 /*
@@ -1211,6 +2965,226 @@ Vector<> Robot::grad_fcst_target_configuration(const Vector<>& q_DH, const Vecto
   return d_W;
 }
 
+/*
+    Internal manipulability sqrt(det(J*J^T)) (sqrt(det(J^T*J)) if NUM_JOINT < 6) of the jacobian ws.jacob
+    If J_pinv is not null the pseudo inverse of ws.jacob is written into it (NUM_JOINT x 6, undefined if singular)
+    Return 0 if ws.jacob is singular
+    This function does not allocate memory
+*/
+double Robot::manipulability_internal(const KinematicsWorkspace& ws, Matrix<Dynamic, 6>* J_pinv) const
+{
+  const int numQ = ws.getNumJoints();
+  const Matrix<6, Dynamic>& J = ws.jacob;
+
+  if (numQ >= 6)
+  {
+    // A = J*J^T
+    Matrix<6, 6> A;
+    for (int a = 0; a < 6; a++)
+    {
+      for (int b = a; b < 6; b++)
+      {
+        double acc = 0.0;
+        for (int c = 0; c < numQ; c++)
+        {
+          acc += J(a, c) * J(b, c);
+        }
+        A(a, b) = acc;
+        A(b, a) = acc;
+      }
+    }
+    Cholesky<6> A_chol(A);
+    const double det = A_chol.determinant();
+    if (!(det > 0.0))
+    {
+      return 0.0;
+    }
+
+    // J_pinv = J^T*A^-1, the row j is A^-1*J_j
+    if (J_pinv != nullptr)
+    {
+      for (int j = 0; j < numQ; j++)
+      {
+        (*J_pinv)[j] = A_chol.backsub(J.T()[j]);
+      }
+    }
+    return sqrt(det);
+  }
+
+  // B = J^T*J, stored in the first rows of a 6x6 matrix, the remaining block is the identity
+  Matrix<6, 6> B = Identity;
+  for (int a = 0; a < numQ; a++)
+  {
+    for (int b = a; b < numQ; b++)
+    {
+      const double acc = J.T()[a] * J.T()[b];
+      B(a, b) = acc;
+      B(b, a) = acc;
+    }
+  }
+  Cholesky<6> B_chol(B);
+  const double det = B_chol.determinant();
+  if (!(det > 0.0))
+  {
+    return 0.0;
+  }
+
+  // J_pinv = B^-1*J^T
+  if (J_pinv != nullptr)
+  {
+    const Matrix<6, 6> B_inv = B_chol.get_inverse();
+    for (int j = 0; j < numQ; j++)
+    {
+      (*J_pinv)[j] = Zeros;
+      for (int l = 0; l < numQ; l++)
+      {
+        (*J_pinv)[j] += B_inv(j, l) * J.T()[l];
+      }
+    }
+  }
+  return sqrt(det);
+}
+
+/*
+    Manipulability measure sqrt(det(J*J^T)) of the geometric jacobian in frame {end-effector}
+    (sqrt(det(J^T*J)) if NUM_JOINT < 6)
+*/
+double Robot::manipulability(const Vector<>& q_DH) const
+{
+  KinematicsWorkspace ws(getNumJoints());
+  return manipulability(q_DH, ws);
+}
+
+/*
+    Manipulability measure of the geometric jacobian in frame {end-effector}, allocation-free version
+    ws.all_T and ws.jacob are updated as in jacob_geometric(q_DH, ws)
+*/
+double Robot::manipulability(const Vector<>& q_DH, KinematicsWorkspace& ws) const
+{
+  fkine_all(q_DH, ws);
+  jacob_geometric_internal(ws.all_T, ws.jacob);
+  return manipulability_internal(ws, nullptr);
+}
+
+/*
+    Gradient of the manipulability measure, to maximize the manipulability (use it as q0_p of clik)
+    Inputs:
+        -q_DH: joint positions
+*/
+Vector<> Robot::grad_fcst_manipulability(const Vector<>& q_DH) const
+{
+  KinematicsWorkspace ws(getNumJoints());
+  Vector<> grad = Zeros(getNumJoints());
+  grad_fcst_manipulability(q_DH, ws, grad);
+  return grad;
+}
+
+/*
+    Gradient of the manipulability measure, allocation-free version
+    d(w)/d(q_k) = w*sum_j M_j*d(J_j)/d(q_k), M_j is the j-th row of the pseudo inverse of J, where
+        j <= k, j revolute: d(J_j)/d(q_k) = [z_j ^ J_P_k; 0]  (p_e moves)
+        j > k, k revolute:  d(J_j)/d(q_k) = z_k ^ J_j         (the column j rotates with the joint k)
+        otherwise the derivative is zero
+    then (a ^ b)*c = a*(b ^ c) gives the two sums
+        w*( J_P_k * sum_{j<=k, revolute} (M_P_j ^ z_j) + z_k * sum_{j>k} (J_P_j ^ M_P_j + J_O_j ^ M_O_j) )
+    accumulated by a forward and a backward pass over the joints
+    Outputs:
+        return: manipulability measure
+        grad: gradient (must be of size NUM_JOINT)
+*/
+double Robot::grad_fcst_manipulability(const Vector<>& q_DH, KinematicsWorkspace& ws,
+                                       // Return Vars
+                                       Vector<>& grad) const
+{
+  const CompiledChain& chain = getCompiledChain();
+  const int numQ = chain.num_joints;
+
+  fkine_all(q_DH, ws);
+  jacob_geometric_internal(ws.all_T, ws.jacob);
+  const double w = manipulability_internal(ws, &ws.J_pinv_dls);
+
+  if (w == 0.0)
+  {
+    grad = Zeros;
+    return 0.0;
+  }
+
+  // Backward pass: the columns after k rotate with the joint k
+  Vector<3> sum_after = Zeros;
+  for (int k = numQ - 1; k >= 0; k--)
+  {
+    grad[k] = chain.isPrismatic(k) ? 0.0 : w * (ws.all_T[k].z() * sum_after);
+    sum_after += (ws.jacob.T()[k].slice<0, 3>() ^ ws.J_pinv_dls[k].slice<0, 3>()) +
+                 (ws.jacob.T()[k].slice<3, 3>() ^ ws.J_pinv_dls[k].slice<3, 3>());
+  }
+
+  // Forward pass: the end-effector moves with the joint k
+  Vector<3> sum_before = Zeros;
+  for (int k = 0; k < numQ; k++)
+  {
+    if (!chain.isPrismatic(k))
+    {
+      sum_before += ws.J_pinv_dls[k].slice<0, 3>() ^ ws.all_T[k].z();
+    }
+    grad[k] += w * (ws.jacob.T()[k].slice<0, 3>() * sum_before);
+  }
+
+  return w;
+}
+
+/*
+    Gradient of cost function to maximize the distance from the soft joint limits (use it as q0_p of clik)
+    The cost is sum_i (qM_i - qm_i)^2 / ( 4*(qM_i - q_i)*(q_i - qm_i) ), the opposite of its gradient is returned
+    Inputs:
+        -q_DH: joint positions
+*/
+Vector<> Robot::grad_fcst_joint_limits(const Vector<>& q_DH) const
+{
+  Vector<> grad = Zeros(getNumJoints());
+  grad_fcst_joint_limits(q_DH, grad);
+  return grad;
+}
+
+/*
+    Gradient of cost function to maximize the distance from the soft joint limits, allocation-free version
+    d(cost)/d(q_i) = range^2*(d_low - d_high)/(4*d_low^2*d_high^2), d_low = q_i - qm_i, d_high = qM_i - q_i
+    The distances are saturated to ROBOT_JOINT_LIMIT_MIN_DISTANCE*range (the joint can be outside the soft limits)
+    Outputs:
+        grad: gradient (must be of size NUM_JOINT)
+*/
+void Robot::grad_fcst_joint_limits(const Vector<>& q_DH,
+                                   // Return Vars
+                                   Vector<>& grad) const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  for (int i = 0; i < chain.num_joints; i++)
+  {
+    double lower = chain.soft_limit_lower[i];
+    double higher = chain.soft_limit_higher[i];
+
+    // case of infinity limits
+    if (isinf(lower) || isinf(higher))
+    {
+      grad[i] = 0.0;
+      continue;
+    }
+
+    lower = chain.joint_Robot2DH(i, lower);
+    higher = chain.joint_Robot2DH(i, higher);
+    if (lower > higher)
+    {
+      swap(lower, higher);
+    }
+
+    const double range = higher - lower;
+    const double d_low = max(q_DH[i] - lower, ROBOT_JOINT_LIMIT_MIN_DISTANCE * range);
+    const double d_high = max(higher - q_DH[i], ROBOT_JOINT_LIMIT_MIN_DISTANCE * range);
+
+    grad[i] = -range * range * (d_low - d_high) / (4.0 * d_low * d_low * d_high * d_high);
+  }
+}
+
 /*====== END COST FUNCTIONS FOR NULL SPACE ======*/
 
 /*==========Operators========*/
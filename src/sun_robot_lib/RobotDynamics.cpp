@@ -0,0 +1,577 @@
+/*
+
+    Robot Class - Dynamics
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <thread>
+#include "sun_robot_lib/Robot.h"
+
+//! Minimum number of configurations computed by each thread of the batched dynamic functions
+#define DYNAMICS_BATCH_MIN_CONF_PER_THREAD 64
+
+/*
+    All the recursions are written in base frame, on the frames computed by the forward pass:
+        - joint i moves link i, its axis is z_{i-1} through the origin o_{i-1} of frame {i-1} (ws.all_T[i])
+        - the dynamic parameters of link i are expressed in frame {i} (ws.all_T[i+1])
+    The gravity is taken into account as an acceleration -g of the base.
+    The spatial vectors of the mass matrix and of the forward dynamics are in base frame as well,
+    [angular; linear] with the linear part referred to the base origin, so that no frame change is needed
+    between the links.
+*/
+
+using namespace TooN;
+using namespace std;
+
+namespace sun
+{
+namespace
+{
+/*
+    Motion subspace of the i-th joint in base frame given the frame {i-1}
+    revolute: [z; o x z], prismatic: [0; z]
+*/
+void jointMotion(bool prismatic, const RigidTransform& T_i_1, Vector<6>& s)
+{
+  const Vector<3> z = T_i_1.z();
+  if (prismatic)
+  {
+    s.slice<0, 3>() = Zeros;
+    s.slice<3, 3>() = z;
+  }
+  else  // Revolute
+  {
+    s.slice<0, 3>() = z;
+    s.slice<3, 3>() = T_i_1.p ^ z;
+  }
+}
+
+/*
+    Spatial inertia of a link in base frame about the base origin
+    T: frame of the link, mass, com and inertia in the link frame
+        I_s = [ I_o     [h]x ]   h = mass*c, I_o = R*inertia*R^T - mass*[c]x*[c]x
+              [ [h]x^T  mass ]
+*/
+void spatialInertia(double mass, const Vector<3>& com, const Matrix<3, 3>& inertia, const RigidTransform& T,
+                    Matrix<6, 6>& I_s)
+{
+  const Vector<3> c = T * com;
+  const Matrix<3, 3> I_c = T.R * inertia * T.R.T();
+  const double cc = c * c;
+  for (int r = 0; r < 3; r++)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      I_s(r, k) = I_c(r, k) - mass * c[r] * c[k];
+      I_s(r + 3, k + 3) = 0.0;
+    }
+    I_s(r, r) += mass * cc;
+    I_s(r + 3, r + 3) = mass;
+  }
+  const Vector<3> h = mass * c;
+  I_s(0, 3) = 0.0;
+  I_s(0, 4) = -h[2];
+  I_s(0, 5) = h[1];
+  I_s(1, 3) = h[2];
+  I_s(1, 4) = 0.0;
+  I_s(1, 5) = -h[0];
+  I_s(2, 3) = -h[1];
+  I_s(2, 4) = h[0];
+  I_s(2, 5) = 0.0;
+  for (int r = 0; r < 3; r++)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      I_s(k + 3, r) = I_s(r, k + 3);
+    }
+  }
+}
+
+/*
+    Spatial cross product of motion vectors: out = v x m
+*/
+void crossMotion(const Vector<6>& v, const Vector<6>& m, Vector<6>& out)
+{
+  const Vector<3> v_w = v.slice<0, 3>();
+  const Vector<3> v_o = v.slice<3, 3>();
+  const Vector<3> m_w = m.slice<0, 3>();
+  const Vector<3> m_o = m.slice<3, 3>();
+  out.slice<0, 3>() = v_w ^ m_w;
+  out.slice<3, 3>() = (v_w ^ m_o) + (v_o ^ m_w);
+}
+
+/*
+    Spatial cross product of a motion vector and a force vector: out = v x* f
+*/
+void crossForce(const Vector<6>& v, const Vector<6>& f, Vector<6>& out)
+{
+  const Vector<3> v_w = v.slice<0, 3>();
+  const Vector<3> v_o = v.slice<3, 3>();
+  const Vector<3> f_n = f.slice<0, 3>();
+  const Vector<3> f_f = f.slice<3, 3>();
+  out.slice<0, 3>() = (v_w ^ f_n) + (v_o ^ f_f);
+  out.slice<3, 3>() = v_w ^ f_f;
+}
+
+/*
+    Split [0,num_conf) in contiguous chunks and call kernel(begin,end) on each of them,
+    one chunk per thread (the last chunk runs in the calling thread)
+*/
+template <class Kernel>
+void runDynamicsChunks(int num_conf, int num_threads, const Kernel& kernel)
+{
+  int max_threads = num_conf / DYNAMICS_BATCH_MIN_CONF_PER_THREAD;
+  if (num_threads > max_threads)
+  {
+    num_threads = max_threads;
+  }
+  if (num_threads <= 1)
+  {
+    kernel(0, num_conf);
+    return;
+  }
+
+  const int chunk = (num_conf + num_threads - 1) / num_threads;
+
+  vector<thread> workers;
+  int begin = 0;
+  while (num_conf - begin > chunk)
+  {
+    workers.push_back(thread(kernel, begin, begin + chunk));
+    begin += chunk;
+  }
+  kernel(begin, num_conf);
+
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+}
+
+}  // namespace
+
+/*
+    Frames of the links [ b_T_0 , b_T_1, ... , b_T_n ] into ws.all_T
+    The last frame is b_T_n, the {end-effector} transformation is NOT applied
+*/
+void Robot::fkine_links_internal(const Vector<>& q_DH, KinematicsWorkspace& ws) const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  ws.all_T[0] = _b_T_0;
+  for (int i = 0; i < chain.num_joints; i++)
+  {
+    ws.all_T[i + 1] = ws.all_T[i];
+    chain.postMultA(i, q_DH[i], ws.all_T[i + 1]);
+  }
+}
+
+/*
+    Check the sizes of the inputs of the dynamic functions, print an error and exit if they are wrong
+    qDH_dot and qDH_dot_dot are not checked if nullptr
+*/
+void Robot::checkDynamicsSizes(const char* function_name, const Vector<>& q_DH, const Vector<>* qDH_dot,
+                               const Vector<>* qDH_dot_dot, const KinematicsWorkspace& ws, const Vector<>& tau) const
+{
+  const int numQ = getNumJoints();
+  if (q_DH.size() != numQ || (qDH_dot != nullptr && qDH_dot->size() != numQ) ||
+      (qDH_dot_dot != nullptr && qDH_dot_dot->size() != numQ) || ws.getNumJoints() != numQ || tau.size() != numQ)
+  {
+    cout << ROBOT_ERROR_COLOR "[Robot] Error in " << function_name
+         << "(): invalid size of the inputs, the robot has " << numQ << " joints" ROBOT_CRESET << endl;
+    exit(-1);
+  }
+}
+
+/*
+    Internal recursive Newton-Euler algorithm
+    The joint velocities (accelerations) are zero if qDH_dot (qDH_dot_dot) is nullptr
+*/
+void Robot::rnea_internal(const Vector<>& q_DH, const Vector<>* qDH_dot, const Vector<>* qDH_dot_dot,
+                          const Vector<3>& gravity, KinematicsWorkspace& ws, Vector<>& tau) const
+{
+  const CompiledChain& chain = getCompiledChain();
+  const int numQ = chain.num_joints;
+
+  // Forward recursion: frames, velocities and accelerations of the links
+  Vector<3> omega = Zeros;      // angular velocity of link i
+  Vector<3> omega_dot = Zeros;  // angular acceleration of link i
+  Vector<3> acc = -gravity;     // linear acceleration of the origin o_i
+
+  ws.all_T[0] = _b_T_0;
+  for (int i = 0; i < numQ; i++)
+  {
+    ws.all_T[i + 1] = ws.all_T[i];
+    chain.postMultA(i, q_DH[i], ws.all_T[i + 1]);
+
+    const RigidTransform& T_i_1 = ws.all_T[i];
+    const RigidTransform& T_i = ws.all_T[i + 1];
+    const Vector<3> z_i_1 = T_i_1.z();
+    const Vector<3> r = T_i.p - T_i_1.p;  // o_i - o_{i-1}
+
+    const double qd = (qDH_dot != nullptr) ? (*qDH_dot)[i] : 0.0;
+    const double qdd = (qDH_dot_dot != nullptr) ? (*qDH_dot_dot)[i] : 0.0;
+
+    if (chain.isPrismatic(i))
+    {
+      acc += (omega_dot ^ r) + (omega ^ (omega ^ r)) + (2.0 * qd) * (omega ^ z_i_1) + qdd * z_i_1;
+    }
+    else  // Revolute
+    {
+      omega_dot += qdd * z_i_1 + qd * (omega ^ z_i_1);
+      omega += qd * z_i_1;
+      acc += (omega_dot ^ r) + (omega ^ (omega ^ r));
+    }
+
+    // Newton-Euler equations of the link (inertia tensor in frame {i})
+    const Vector<3> r_c = T_i.rotate(chain.com[i]);  // c_i - o_i
+    const Vector<3> acc_c = acc + (omega_dot ^ r_c) + (omega ^ (omega ^ r_c));
+    ws.link_force[i] = chain.mass[i] * acc_c;
+
+    const Vector<3> omega_i = T_i.rotateTranspose(omega);
+    const Vector<3> omega_dot_i = T_i.rotateTranspose(omega_dot);
+    const Matrix<3, 3>& I_i = chain.inertia[i];
+    ws.link_moment[i] = T_i.rotate(I_i * omega_dot_i + (omega_i ^ (I_i * omega_i)));
+  }
+
+  // Backward recursion: force and moment (about o_{i-1}) exerted on link i by link i-1
+  Vector<3> f = Zeros;
+  Vector<3> mu = Zeros;
+  for (int i = numQ - 1; i >= 0; i--)
+  {
+    const RigidTransform& T_i_1 = ws.all_T[i];
+    const RigidTransform& T_i = ws.all_T[i + 1];
+    const Vector<3> r = T_i.p - T_i_1.p;
+    const Vector<3> r_c = T_i.rotate(chain.com[i]);
+
+    // f, mu are the ones of link i+1 (mu about o_i)
+    mu += (r ^ f) + ((r + r_c) ^ ws.link_force[i]) + ws.link_moment[i];
+    f += ws.link_force[i];
+
+    tau[i] = chain.isPrismatic(i) ? (f * T_i_1.z()) : (mu * T_i_1.z());
+  }
+
+  // the final frame is the {end-effector}
+  ws.all_T.back() *= _n_T_e;
+}
+
+/*
+    Inverse dynamics: joint torques tau = B(q)*qdd + C(q,qd)*qd + g(q)
+*/
+Vector<> Robot::inverseDynamics(const Vector<>& q_DH, const Vector<>& qDH_dot, const Vector<>& qDH_dot_dot) const
+{
+  KinematicsWorkspace ws(getNumJoints());
+  Vector<> tau = Zeros(getNumJoints());
+  inverseDynamics(q_DH, qDH_dot, qDH_dot_dot, ws, tau);
+  return tau;
+}
+
+/*
+    Inverse dynamics using the workspace (no allocation)
+*/
+void Robot::inverseDynamics(const Vector<>& q_DH, const Vector<>& qDH_dot, const Vector<>& qDH_dot_dot,
+                            KinematicsWorkspace& ws, Vector<>& tau) const
+{
+  checkDynamicsSizes("inverseDynamics", q_DH, &qDH_dot, &qDH_dot_dot, ws, tau);
+  rnea_internal(q_DH, &qDH_dot, &qDH_dot_dot, _gravity, ws, tau);
+}
+
+/*
+    Gravity torques g(q)
+*/
+Vector<> Robot::gravityTorques(const Vector<>& q_DH) const
+{
+  KinematicsWorkspace ws(getNumJoints());
+  Vector<> tau = Zeros(getNumJoints());
+  gravityTorques(q_DH, ws, tau);
+  return tau;
+}
+
+/*
+    Gravity torques g(q) using the workspace (no allocation)
+    At rest the force on link i is m_i*(-g), so the subchain i..n acts as a point mass:
+        f_i = M_i*(-g),  mu_i = (S_i - M_i*o_{i-1}) x (-g)
+    with M_i = sum_{j>=i} m_j and S_i = sum_{j>=i} m_j*c_j
+*/
+void Robot::gravityTorques(const Vector<>& q_DH, KinematicsWorkspace& ws, Vector<>& tau) const
+{
+  checkDynamicsSizes("gravityTorques", q_DH, nullptr, nullptr, ws, tau);
+
+  const CompiledChain& chain = getCompiledChain();
+  const int numQ = chain.num_joints;
+
+  fkine_links_internal(q_DH, ws);
+
+  double M = 0.0;
+  Vector<3> S = Zeros;
+  for (int i = numQ - 1; i >= 0; i--)
+  {
+    M += chain.mass[i];
+    S += chain.mass[i] * (ws.all_T[i + 1] * chain.com[i]);
+
+    const RigidTransform& T_i_1 = ws.all_T[i];
+    if (chain.isPrismatic(i))
+    {
+      tau[i] = -M * (_gravity * T_i_1.z());
+    }
+    else  // Revolute
+    {
+      tau[i] = ((S - M * T_i_1.p) ^ (-_gravity)) * T_i_1.z();
+    }
+  }
+
+  // the final frame is the {end-effector}
+  ws.all_T.back() *= _n_T_e;
+}
+
+/*
+    Coriolis and centrifugal torques C(q,qd)*qd (no gravity, zero accelerations)
+*/
+Vector<> Robot::coriolisTorques(const Vector<>& q_DH, const Vector<>& qDH_dot) const
+{
+  KinematicsWorkspace ws(getNumJoints());
+  Vector<> tau = Zeros(getNumJoints());
+  coriolisTorques(q_DH, qDH_dot, ws, tau);
+  return tau;
+}
+
+/*
+    Coriolis and centrifugal torques C(q,qd)*qd using the workspace (no allocation)
+*/
+void Robot::coriolisTorques(const Vector<>& q_DH, const Vector<>& qDH_dot, KinematicsWorkspace& ws,
+                            Vector<>& tau) const
+{
+  checkDynamicsSizes("coriolisTorques", q_DH, &qDH_dot, nullptr, ws, tau);
+  rnea_internal(q_DH, &qDH_dot, nullptr, Zeros, ws, tau);
+}
+
+/*
+    Joint space mass matrix B(q) by the composite rigid body algorithm
+*/
+Matrix<> Robot::massMatrix(const Vector<>& q_DH) const
+{
+  KinematicsWorkspace ws(getNumJoints());
+  Matrix<> B = Zeros(getNumJoints(), getNumJoints());
+  massMatrix(q_DH, ws, B);
+  return B;
+}
+
+/*
+    Joint space mass matrix B(q) using the workspace (no allocation)
+    The composite inertia of the links i..n is accumulated backward in ws.body_inertia[i],
+    then B(i,j) = s_i^T*I^C_j*s_j for i<=j
+*/
+void Robot::massMatrix(const Vector<>& q_DH, KinematicsWorkspace& ws, Matrix<>& B) const
+{
+  const CompiledChain& chain = getCompiledChain();
+  const int numQ = chain.num_joints;
+
+  if (q_DH.size() != numQ || ws.getNumJoints() != numQ || B.num_rows() != numQ || B.num_cols() != numQ)
+  {
+    cout << ROBOT_ERROR_COLOR "[Robot] Error in massMatrix(): invalid size of the inputs, the robot has " << numQ
+         << " joints" ROBOT_CRESET << endl;
+    exit(-1);
+  }
+
+  fkine_links_internal(q_DH, ws);
+
+  for (int i = 0; i < numQ; i++)
+  {
+    jointMotion(chain.isPrismatic(i), ws.all_T[i], ws.joint_motion[i]);
+    spatialInertia(chain.mass[i], chain.com[i], chain.inertia[i], ws.all_T[i + 1], ws.body_inertia[i]);
+  }
+
+  for (int j = numQ - 1; j >= 0; j--)
+  {
+    if (j < numQ - 1)
+    {
+      ws.body_inertia[j] += ws.body_inertia[j + 1];
+    }
+
+    const Vector<6> F = ws.body_inertia[j] * ws.joint_motion[j];
+    for (int i = 0; i <= j; i++)
+    {
+      B(i, j) = ws.joint_motion[i] * F;
+      B(j, i) = B(i, j);
+    }
+  }
+
+  // the final frame is the {end-effector}
+  ws.all_T.back() *= _n_T_e;
+}
+
+/*
+    Forward dynamics: joint accelerations qdd = B(q)^-1*( tau - C(q,qd)*qd - g(q) )
+*/
+Vector<> Robot::forwardDynamics(const Vector<>& q_DH, const Vector<>& qDH_dot, const Vector<>& tau) const
+{
+  KinematicsWorkspace ws(getNumJoints());
+  Vector<> qDH_dot_dot = Zeros(getNumJoints());
+  forwardDynamics(q_DH, qDH_dot, tau, ws, qDH_dot_dot);
+  return qDH_dot_dot;
+}
+
+/*
+    Forward dynamics using the workspace (no allocation)
+    Articulated body algorithm:
+        - forward pass: velocities, velocity product accelerations and bias forces of the links
+        - backward pass: articulated inertias and bias forces
+        - forward pass: joint accelerations
+*/
+void Robot::forwardDynamics(const Vector<>& q_DH, const Vector<>& qDH_dot, const Vector<>& tau,
+                            KinematicsWorkspace& ws, Vector<>& qDH_dot_dot) const
+{
+  checkDynamicsSizes("forwardDynamics", q_DH, &qDH_dot, &tau, ws, qDH_dot_dot);
+
+  const CompiledChain& chain = getCompiledChain();
+  const int numQ = chain.num_joints;
+
+  fkine_links_internal(q_DH, ws);
+
+  Vector<6> v = Zeros;  // spatial velocity of link i
+  Vector<6> tmp;
+  for (int i = 0; i < numQ; i++)
+  {
+    Vector<6>& s = ws.joint_motion[i];
+    jointMotion(chain.isPrismatic(i), ws.all_T[i], s);
+
+    // c_i = v_{i-1} x s_i*qd_i
+    crossMotion(v, s, ws.body_acc_bias[i]);
+    ws.body_acc_bias[i] *= qDH_dot[i];
+    v += qDH_dot[i] * s;
+
+    // p_i = v_i x* I_i*v_i
+    spatialInertia(chain.mass[i], chain.com[i], chain.inertia[i], ws.all_T[i + 1], ws.body_inertia[i]);
+    tmp = ws.body_inertia[i] * v;
+    crossForce(v, tmp, ws.body_bias[i]);
+  }
+
+  for (int i = numQ - 1; i >= 0; i--)
+  {
+    const Vector<6>& s = ws.joint_motion[i];
+    Matrix<6, 6>& I_A = ws.body_inertia[i];
+    Vector<6>& U = ws.joint_inertia_force[i];
+
+    U = I_A * s;
+    const double D = s * U;
+    if (!(D > 0.0))
+    {
+      cout << ROBOT_ERROR_COLOR "[Robot] Error in forwardDynamics(): singular mass matrix at joint " << i
+           << " (massless links?)" ROBOT_CRESET << endl;
+      exit(-1);
+    }
+    ws.joint_inertia[i] = D;
+    ws.joint_bias_torque[i] = tau[i] - s * ws.body_bias[i];
+
+    if (i > 0)
+    {
+      // I_a = I_A - U*U^T/D (in place),  p_a = p_A + I_a*c + U*u/D
+      for (int r = 0; r < 6; r++)
+      {
+        const double U_r = U[r] / D;
+        for (int c = 0; c < 6; c++)
+        {
+          I_A(r, c) -= U_r * U[c];
+        }
+      }
+      ws.body_bias[i - 1] += ws.body_bias[i] + I_A * ws.body_acc_bias[i] + (ws.joint_bias_torque[i] / D) * U;
+      ws.body_inertia[i - 1] += I_A;
+    }
+  }
+
+  Vector<6> a = Zeros;  // spatial acceleration of link i
+  a.slice<3, 3>() = -_gravity;
+  for (int i = 0; i < numQ; i++)
+  {
+    a += ws.body_acc_bias[i];
+    qDH_dot_dot[i] = (ws.joint_bias_torque[i] - ws.joint_inertia_force[i] * a) / ws.joint_inertia[i];
+    a += qDH_dot_dot[i] * ws.joint_motion[i];
+  }
+
+  // the final frame is the {end-effector}
+  ws.all_T.back() *= _n_T_e;
+}
+
+/*
+    Batched mass matrix (struct-of-arrays layout, see fkine_batch)
+    Each thread uses its own workspace
+*/
+void Robot::massMatrix_batch(const double* q_DH, int num_conf, double* B, int num_threads) const
+{
+  // the chain is compiled here, not concurrently by the threads
+  const int numQ = getCompiledChain().num_joints;
+
+  runDynamicsChunks(num_conf, num_threads, [this, numQ, q_DH, num_conf, B](int begin, int end) {
+    KinematicsWorkspace ws(numQ);
+    Vector<> q = Zeros(numQ);
+    Matrix<> B_k = Zeros(numQ, numQ);
+    for (int k = begin; k < end; k++)
+    {
+      for (int j = 0; j < numQ; j++)
+      {
+        q[j] = q_DH[j * num_conf + k];
+      }
+      massMatrix(q, ws, B_k);
+      for (int r = 0; r < numQ; r++)
+      {
+        for (int c = 0; c < numQ; c++)
+        {
+          B[(r * numQ + c) * num_conf + k] = B_k(r, c);
+        }
+      }
+    }
+  });
+}
+
+/*
+    Batched forward dynamics (struct-of-arrays layout, see fkine_batch)
+    Each thread uses its own workspace
+*/
+void Robot::forwardDynamics_batch(const double* q_DH, const double* qDH_dot, const double* tau, int num_conf,
+                                  double* qDH_dot_dot, int num_threads) const
+{
+  // the chain is compiled here, not concurrently by the threads
+  const int numQ = getCompiledChain().num_joints;
+
+  runDynamicsChunks(num_conf, num_threads,
+                    [this, numQ, q_DH, qDH_dot, tau, num_conf, qDH_dot_dot](int begin, int end) {
+                      KinematicsWorkspace ws(numQ);
+                      Vector<> q = Zeros(numQ);
+                      Vector<> qd = Zeros(numQ);
+                      Vector<> tau_k = Zeros(numQ);
+                      Vector<> qdd = Zeros(numQ);
+                      for (int k = begin; k < end; k++)
+                      {
+                        for (int j = 0; j < numQ; j++)
+                        {
+                          q[j] = q_DH[j * num_conf + k];
+                          qd[j] = qDH_dot[j * num_conf + k];
+                          tau_k[j] = tau[j * num_conf + k];
+                        }
+                        forwardDynamics(q, qd, tau_k, ws, qdd);
+                        for (int j = 0; j < numQ; j++)
+                        {
+                          qDH_dot_dot[j * num_conf + k] = qdd[j];
+                        }
+                      }
+                    });
+}
+
+}  // namespace sun
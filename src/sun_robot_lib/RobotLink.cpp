@@ -22,12 +22,19 @@
 */
 
 #include "sun_robot_lib/RobotLink.h"
+#include <atomic>
 
 using namespace TooN;
 using namespace std;
 
 namespace sun
 {
+namespace
+{
+//! Source of the link versions, shared by all the links
+atomic<uint64_t> link_version_counter(0);
+}  // namespace
+
 /*======CONSTRUCTORS======*/
 
 // Full Constructor
@@ -47,6 +54,11 @@ RobotLink::RobotLink(double a, double alpha, double d, double theta, double robo
   setHardVelocityLimit(hard_velocity_limit);
   setSoftVelocityLimit(soft_velocity_limit);
   _name = name;
+  // massless link by default
+  _mass = 0.0;
+  _com = Zeros;
+  _inertia = Zeros;
+  newVersion();
 }
 
 RobotLink::RobotLink(double a, double alpha, double d, double theta, double robot2dh_offset, bool robot2dh_flip,
@@ -61,6 +73,14 @@ RobotLink::RobotLink(double a, double alpha, double d, double theta, double robo
 
 //========Varie=======//
 
+/*
+    Assign a new version, call this in every function that modifies the parameters
+*/
+void RobotLink::newVersion()
+{
+  _version = ++link_version_counter;
+}
+
 void RobotLink::checkLowerHigher(double lower, double higher)
 {
   if (lower > higher)
@@ -182,8 +202,40 @@ string RobotLink::getName() const
   return _name;
 }
 
+/*
+    Return the link mass
+*/
+double RobotLink::getMass() const
+{
+  return _mass;
+}
+
+/*
+    Return the center of mass of the link in the link frame
+*/
+Vector<3> RobotLink::getCOM() const
+{
+  return _com;
+}
+
+/*
+    Return the inertia tensor of the link w.r.t. the center of mass, in the link frame
+*/
+Matrix<3, 3> RobotLink::getInertia() const
+{
+  return _inertia;
+}
+
 //======END GETTERS===========//
 
+/*
+    Return the version of the parameters, it changes at every modification
+*/
+uint64_t RobotLink::getVersion() const
+{
+  return _version;
+}
+
 //========SETTERS==============//
 
 /*
@@ -192,6 +244,7 @@ string RobotLink::getName() const
 void RobotLink::setDH_a(double a)
 {
   _a = a;
+  newVersion();
 }
 
 /*
@@ -200,6 +253,7 @@ void RobotLink::setDH_a(double a)
 void RobotLink::setDH_alpha(double alpha)
 {
   _alpha = alpha;
+  newVersion();
 }
 
 /*
@@ -209,6 +263,7 @@ void RobotLink::setDH_alpha(double alpha)
 void RobotLink::setDH_d(double d)
 {
   _d = d;
+  newVersion();
 }
 
 /*
@@ -218,6 +273,7 @@ void RobotLink::setDH_d(double d)
 void RobotLink::setDH_theta(double theta)
 {
   _theta = theta;
+  newVersion();
 }
 
 /*
@@ -226,6 +282,7 @@ void RobotLink::setDH_theta(double theta)
 void RobotLink::setRobot2DH_offset(double offset)
 {
   _robot2dh_offset = offset;
+  newVersion();
 }
 
 /*
@@ -234,6 +291,7 @@ void RobotLink::setRobot2DH_offset(double offset)
 void RobotLink::setRobot2DH_flip(bool flip)
 {
   _robot2dh_flip = flip;
+  newVersion();
 }
 
 /*
@@ -244,6 +302,7 @@ void RobotLink::setSoftJointLimits(double lower, double higher)
   checkLowerHigher(lower, higher);
   _Joint_Soft_limit_lower = lower;
   _Joint_Soft_limit_higher = higher;
+  newVersion();
 }
 
 /*
@@ -262,6 +321,7 @@ void RobotLink::setHardJointLimits(double lower, double higher)
   checkLowerHigher(lower, higher);
   _Joint_Hard_limit_lower = lower;
   _Joint_Hard_limit_higher = higher;
+  newVersion();
 }
 
 /*
@@ -285,6 +345,7 @@ void RobotLink::setHardVelocityLimit(double velocity_limit)
     exit(-1);
   }
   _hard_velocity_limit = velocity_limit;
+  newVersion();
 }
 
 /*
@@ -300,6 +361,7 @@ void RobotLink::setSoftVelocityLimit(double velocity_limit)
     exit(-1);
   }
   _soft_velocity_limit = velocity_limit;
+  newVersion();
 }
 
 /*
@@ -310,6 +372,63 @@ void RobotLink::setName(const std::string& name)
   _name = name;
 }
 
+/*
+    Set the link mass
+    ERROR IF mass < 0
+*/
+void RobotLink::setMass(double mass)
+{
+  if (mass < 0.0)
+  {
+    cout << ROBOT_ERROR_COLOR "[RobotLink] Error in setMass( double mass ): mass<0.0" ROBOT_CRESET << endl;
+    exit(-1);
+  }
+  _mass = mass;
+  newVersion();
+}
+
+/*
+    Set the center of mass of the link in the link frame
+*/
+void RobotLink::setCOM(const Vector<3>& com)
+{
+  _com = com;
+  newVersion();
+}
+
+/*
+    Set the inertia tensor of the link w.r.t. the center of mass, in the link frame
+    ERROR IF the tensor is not symmetric
+*/
+void RobotLink::setInertia(const Matrix<3, 3>& inertia)
+{
+  for (int r = 0; r < 3; r++)
+  {
+    for (int c = r + 1; c < 3; c++)
+    {
+      if (fabs(inertia(r, c) - inertia(c, r)) > 1.0E-9 * (1.0 + fabs(inertia(r, c))))
+      {
+        cout << ROBOT_ERROR_COLOR "[RobotLink] Error in setInertia( const Matrix<3, 3>& inertia ): the tensor is "
+                                  "not symmetric" ROBOT_CRESET
+             << endl;
+        exit(-1);
+      }
+    }
+  }
+  _inertia = inertia;
+  newVersion();
+}
+
+/*
+    Set all the dynamic parameters of the link (see setMass, setCOM and setInertia)
+*/
+void RobotLink::setDynamicParameters(double mass, const Vector<3>& com, const Matrix<3, 3>& inertia)
+{
+  setMass(mass);
+  setCOM(com);
+  setInertia(inertia);
+}
+
 //======END SETTERS===========//
 
 /*
@@ -344,7 +463,14 @@ void RobotLink::display() const
        <<
 
       "Soft Velocity Limit: " << _soft_velocity_limit << endl
-       << "Hard Velocity Limit: " << _hard_velocity_limit
+       << "Hard Velocity Limit: " << _hard_velocity_limit << endl
+       <<
+
+      "Dynamic parameters:" << endl
+       << "mass = " << _mass << endl
+       << "com = " << _com << endl
+       << "inertia = " << endl
+       << _inertia
 
       ;  // End COUT
 }
@@ -0,0 +1,134 @@
+/*
+
+    Real-Time Safe Kinematics
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cmath>
+#include "sun_robot_lib/Robot.h"
+
+/*
+    All the functions in this file never allocate memory, never print and never call exit()
+    They only use the allocation-free (workspace) versions of the kinematic functions, whose error paths
+    (compilation of the chain, size checks) are checked here in advance
+*/
+
+using namespace TooN;
+using namespace std;
+
+namespace sun
+{
+/*
+    Check the preconditions of the real-time functions: compiled chain and sizes of q_DH and ws
+*/
+RobotRTStatus Robot::checkRT(const Vector<>& q_DH, const KinematicsWorkspace& ws) const
+{
+  if (!isCompiledChainUpToDate())
+  {
+    return ROBOT_RT_CHAIN_NOT_COMPILED;
+  }
+  if (q_DH.size() != _chain.num_joints || ws.getNumJoints() != _chain.num_joints)
+  {
+    return ROBOT_RT_INVALID_SIZE;
+  }
+  return ROBOT_RT_OK;
+}
+
+/*
+    Real-time safe fkine of all the frames
+    The result is ws.all_T = [ b_T_0 , b_T_1, ... , b_T_e ]
+*/
+RobotRTStatus Robot::fkine_rt(const Vector<>& q_DH, KinematicsWorkspace& ws) const
+{
+  RobotRTStatus status = checkRT(q_DH, ws);
+  if (status != ROBOT_RT_OK)
+  {
+    return status;
+  }
+
+  fkine_all(q_DH, ws);
+
+  const RigidTransform& b_T_e = ws.all_T.back();
+  if (!isfinite(b_T_e.p[0] + b_T_e.p[1] + b_T_e.p[2]))
+  {
+    return ROBOT_RT_NUMERICAL_ERROR;
+  }
+  return ROBOT_RT_OK;
+}
+
+/*
+    Real-time safe geometric jacobian in frame {end-effector} w.r.t. base frame
+    The result is ws.jacob, also ws.all_T is updated (ws.all_T.back() is b_T_e)
+*/
+RobotRTStatus Robot::jacob_geometric_rt(const Vector<>& q_DH, KinematicsWorkspace& ws) const
+{
+  RobotRTStatus status = fkine_rt(q_DH, ws);
+  if (status != ROBOT_RT_OK)
+  {
+    return status;
+  }
+
+  jacob_geometric_internal(ws.all_T, ws.jacob);
+  return ROBOT_RT_OK;
+}
+
+/*
+    Real-time safe clik using Quaternions FULL VERSION
+    Outputs:
+        return: ROBOT_RT_OK on success
+        ws.qDH_k1: joints at time k+1
+        qpDH: joints velocity at time k+1 (must be of size NUM_JOINT)
+        error: error vector at time k
+        actualQ: Quaternion at time k (usefull for continuity in the next call of these functions)
+*/
+RobotRTStatus Robot::clik_rt(const Vector<>& qDH_k, const Vector<3>& pd, const UnitQuaternion& Qd,
+                             const UnitQuaternion& oldQ, const Vector<3>& dpd, const Vector<3>& omegad,
+                             const Vector<6, int>& mask, double gain, double Ts, double gain_null_space,
+                             const Vector<>& q0_p, KinematicsWorkspace& ws,
+                             // Return Vars
+                             Vector<>& qpDH, Vector<6>& error, UnitQuaternion& actualQ)
+{
+  RobotRTStatus status = checkRT(qDH_k, ws);
+  if (status != ROBOT_RT_OK)
+  {
+    return status;
+  }
+  if (qpDH.size() != ws.getNumJoints() || q0_p.size() != ws.getNumJoints())
+  {
+    return ROBOT_RT_INVALID_SIZE;
+  }
+
+  const Vector<>& qDH_k1 = clik(qDH_k, pd, Qd, oldQ, dpd, omegad, mask, gain, Ts, gain_null_space, q0_p, ws,
+                                // Return Vars
+                                qpDH, error, actualQ);
+
+  double sum = 0.0;
+  for (int i = 0; i < ws.getNumJoints(); i++)
+  {
+    sum += qDH_k1[i];
+  }
+  if (!isfinite(sum))
+  {
+    return ROBOT_RT_NUMERICAL_ERROR;
+  }
+  return ROBOT_RT_OK;
+}
+
+}  // namespace sun
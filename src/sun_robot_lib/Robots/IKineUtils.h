@@ -0,0 +1,150 @@
+/*
+
+    Analytic inverse kinematics helpers (private header)
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef IKINEUTILS_H
+#define IKINEUTILS_H
+
+#include <cmath>
+#include "TooN/TooN.h"
+#include "sun_robot_lib/CompiledChain.h"
+
+//! Threshold used by the analytic inverse kinematics to detect the singular configurations
+#define IKINE_SINGULAR_EPS 1.0E-9
+
+namespace sun
+{
+namespace ikine
+{
+/*
+    Rotation matrix about the y axis
+*/
+inline TooN::Matrix<3, 3> rotY(double angle)
+{
+  const double s = sin(angle);
+  const double c = cos(angle);
+  return TooN::Data(c, 0.0, s, 0.0, 1.0, 0.0, -s, 0.0, c);
+}
+
+/*
+    Rotation matrix about the z axis
+*/
+inline TooN::Matrix<3, 3> rotZ(double angle)
+{
+  const double s = sin(angle);
+  const double c = cos(angle);
+  return TooN::Data(c, -s, 0.0, s, c, 0.0, 0.0, 0.0, 1.0);
+}
+
+/*
+    Rotation matrix about the x axis of +pi/2
+*/
+inline TooN::Matrix<3, 3> rotXPlusPi2()
+{
+  return TooN::Data(1.0, 0.0, 0.0, 0.0, 0.0, -1.0, 0.0, 1.0, 0.0);
+}
+
+/*
+    Rotation matrix about the x axis of -pi/2
+*/
+inline TooN::Matrix<3, 3> rotXMinusPi2()
+{
+  return TooN::Data(1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, -1.0, 0.0);
+}
+
+/*
+    Rotation matrix of angle about the unit axis u (Rodrigues formula)
+*/
+inline TooN::Matrix<3, 3> rotAxis(const TooN::Vector<3>& u, double angle)
+{
+  const double s = sin(angle);
+  const double c = cos(angle);
+  const double v = 1.0 - c;
+  return TooN::Data(c + u[0] * u[0] * v, u[0] * u[1] * v - u[2] * s, u[0] * u[2] * v + u[1] * s,  //
+                    u[1] * u[0] * v + u[2] * s, c + u[1] * u[1] * v, u[1] * u[2] * v - u[0] * s,  //
+                    u[2] * u[0] * v - u[1] * s, u[2] * u[1] * v + u[0] * s, c + u[2] * u[2] * v);
+}
+
+/*
+    ZYZ Euler angles: M = Rz(a)*Ry(b)*Rz(c)
+    gc is the sign of sin(b) (branch)
+    In the singular case (sin(b)=0) a is set to 0
+*/
+inline void eulerZYZ(const TooN::Matrix<3, 3>& M, double gc, double& a, double& b, double& c)
+{
+  const double sb = sqrt(M(0, 2) * M(0, 2) + M(1, 2) * M(1, 2));
+  if (sb < IKINE_SINGULAR_EPS)
+  {
+    a = 0.0;
+    b = (M(2, 2) > 0.0) ? 0.0 : M_PI;
+    c = atan2(M(1, 0), M(1, 1));
+    return;
+  }
+  b = atan2(gc * sb, M(2, 2));
+  a = atan2(gc * M(1, 2), gc * M(0, 2));
+  c = atan2(gc * M(2, 1), -gc * M(2, 0));
+}
+
+/*
+    Shift each joint by +-2pi to bring it within the hard limits, when possible
+    q_DH in DH convention
+*/
+template <int Size>
+inline void wrapToHardLimits(const CompiledChain& chain, TooN::Vector<Size>& q_DH)
+{
+  for (int i = 0; i < chain.num_joints; i++)
+  {
+    const double q_R = chain.joint_DH2Robot(i, q_DH[i]);
+    for (double shift : { -2.0 * M_PI, 2.0 * M_PI })
+    {
+      if ((q_R <= chain.hard_limit_lower[i] || q_R >= chain.hard_limit_higher[i]) &&
+          (q_R + shift > chain.hard_limit_lower[i] && q_R + shift < chain.hard_limit_higher[i]))
+      {
+        q_DH[i] = chain.joint_Robot2DH(i, q_R + shift);
+        break;
+      }
+    }
+  }
+}
+
+/*
+    Return true if q_DH (DH convention) is within the hard limits, same check of Robot::exceededHardJointLimits
+    This function does not allocate memory
+*/
+template <int Size>
+inline bool withinHardLimits(const CompiledChain& chain, const TooN::Vector<Size>& q_DH)
+{
+  for (int i = 0; i < chain.num_joints; i++)
+  {
+    const double q_R = chain.joint_DH2Robot(i, q_DH[i]);
+    if (q_R <= chain.hard_limit_lower[i] || q_R >= chain.hard_limit_higher[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace ikine
+}  // namespace sun
+
+#endif
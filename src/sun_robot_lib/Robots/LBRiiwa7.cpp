@@ -22,12 +22,36 @@
 */
 
 #include "sun_robot_lib/Robots/LBRiiwa7.h"
+#include "IKineUtils.h"
 
 using namespace TooN;
 using namespace std;
+using namespace sun::ikine;
 
 namespace sun
 {
+namespace
+{
+/*
+    Shoulder rotation R_03 of the reference plane (q3 = 0)
+    x_sw: shoulder-wrist vector in frame 0
+    q4: elbow joint
+*/
+Matrix<3, 3> referenceShoulder(const Vector<3>& x_sw, double q4, double d_se, double d_ew)
+{
+  // shoulder-wrist vector in frame 0 when q1 = q2 = q3 = 0
+  const double Lx = d_ew * sin(q4);
+  const double Lz = d_se + d_ew * cos(q4);
+
+  const double r = sqrt(x_sw[0] * x_sw[0] + x_sw[1] * x_sw[1]);
+  const double q1 = (r < IKINE_SINGULAR_EPS) ? 0.0 : atan2(x_sw[1], x_sw[0]);
+  const double q2 = atan2(r, x_sw[2]) - atan2(Lx, Lz);
+
+  return rotZ(q1) * rotY(q2) * rotXMinusPi2();
+}
+
+}  // namespace
+
 /*=========CONSTRUCTORS=========*/
 
 /*
@@ -122,6 +146,23 @@ LBRiiwa7::LBRiiwa7(const Matrix<4, 4>& n_T_e, double dls_joint_speed_saturation,
       3.14,
       // string name
       "A7"));
+
+  // Nominal dynamic parameters in the DH frames: mass, center of mass, inertia w.r.t. the center of mass
+  // (approximated from the public description of the robot, identify them for an accurate model)
+  _links[0]->setDynamicParameters(3.4525, makeVector(0.0, 0.0625, -0.03),
+                                  Data(0.02183, 0.0, 0.0, 0.0, 0.02083, 0.0, 0.0, 0.0, 0.007703));
+  _links[1]->setDynamicParameters(3.4821, makeVector(0.0, 0.03, 0.0625),
+                                  Data(0.02076, 0.0, 0.0, 0.0, 0.02179, 0.0, 0.0, 0.0, 0.00779));
+  _links[2]->setDynamicParameters(4.05623, makeVector(0.0, 0.0655, 0.03),
+                                  Data(0.03204, 0.0, 0.0, 0.0, 0.00972, 0.0, 0.0, 0.0, 0.03042));
+  _links[3]->setDynamicParameters(3.4822, makeVector(0.0, 0.034, 0.067),
+                                  Data(0.02178, 0.0, 0.0, 0.0, 0.02075, 0.0, 0.0, 0.0, 0.007785));
+  _links[4]->setDynamicParameters(2.1633, makeVector(0.0, 0.1395, 0.021),
+                                  Data(0.01287, 0.0, 0.0, 0.0, 0.005708, 0.0, 0.0, 0.0, 0.01112));
+  _links[5]->setDynamicParameters(2.3466, makeVector(0.0, 0.0006, 0.0004),
+                                  Data(0.006509, 0.0, 0.0, 0.0, 0.006259, 0.0, 0.0, 0.0, 0.004527));
+  _links[6]->setDynamicParameters(3.129, makeVector(0.0, 0.0, -0.025),
+                                  Data(0.01464, 0.0, 0.0, 0.0, 0.01465, 0.0, 0.0, 0.0, 0.002872));
 }
 
 /*
@@ -138,6 +179,194 @@ LBRiiwa7::LBRiiwa7() : LBRiiwa7("IIWA7_NO_NAME")
 {
 }
 
-}  // namespace sun
+/*
+    Fixed-size engine: full constructor
+*/
+LBRiiwa7Fixed::LBRiiwa7Fixed(const Matrix<4, 4>& n_T_e, double dls_joint_speed_saturation)
+  : FixedRobot<7>(LBRiiwa7(n_T_e, dls_joint_speed_saturation, "IIWA7_FIXED"))
+{
+}
+
+/*
+    Fixed-size engine: empty constructor
+*/
+LBRiiwa7Fixed::LBRiiwa7Fixed() : LBRiiwa7Fixed(Identity, 2.0)
+{
+}
+
+/*=========END CONSTRUCTORS=========*/
+
+/*=========INVERSE KINEMATICS=========*/
+
+/*
+    Check that the kinematic chain still has the structure required by the analytic inverse kinematics
+    (spherical shoulder and wrist, a=0), print an error and exit otherwise
+*/
+void LBRiiwa7::checkIKineStructure() const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  bool ok = (chain.num_joints == 7) && (chain.prismatic_mask == 0);
+  for (int i = 0; ok && i < 7; i++)
+  {
+    const double sin_alpha = (i == 6) ? 0.0 : ((i % 2 == 0) ? -1.0 : 1.0);
+    ok = (chain.a[i] == 0.0) && (fabs(chain.sin_alpha[i] - sin_alpha) < IKINE_SINGULAR_EPS) &&
+         (fabs(chain.cos_alpha[i] - ((i == 6) ? 1.0 : 0.0)) < IKINE_SINGULAR_EPS);
+  }
+  ok = ok && (chain.d[0] == 0.0) && (chain.d[1] == 0.0) && (chain.d[3] == 0.0) && (chain.d[5] == 0.0);
+
+  if (!ok)
+  {
+    cout << ROBOT_ERROR_COLOR "[LBRiiwa7] Error in checkIKineStructure(): the kinematic chain has been modified, "
+                              "the analytic inverse kinematics cannot be used" ROBOT_CRESET
+         << endl;
+    exit(-1);
+  }
+}
+
+/*
+    Analytic inverse kinematics with the arm angle parametrization
+    Outputs:
+        return: number of solutions within the hard joint limits
+        q_DH_solutions: the 8 branch solutions in DH convention (empty if the pose is out of the workspace)
+        in_limits: in_limits[i] is true if q_DH_solutions[i] is within the hard joint limits
+*/
+int LBRiiwa7::ikine_analytic(const Matrix<4, 4>& b_T_e, double arm_angle,
+                             // Return Vars
+                             vector<Vector<>>& q_DH_solutions, vector<bool>& in_limits) const
+{
+  checkIKineStructure();
+  const CompiledChain& chain = getCompiledChain();
+
+  const double d_se = chain.d[2];  // shoulder-elbow
+  const double d_ew = chain.d[4];  // elbow-wrist
+  const double d_wf = chain.d[6];  // wrist-flange
 
-/*=========END CONSTRUCTORS=========*/
\ No newline at end of file
+  q_DH_solutions.clear();
+  in_limits.clear();
+
+  // flange pose w.r.t. frame 0 (the shoulder is in the origin)
+  const RigidTransform T_07 = _b_T_0.inverse() * RigidTransform(b_T_e) * _n_T_e.inverse();
+
+  // shoulder-wrist vector
+  const Vector<3> x_sw = T_07.p - d_wf * T_07.z();
+  const double norm_sw = norm(x_sw);
+
+  // elbow
+  const double c4 = (norm_sw * norm_sw - d_se * d_se - d_ew * d_ew) / (2.0 * d_se * d_ew);
+  if (fabs(c4) > 1.0 || norm_sw < IKINE_SINGULAR_EPS)
+  {
+    return 0;
+  }
+
+  const Matrix<3, 3> R_psi = rotAxis(x_sw / norm_sw, arm_angle);
+
+  int num_in_limits = 0;
+  for (double gc4 : { 1.0, -1.0 })
+  {
+    const double q4 = gc4 * acos(c4);
+
+    // shoulder
+    const Matrix<3, 3> R_03 = R_psi * referenceShoulder(x_sw, q4, d_se, d_ew);
+    const Matrix<3, 3> R_04 = R_03 * rotZ(q4) * rotXPlusPi2();
+
+    for (double gc2 : { 1.0, -1.0 })
+    {
+      Vector<> q_DH = Zeros(7);
+      q_DH[3] = q4;
+
+      // R_03 = Rz(q1)*Ry(q2)*Rz(q3)*Rx(-pi/2)
+      eulerZYZ(R_03 * rotXPlusPi2(), gc2, q_DH[0], q_DH[1], q_DH[2]);
+
+      // R_47 = Rz(q5)*Ry(q6)*Rz(q7)
+      const Matrix<3, 3> R_47 = R_04.T() * T_07.R;
+
+      for (double gc6 : { 1.0, -1.0 })
+      {
+        eulerZYZ(R_47, gc6, q_DH[4], q_DH[5], q_DH[6]);
+
+        const bool ok = !exceededHardJointLimits(joints_DH2Robot(q_DH));
+        if (ok)
+        {
+          num_in_limits++;
+        }
+        q_DH_solutions.push_back(q_DH);
+        in_limits.push_back(ok);
+      }
+    }
+  }
+
+  return num_in_limits;
+}
+
+/*
+    Analytic inverse kinematics with the arm angle parametrization, solution nearest to the seed
+    Outputs:
+        return: false if no solution is within the hard joint limits (q_DH is not modified)
+        q_DH: the solution within the hard joint limits nearest to qDH_seed
+*/
+bool LBRiiwa7::ikine_analytic(const Matrix<4, 4>& b_T_e, double arm_angle, const Vector<>& qDH_seed,
+                              // Return Vars
+                              Vector<>& q_DH) const
+{
+  vector<Vector<>> q_DH_solutions;
+  vector<bool> in_limits;
+  if (ikine_analytic(b_T_e, arm_angle, q_DH_solutions, in_limits) == 0)
+  {
+    return false;
+  }
+
+  int best = -1;
+  double best_dist = 0.0;
+  for (size_t i = 0; i < q_DH_solutions.size(); i++)
+  {
+    if (!in_limits[i])
+    {
+      continue;
+    }
+    const double dist = norm_sq(q_DH_solutions[i] - qDH_seed);
+    if (best < 0 || dist < best_dist)
+    {
+      best = i;
+      best_dist = dist;
+    }
+  }
+
+  q_DH = q_DH_solutions[best];
+  return true;
+}
+
+/*
+    Arm angle of the configuration q_DH (see ikine_analytic)
+*/
+double LBRiiwa7::arm_angle(const Vector<>& q_DH) const
+{
+  checkIKineStructure();
+  const CompiledChain& chain = getCompiledChain();
+
+  const double d_se = chain.d[2];
+  const double d_ew = chain.d[4];
+
+  const Matrix<3, 3> R_03 = rotZ(q_DH[0]) * rotY(q_DH[1]) * rotZ(q_DH[2]) * rotXMinusPi2();
+
+  // shoulder-wrist vector in frame 0
+  const Vector<3> x_sw = R_03 * makeVector(d_ew * sin(q_DH[3]), -d_se - d_ew * cos(q_DH[3]), 0.0);
+  const double norm_sw = norm(x_sw);
+  if (norm_sw < IKINE_SINGULAR_EPS)
+  {
+    return 0.0;
+  }
+  const Vector<3> u = x_sw / norm_sw;
+
+  // R_psi = R_03 * R_03_ref^T is a rotation about u
+  const Matrix<3, 3> R_psi = R_03 * referenceShoulder(x_sw, q_DH[3], d_se, d_ew).T();
+  const double sin_psi =
+      0.5 * (u[0] * (R_psi(2, 1) - R_psi(1, 2)) + u[1] * (R_psi(0, 2) - R_psi(2, 0)) + u[2] * (R_psi(1, 0) - R_psi(0, 1)));
+  const double cos_psi = 0.5 * (R_psi(0, 0) + R_psi(1, 1) + R_psi(2, 2) - 1.0);
+
+  return atan2(sin_psi, cos_psi);
+}
+
+/*=========END INVERSE KINEMATICS=========*/
+
+}  // namespace sun
@@ -22,9 +22,11 @@
 */
 
 #include "sun_robot_lib/Robots/MotomanSIA5F.h"
+#include "IKineUtils.h"
 
 using namespace TooN;
 using namespace std;
+using namespace sun::ikine;
 
 namespace sun
 {
@@ -121,6 +123,23 @@ MotomanSIA5F::MotomanSIA5F(const Matrix<4, 4>& n_T_e, double dls_joint_speed_sat
       350.0 * M_PI / 180.0,
       // string name
       "T"));
+
+  // Nominal dynamic parameters in the DH frames: mass, center of mass, inertia w.r.t. the center of mass
+  // (rough estimate from the mass of the robot, identify them for an accurate model)
+  _links[0]->setDynamicParameters(5.0, makeVector(0.0, 0.1, 0.0),
+                                  Data(0.03, 0.0, 0.0, 0.0, 0.015, 0.0, 0.0, 0.0, 0.03));
+  _links[1]->setDynamicParameters(4.5, makeVector(0.0, 0.0, 0.12),
+                                  Data(0.025, 0.0, 0.0, 0.0, 0.025, 0.0, 0.0, 0.0, 0.01));
+  _links[2]->setDynamicParameters(3.5, makeVector(-0.04, -0.04, 0.0),
+                                  Data(0.012, 0.0, 0.0, 0.0, 0.008, 0.0, 0.0, 0.0, 0.012));
+  _links[3]->setDynamicParameters(3.0, makeVector(0.0, 0.0, 0.1),
+                                  Data(0.015, 0.0, 0.0, 0.0, 0.015, 0.0, 0.0, 0.0, 0.006));
+  _links[4]->setDynamicParameters(2.5, makeVector(0.0, 0.08, 0.0),
+                                  Data(0.008, 0.0, 0.0, 0.0, 0.004, 0.0, 0.0, 0.0, 0.008));
+  _links[5]->setDynamicParameters(1.5, makeVector(0.0, 0.0, 0.03),
+                                  Data(0.003, 0.0, 0.0, 0.0, 0.003, 0.0, 0.0, 0.0, 0.002));
+  _links[6]->setDynamicParameters(0.3, makeVector(0.0, 0.0, -0.02),
+                                  Data(0.0003, 0.0, 0.0, 0.0, 0.0003, 0.0, 0.0, 0.0, 0.0004));
 }
 
 /*
@@ -137,5 +156,250 @@ MotomanSIA5F::MotomanSIA5F() : MotomanSIA5F("SIA5F_NO_NAME")
 {
 }
 
+/*
+    Fixed-size engine: full constructor
+*/
+MotomanSIA5FFixed::MotomanSIA5FFixed(const Matrix<4, 4>& n_T_e, double dls_joint_speed_saturation)
+  : FixedRobot<7>(MotomanSIA5F(n_T_e, dls_joint_speed_saturation, "SIA5F_FIXED"))
+{
+}
+
+/*
+    Fixed-size engine: empty constructor
+*/
+MotomanSIA5FFixed::MotomanSIA5FFixed() : MotomanSIA5FFixed(Identity, 5.0)
+{
+}
+
+/*=========END CONSTRUCTORS=========*/
+
+/*=========INVERSE KINEMATICS=========*/
+
+/*
+    Check that the kinematic chain still has the structure required by the analytic inverse kinematics
+    (spherical shoulder and wrist with elbow offsets), print an error and exit otherwise
+*/
+void MotomanSIA5F::checkIKineStructure() const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  // sin(alpha) of the links, cos(alpha) is 0 except for the last link
+  const double sin_alpha[7] = { -1.0, 1.0, 1.0, 1.0, -1.0, 1.0, 0.0 };
+
+  bool ok = (chain.num_joints == 7) && (chain.prismatic_mask == 0);
+  for (int i = 0; ok && i < 7; i++)
+  {
+    ok = (fabs(chain.sin_alpha[i] - sin_alpha[i]) < IKINE_SINGULAR_EPS) &&
+         (fabs(chain.cos_alpha[i] - ((i == 6) ? 1.0 : 0.0)) < IKINE_SINGULAR_EPS);
+  }
+  ok = ok && (chain.a[0] == 0.0) && (chain.a[1] == 0.0) && (chain.a[4] == 0.0) && (chain.a[5] == 0.0) &&
+       (chain.a[6] == 0.0);
+  ok = ok && (chain.d[0] == 0.0) && (chain.d[1] == 0.0) && (chain.d[3] == 0.0) && (chain.d[5] == 0.0);
+
+  if (!ok)
+  {
+    cout << ROBOT_ERROR_COLOR "[MotomanSIA5F] Error in checkIKineStructure(): the kinematic chain has been modified, "
+                              "the analytic inverse kinematics cannot be used" ROBOT_CRESET
+         << endl;
+    exit(-1);
+  }
+}
+
+/*
+    Analytic inverse kinematics for a given q3, the structure is not checked (see checkIKineStructure)
+    Outputs:
+        return: number of solutions within the hard joint limits
+        q_DH_solutions: the first num_solutions elements are the branch solutions in DH convention
+        in_limits: in_limits[i] is true if q_DH_solutions[i] is within the hard joint limits
+        num_solutions: number of branch solutions
+    This function does not allocate memory
+*/
+int MotomanSIA5F::ikine_analytic_internal(const RigidTransform& T_07, double q3_DH,
+                                          // Return Vars
+                                          Vector<7> (&q_DH_solutions)[MOTOMANSIA5F_IK_MAX_SOLUTIONS],
+                                          bool (&in_limits)[MOTOMANSIA5F_IK_MAX_SOLUTIONS], int& num_solutions) const
+{
+  const CompiledChain& chain = getCompiledChain();
+
+  const double d3 = chain.d[2];
+  const double a3 = chain.a[2];
+  const double a4 = chain.a[3];
+  const double d5 = chain.d[4];
+  const double d7 = chain.d[6];
+
+  num_solutions = 0;
+
+  // wrist position
+  const Vector<3> p_w = T_07.p - d7 * T_07.z();
+
+  // elbow: |p_w|^2 = K + B*cos(q4) + C*sin(q4)
+  const double K = a3 * a3 + d3 * d3 + a4 * a4 + d5 * d5;
+  const double B = 2.0 * (a3 * a4 - d3 * d5);
+  const double C = 2.0 * (a3 * d5 + d3 * a4);
+  const double c_q4_phi = (norm_sq(p_w) - K) / sqrt(B * B + C * C);
+  if (fabs(c_q4_phi) > 1.0)
+  {
+    return 0;
+  }
+  const double phi = atan2(C, B);
+
+  const double s3 = sin(q3_DH);
+  const double c3 = cos(q3_DH);
+
+  int num_in_limits = 0;
+  for (double gc4 : { 1.0, -1.0 })
+  {
+    const double q4 = phi + gc4 * acos(c_q4_phi);
+    const double s4 = sin(q4);
+    const double c4 = cos(q4);
+
+    // wrist position in frame 3: T_34(q4)*[0 0 d5 1]^T = [v_x v_y 0]^T
+    const double v_x = a4 * c4 + d5 * s4;
+    const double v_y = a4 * s4 - d5 * c4;
+    // wrist position in frame 2, R_23 = Rz(q3)*Rx(pi/2)
+    const Vector<3> p_2 = makeVector(c3 * (v_x + a3), s3 * (v_x + a3), v_y + d3);
+
+    // shoulder: Rz(q1)*Ry(q2)*p_2 = p_w
+    const double rho = sqrt(p_2[0] * p_2[0] + p_2[2] * p_2[2]);
+    if (rho < IKINE_SINGULAR_EPS || fabs(p_w[2]) > rho)
+    {
+      continue;
+    }
+    const double beta = atan2(p_2[0], p_2[2]);
+
+    for (double gc2 : { 1.0, -1.0 })
+    {
+      Vector<7> q_DH = Zeros;
+      q_DH[1] = gc2 * acos(p_w[2] / rho) - beta;
+      q_DH[2] = q3_DH;
+      q_DH[3] = q4;
+
+      const double u = p_2[0] * cos(q_DH[1]) + p_2[2] * sin(q_DH[1]);
+      q_DH[0] = atan2(p_w[1], p_w[0]) - atan2(p_2[1], u);
+
+      // wrist orientation: R_47 = Rz(q5)*Ry(q6)*Rz(q7)
+      const Matrix<3, 3> R_04 = rotZ(q_DH[0]) * rotY(q_DH[1]) * rotZ(q3_DH) * rotXPlusPi2() * rotZ(q4) * rotXPlusPi2();
+      const Matrix<3, 3> R_47 = R_04.T() * T_07.R;
+
+      for (double gc6 : { 1.0, -1.0 })
+      {
+        eulerZYZ(R_47, gc6, q_DH[4], q_DH[5], q_DH[6]);
+
+        wrapToHardLimits(chain, q_DH);
+
+        const bool ok = withinHardLimits(chain, q_DH);
+        if (ok)
+        {
+          num_in_limits++;
+        }
+        q_DH_solutions[num_solutions] = q_DH;
+        in_limits[num_solutions] = ok;
+        num_solutions++;
+      }
+    }
+  }
+
+  return num_in_limits;
+}
+
+/*
+    Analytic inverse kinematics for a given value of the redundancy parameter q3
+    Outputs:
+        return: number of solutions within the hard joint limits
+        q_DH_solutions: the branch solutions in DH convention (up to 8, empty if the pose is not reachable
+                        with this q3)
+        in_limits: in_limits[i] is true if q_DH_solutions[i] is within the hard joint limits
+*/
+int MotomanSIA5F::ikine_analytic(const Matrix<4, 4>& b_T_e, double q3_DH,
+                                 // Return Vars
+                                 vector<Vector<>>& q_DH_solutions, vector<bool>& in_limits) const
+{
+  checkIKineStructure();
+
+  // flange pose w.r.t. frame 0 (the shoulder is in the origin)
+  const RigidTransform T_07 = _b_T_0.inverse() * RigidTransform(b_T_e) * _n_T_e.inverse();
+
+  Vector<7> solutions[MOTOMANSIA5F_IK_MAX_SOLUTIONS];
+  bool solutions_in_limits[MOTOMANSIA5F_IK_MAX_SOLUTIONS];
+  int num_solutions = 0;
+  const int num_in_limits = ikine_analytic_internal(T_07, q3_DH, solutions, solutions_in_limits, num_solutions);
+
+  q_DH_solutions.clear();
+  in_limits.clear();
+  for (int i = 0; i < num_solutions; i++)
+  {
+    q_DH_solutions.push_back(Vector<>(solutions[i]));
+    in_limits.push_back(solutions_in_limits[i]);
+  }
+
+  return num_in_limits;
+}
+
+/*
+    Semi-analytic inverse kinematics (1-D search over q3), solution nearest to the seed
+    The structure is checked once, the solutions are stored in fixed-size arrays
+    Outputs:
+        return: false if no solution is within the hard joint limits (q_DH is not modified)
+        q_DH: the solution within the hard joint limits nearest to qDH_seed
+*/
+bool MotomanSIA5F::ikine_analytic(const Matrix<4, 4>& b_T_e, const Vector<>& qDH_seed,
+                                  // Return Vars
+                                  Vector<>& q_DH, int num_samples) const
+{
+  checkIKineStructure();
+
+  const CompiledChain& chain = getCompiledChain();
+  const double q3_lower = chain.joint_Robot2DH(2, chain.hard_limit_lower[2]);
+  const double q3_higher = chain.joint_Robot2DH(2, chain.hard_limit_higher[2]);
+
+  // flange pose w.r.t. frame 0 (the shoulder is in the origin), it does not depend on q3
+  const RigidTransform T_07 = _b_T_0.inverse() * RigidTransform(b_T_e) * _n_T_e.inverse();
+
+  Vector<7> solutions[MOTOMANSIA5F_IK_MAX_SOLUTIONS];
+  bool in_limits[MOTOMANSIA5F_IK_MAX_SOLUTIONS];
+  int num_solutions = 0;
+
+  bool found = false;
+  double best_dist = 0.0;
+  Vector<7> best = Zeros;
+  for (int k = -1; k < num_samples; k++)
+  {
+    // k = -1 is the seed q3
+    const double q3 = (k < 0) ? qDH_seed[2] : q3_lower + (k + 0.5) * (q3_higher - q3_lower) / num_samples;
+
+    if (ikine_analytic_internal(T_07, q3, solutions, in_limits, num_solutions) == 0)
+    {
+      continue;
+    }
+
+    for (int i = 0; i < num_solutions; i++)
+    {
+      if (!in_limits[i])
+      {
+        continue;
+      }
+      double dist = 0.0;
+      for (int j = 0; j < 7; j++)
+      {
+        dist += (solutions[i][j] - qDH_seed[j]) * (solutions[i][j] - qDH_seed[j]);
+      }
+      if (!found || dist < best_dist)
+      {
+        found = true;
+        best_dist = dist;
+        best = solutions[i];
+      }
+    }
+  }
+
+  if (found)
+  {
+    q_DH = best;
+  }
+
+  return found;
+}
+
+/*=========END INVERSE KINEMATICS=========*/
+
 }  // namespace sun
-   /*=========END CONSTRUCTORS=========*/
\ No newline at end of file
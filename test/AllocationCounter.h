@@ -0,0 +1,89 @@
+/*
+
+    Allocation counter of the tests
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+    Replacement of the global operator new that counts the allocations of the test executables
+    Include this header in exactly one translation unit of each test executable
+*/
+
+#ifndef SUN_ROBOT_LIB_TEST_ALLOCATIONCOUNTER_H
+#define SUN_ROBOT_LIB_TEST_ALLOCATIONCOUNTER_H
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// operator delete is kept out of line: inlined in a new-expression, free() would look mismatched to the compiler
+#ifdef __GNUC__
+#define TEST_NOINLINE __attribute__((noinline))
+#else
+#define TEST_NOINLINE
+#endif
+
+namespace sun
+{
+namespace test
+{
+//! Number of calls of the global operator new
+inline std::atomic<long>& allocationCounter()
+{
+  static std::atomic<long> counter(0);
+  return counter;
+}
+
+//! Number of allocations since the start of the program
+inline long allocationCount()
+{
+  return allocationCounter().load(std::memory_order_relaxed);
+}
+
+}  // namespace test
+}  // namespace sun
+
+void* operator new(std::size_t size)
+{
+  sun::test::allocationCounter().fetch_add(1, std::memory_order_relaxed);
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+TEST_NOINLINE void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+TEST_NOINLINE void operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+
+#endif
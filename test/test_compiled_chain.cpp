@@ -0,0 +1,248 @@
+/*
+
+    Test: the DH compose routines of CompiledChain specialized on the DH pattern of the links
+    give the same result of the general routine
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+    A chain with one link for each DH pattern (alpha in {0, +pi/2, -pi/2, general} x a zero/nonzero
+    x d (theta for prismatic links) zero/nonzero x revolute/prismatic) is built with and without specialization.
+    For each link and joint value, postMultA of the two chains is compared with T*A(i,q).
+    Then fkine and jacob_geometric of the robots are compared with and without specialization.
+    Finally a link is modified through a stored reference (Robot::getLink): the modification must be detected
+    by the next kinematic call and reported by the real-time functions.
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "sun_robot_lib/CompiledChain.h"
+#include "sun_robot_lib/RobotLinkPrismatic.h"
+#include "sun_robot_lib/RobotLinkRevolute.h"
+#include "sun_robot_lib/Robots/LBRiiwa7.h"
+#include "sun_robot_lib/Robots/MotomanSIA5F.h"
+
+//! Tolerance of the comparisons
+#define TEST_TOLERANCE 1.0E-12
+
+using namespace TooN;
+using namespace std;
+using namespace sun;
+
+namespace
+{
+/*
+    Max absolute difference of the elements of two matrices
+*/
+template <int R, int C>
+double maxAbsDiff(const Matrix<R, C>& M1, const Matrix<R, C>& M2)
+{
+  double max_diff = 0.0;
+  for (int i = 0; i < M1.num_rows(); i++)
+  {
+    for (int j = 0; j < M1.num_cols(); j++)
+    {
+      max_diff = max(max_diff, fabs(M1(i, j) - M2(i, j)));
+    }
+  }
+  return max_diff;
+}
+
+/*
+    Print the result of a check, return 1 on failure
+*/
+int report(const string& name, double max_diff)
+{
+  const bool ok = max_diff <= TEST_TOLERANCE;
+  cout << (ok ? "[ OK ] " : "[FAIL] ") << name << ": max diff " << max_diff << endl;
+  return ok ? 0 : 1;
+}
+
+/*
+    Check postMultA of the specialized and general routines on all the DH patterns, return the number of failures
+*/
+int testDHPatterns()
+{
+  const double alphas[4] = { 0.0, M_PI / 2.0, -M_PI / 2.0, 0.7 };
+  const string alpha_names[4] = { "0", "+pi/2", "-pi/2", "general" };
+  const double q_values[4] = { 0.0, 0.4, -1.3, 2.9 };
+
+  vector<RobotLinkPtr> links;
+  vector<string> names;
+  for (int prismatic = 0; prismatic < 2; prismatic++)
+  {
+    for (int k = 0; k < 4; k++)
+    {
+      for (int has_a = 0; has_a < 2; has_a++)
+      {
+        for (int has_d = 0; has_d < 2; has_d++)
+        {
+          const double a = has_a ? 0.3 : 0.0;
+          const double d_theta = has_d ? 0.2 : 0.0;
+          if (prismatic)
+          {
+            links.push_back(RobotLinkPtr(new RobotLinkPrismatic(a, alphas[k], d_theta)));
+          }
+          else
+          {
+            links.push_back(RobotLinkPtr(new RobotLinkRevolute(a, alphas[k], d_theta)));
+          }
+          names.push_back(string(prismatic ? "prismatic" : "revolute") + " alpha=" + alpha_names[k] +
+                          (has_a ? " a!=0" : " a=0") + (prismatic ? (has_d ? " theta!=0" : " theta=0") :
+                                                                    (has_d ? " d!=0" : " d=0")));
+        }
+      }
+    }
+  }
+
+  CompiledChain specialized, general;
+  specialized.build(links, true);
+  general.build(links, false);
+
+  // a generic starting transform, so that all the rows are involved
+  const RigidTransform T0(rotx(0.3) * roty(-0.5) * rotz(1.1), makeVector(0.1, -0.2, 0.3));
+
+  int failures = 0;
+  int num_specialized = 0;
+  for (int i = 0; i < specialized.num_joints; i++)
+  {
+    if (specialized.dh_kernel[i] != general.dh_kernel[i])
+    {
+      num_specialized++;
+    }
+    double max_diff_general = 0.0;
+    double max_diff_specialized = 0.0;
+    for (double q : q_values)
+    {
+      const Matrix<4, 4> T_ref = T0.toMatrix() * specialized.A(i, q);
+      RigidTransform T_specialized = T0;
+      specialized.postMultA(i, q, T_specialized);
+      RigidTransform T_general = T0;
+      general.postMultA(i, q, T_general);
+      max_diff_specialized = max(max_diff_specialized, maxAbsDiff(T_specialized.toMatrix(), T_ref));
+      max_diff_general = max(max_diff_general, maxAbsDiff(T_general.toMatrix(), T_ref));
+    }
+    failures += report("postMultA general     " + names[i], max_diff_general);
+    failures += report("postMultA specialized " + names[i], max_diff_specialized);
+  }
+
+  // the test is meaningless if the specialization is not selected
+  if (num_specialized == 0)
+  {
+    cout << "[FAIL] no specialized routine was selected" << endl;
+    failures++;
+  }
+
+  return failures;
+}
+
+/*
+    Check fkine and jacob_geometric of robot with and without specialization, return the number of failures
+*/
+int testRobot(Robot& robot)
+{
+  const string robot_name = robot.getName();
+  const int numQ = robot.getNumJoints();
+
+  Vector<> q_DH = Zeros(numQ);
+  for (int i = 0; i < numQ; i++)
+  {
+    q_DH[i] = 0.3 * (i + 1) - 1.0;
+  }
+
+  robot.setDHKernelSpecialization(true);
+  const Matrix<4, 4> T_specialized = robot.fkine(q_DH);
+  const Matrix<6, Dynamic> J_specialized = robot.jacob_geometric(q_DH);
+
+  robot.setDHKernelSpecialization(false);
+  const Matrix<4, 4> T_general = robot.fkine(q_DH);
+  const Matrix<6, Dynamic> J_general = robot.jacob_geometric(q_DH);
+
+  robot.setDHKernelSpecialization(true);
+
+  int failures = 0;
+  failures += report(robot_name + "/fkine", maxAbsDiff(T_specialized, T_general));
+  failures += report(robot_name + "/jacob_geometric", maxAbsDiff(J_specialized, J_general));
+  return failures;
+}
+
+/*
+    Modify a link through a stored reference, return the number of failures
+*/
+int testLinkEdit(Robot& robot)
+{
+  const string robot_name = robot.getName();
+  const int numQ = robot.getNumJoints();
+
+  Vector<> q_DH = Zeros(numQ);
+  for (int i = 0; i < numQ; i++)
+  {
+    q_DH[i] = 0.3 * (i + 1) - 1.0;
+  }
+  KinematicsWorkspace ws(numQ);
+
+  RobotLinkPtr& link = robot.getLink(2);
+  const Matrix<4, 4> T_before = robot.fkine(q_DH);
+
+  link->setDH_a(link->getDH_a() + 0.1);
+
+  int failures = 0;
+
+  // the real-time functions never compile the chain
+  const RobotRTStatus status = robot.fkine_rt(q_DH, ws);
+  cout << (status == ROBOT_RT_CHAIN_NOT_COMPILED ? "[ OK ] " : "[FAIL] ") << robot_name
+       << "/fkine_rt after link edit: " << robotRTStatusToString(status) << endl;
+  failures += status == ROBOT_RT_CHAIN_NOT_COMPILED ? 0 : 1;
+
+  const Matrix<4, 4> T_edit = robot.fkine(q_DH);
+  robot.compile();
+  const Matrix<4, 4> T_compiled = robot.fkine(q_DH);
+
+  failures += report(robot_name + "/fkine after link edit vs compile()", maxAbsDiff(T_edit, T_compiled));
+
+  const bool changed = maxAbsDiff(T_before, T_edit) > 1.0E-3;
+  cout << (changed ? "[ OK ] " : "[FAIL] ") << robot_name << "/fkine changed by the link edit" << endl;
+  failures += changed ? 0 : 1;
+
+  return failures;
+}
+
+}  // namespace
+
+int main()
+{
+  LBRiiwa7 iiwa("LBRiiwa7");
+  MotomanSIA5F sia5f("MotomanSIA5F");
+
+  int failures = 0;
+  failures += testDHPatterns();
+  failures += testRobot(iiwa);
+  failures += testRobot(sia5f);
+  failures += testLinkEdit(iiwa);
+
+  if (failures != 0)
+  {
+    cout << failures << " checks failed" << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
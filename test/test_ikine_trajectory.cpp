@@ -0,0 +1,172 @@
+/*
+
+    Test: the parallel ikine_trajectory gives the same solution of the sequential one
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+    The path is the fkine of a joint trajectory with motions of all the joints.
+    It is solved with num_threads = 1 and num_threads = TEST_THREADS, the joint positions, the velocities,
+    the errors and the number of failed samples are compared.
+    The second path has a stretch of unreachable poses inside a segment: the failed samples force the stitching
+    to solve the segment again.
+    The comparison is exact: a segment is kept only if it is on the branch of the sequential solution, on these
+    redundant robots the seeds of the coarse pass are on a different point of the self-motion and the segments
+    are solved again.
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "sun_robot_lib/Robots/LBRiiwa7.h"
+#include "sun_robot_lib/Robots/MotomanSIA5F.h"
+
+//! Number of samples of the path (at least IKTRAJ_MIN_SAMPLES_PER_THREAD for each thread)
+#define TEST_SAMPLES 2048
+
+//! Number of threads of the parallel solve
+#define TEST_THREADS 4
+
+//! Sampling time of the path
+#define TEST_TS 0.002
+
+//! Tolerance of the comparisons
+#define TEST_TOLERANCE 1.0E-12
+
+using namespace TooN;
+using namespace std;
+using namespace sun;
+
+namespace
+{
+/*
+    Max absolute difference of the elements of two arrays
+*/
+double maxAbsDiff(const vector<double>& v1, const vector<double>& v2)
+{
+  double max_diff = 0.0;
+  for (size_t i = 0; i < v1.size(); i++)
+  {
+    max_diff = max(max_diff, fabs(v1[i] - v2[i]));
+  }
+  return max_diff;
+}
+
+/*
+    Print the result of a check, return 1 on failure
+*/
+int report(bool ok, const string& name, const string& message)
+{
+  cout << (ok ? "[ OK ] " : "[FAIL] ") << name << ": " << message << endl;
+  return ok ? 0 : 1;
+}
+
+/*
+    Solve the path sequentially and in parallel and compare the results, return the number of failures
+*/
+int comparePath(const Robot& robot, const string& name, const vector<Matrix<4, 4>>& b_T_e, const Vector<>& qDH_seed)
+{
+  const int numQ = robot.getNumJoints();
+  const int num_samples = b_T_e.size();
+
+  vector<double> q_seq(num_samples * numQ), qdot_seq(num_samples * numQ), error_seq(2 * num_samples);
+  vector<double> q_par(num_samples * numQ), qdot_par(num_samples * numQ), error_par(2 * num_samples);
+
+  const int failed_seq =
+      robot.ikine_trajectory(b_T_e, TEST_TS, qDH_seed, q_seq.data(), qdot_seq.data(), error_seq.data());
+  const int failed_par = robot.ikine_trajectory(b_T_e, TEST_TS, qDH_seed, q_par.data(), qdot_par.data(),
+                                                error_par.data(), IKineOptions(), TEST_THREADS);
+
+  int failures = 0;
+  failures += report(failed_seq == failed_par, name,
+                     "failed samples " + to_string(failed_seq) + " sequential, " + to_string(failed_par) + " parallel");
+  const double diff_q = maxAbsDiff(q_seq, q_par);
+  failures += report(diff_q <= TEST_TOLERANCE, name, "joint positions max diff " + to_string(diff_q));
+  const double diff_qdot = maxAbsDiff(qdot_seq, qdot_par);
+  failures += report(diff_qdot <= TEST_TOLERANCE / TEST_TS, name, "joint velocities max diff " + to_string(diff_qdot));
+  const double diff_error = maxAbsDiff(error_seq, error_par);
+  failures += report(diff_error <= TEST_TOLERANCE, name, "errors max diff " + to_string(diff_error));
+  return failures;
+}
+
+/*
+    Check the parallel solve of robot on a reachable path and on a path with unreachable poses,
+    return the number of failures
+*/
+int testRobot(Robot& robot)
+{
+  const string robot_name = robot.getName();
+  const int numQ = robot.getNumJoints();
+
+  // joint trajectory within the soft limits, all the joints oscillate around 30% of their range
+  // (away from the stretched singular configurations)
+  vector<Matrix<4, 4>> b_T_e(TEST_SAMPLES);
+  Vector<> q_R = Zeros(numQ);
+  Vector<> qDH_seed = Zeros(numQ);
+  for (int k = 0; k < TEST_SAMPLES; k++)
+  {
+    const double t = k * TEST_TS;
+    for (int i = 0; i < numQ; i++)
+    {
+      const Vector<2> limits = robot.getLink(i)->getSoftJointLimits();
+      q_R[i] = limits[0] + (0.3 + 0.1 * sin(0.3 * (i + 1) * t + 0.3 * i)) * (limits[1] - limits[0]);
+    }
+    const Vector<> q_DH = robot.joints_Robot2DH(q_R);
+    if (k == 0)
+    {
+      qDH_seed = q_DH;
+    }
+    b_T_e[k] = robot.fkine(q_DH);
+  }
+
+  int failures = 0;
+  failures += comparePath(robot, robot_name + "/reachable", b_T_e, qDH_seed);
+
+  // unreachable stretch in the middle of the third segment
+  const int unreachable_begin = (TEST_SAMPLES * 5) / (2 * TEST_THREADS);
+  for (int k = unreachable_begin; k < unreachable_begin + 20; k++)
+  {
+    b_T_e[k](0, 3) += 5.0;
+  }
+  failures += comparePath(robot, robot_name + "/unreachable", b_T_e, qDH_seed);
+
+  return failures;
+}
+
+}  // namespace
+
+int main()
+{
+  LBRiiwa7 iiwa("LBRiiwa7");
+  MotomanSIA5F sia5f("MotomanSIA5F");
+
+  int failures = 0;
+  failures += testRobot(iiwa);
+  failures += testRobot(sia5f);
+
+  if (failures != 0)
+  {
+    cout << failures << " checks failed" << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
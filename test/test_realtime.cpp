@@ -0,0 +1,298 @@
+/*
+
+    Test: the real-time safe functions (fkine_rt, jacob_geometric_rt, clik_rt) do not allocate memory
+    and do not make syscalls, their per-cycle latency is reported
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+    After compile(), each real-time function is checked for:
+        - allocations: the global operator new is replaced by a counter (AllocationCounter.h),
+          the test fails if the counter moves during TEST_CYCLES cycles;
+        - syscalls (Linux only): the cycles are run in a child process in seccomp strict mode, where only
+          read, write, _exit and sigreturn are allowed, the test fails if the child is killed;
+        - latency: each cycle is timed alone, p50/p99/max of TEST_TIMING_CYCLES cycles are printed
+          (not checked, the timing depends on the machine).
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "AllocationCounter.h"
+#include "sun_robot_lib/Robots/LBRiiwa7.h"
+#include "sun_robot_lib/Robots/MotomanSIA5F.h"
+
+#ifdef __linux__
+#include <linux/seccomp.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+//! Number of warm-up cycles
+#define TEST_WARMUP_CYCLES 10
+
+//! Number of cycles of the allocation and syscall checks
+#define TEST_CYCLES 1000
+
+//! Number of timed cycles
+#define TEST_TIMING_CYCLES 10000
+
+//! Exit code of the child process if seccomp is not available
+#define TEST_SECCOMP_UNAVAILABLE 77
+
+using namespace TooN;
+using namespace std;
+using namespace sun;
+
+namespace
+{
+//! A real-time function under test, op(k) runs the k-th cycle
+struct RTCase
+{
+  string name;
+  function<RobotRTStatus(int)> op;
+};
+
+/*
+    Print the result of a check, return 1 on failure
+*/
+int report(bool ok, const string& robot_name, const string& name, const string& message)
+{
+  cout << (ok ? "[ OK ] " : "[FAIL] ") << robot_name << "/" << name << ": " << message << endl;
+  return ok ? 0 : 1;
+}
+
+/*
+    Check that the case does not allocate memory and always returns ROBOT_RT_OK, return the number of failures
+*/
+int checkAllocations(const string& robot_name, const RTCase& rt_case)
+{
+  for (int k = 0; k < TEST_WARMUP_CYCLES; k++)
+  {
+    rt_case.op(k);
+  }
+  int num_not_ok = 0;
+  const long start = test::allocationCount();
+  for (int k = 0; k < TEST_CYCLES; k++)
+  {
+    if (rt_case.op(k) != ROBOT_RT_OK)
+    {
+      num_not_ok++;
+    }
+  }
+  const long allocations = test::allocationCount() - start;
+
+  int failures = 0;
+  failures += report(allocations == 0, robot_name, rt_case.name,
+                     to_string(allocations) + " allocations in " + to_string(TEST_CYCLES) + " cycles");
+  failures += report(num_not_ok == 0, robot_name, rt_case.name,
+                     to_string(num_not_ok) + " cycles not ROBOT_RT_OK in " + to_string(TEST_CYCLES) + " cycles");
+  return failures;
+}
+
+/*
+    Check that the case does not make syscalls, return the number of failures
+    The cycles are run in a child process in seccomp strict mode: any syscall other than
+    read, write, _exit and sigreturn kills the child with SIGKILL
+*/
+int checkSyscalls(const string& robot_name, const RTCase& rt_case)
+{
+#ifdef __linux__
+  // nothing must be left in the buffers copied to the child
+  cout.flush();
+  fflush(stdout);
+
+  const pid_t pid = fork();
+  if (pid < 0)
+  {
+    cout << "[SKIP] " << robot_name << "/" << rt_case.name << ": fork() failed, syscall check skipped" << endl;
+    return 0;
+  }
+  if (pid == 0)
+  {
+    // the memory of the child is a copy of the warm parent, the cycles start without first-call effects
+    if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_STRICT) != 0)
+    {
+      _exit(TEST_SECCOMP_UNAVAILABLE);
+    }
+    for (int k = 0; k < TEST_CYCLES; k++)
+    {
+      rt_case.op(k);
+    }
+    // exit_group (used by _exit) is not allowed in strict mode
+    syscall(SYS_exit, 0);
+  }
+
+  int status = 0;
+  if (waitpid(pid, &status, 0) != pid)
+  {
+    cout << "[SKIP] " << robot_name << "/" << rt_case.name << ": waitpid() failed, syscall check skipped" << endl;
+    return 0;
+  }
+  if (WIFEXITED(status) && WEXITSTATUS(status) == TEST_SECCOMP_UNAVAILABLE)
+  {
+    cout << "[SKIP] " << robot_name << "/" << rt_case.name << ": seccomp not available, syscall check skipped"
+         << endl;
+    return 0;
+  }
+  if (WIFSIGNALED(status))
+  {
+    return report(false, robot_name, rt_case.name,
+                  string("killed by signal ") + to_string(WTERMSIG(status)) +
+                      (WTERMSIG(status) == SIGKILL ? " (syscall in the real-time cycle)" : ""));
+  }
+  return report(WIFEXITED(status) && WEXITSTATUS(status) == 0, robot_name, rt_case.name,
+                "no syscalls in " + to_string(TEST_CYCLES) + " cycles");
+#else
+  cout << "[SKIP] " << robot_name << "/" << rt_case.name << ": syscall check available on Linux only" << endl;
+  return 0;
+#endif
+}
+
+/*
+    Time each cycle alone and print p50/p99/max
+*/
+void reportLatency(const string& robot_name, const RTCase& rt_case)
+{
+  vector<double> cycle_ns(TEST_TIMING_CYCLES);
+  for (int k = 0; k < TEST_WARMUP_CYCLES; k++)
+  {
+    rt_case.op(k);
+  }
+  for (int k = 0; k < TEST_TIMING_CYCLES; k++)
+  {
+    const auto t0 = chrono::steady_clock::now();
+    rt_case.op(k);
+    cycle_ns[k] = chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count();
+  }
+  sort(cycle_ns.begin(), cycle_ns.end());
+
+  char line[256];
+  snprintf(line, sizeof(line), "[TIME] %s/%s: p50 %.0f ns, p99 %.0f ns, max %.0f ns (%d cycles)", robot_name.c_str(),
+           rt_case.name.c_str(), cycle_ns[TEST_TIMING_CYCLES / 2], cycle_ns[(TEST_TIMING_CYCLES * 99) / 100],
+           cycle_ns.back(), TEST_TIMING_CYCLES);
+  cout << line << endl;
+}
+
+/*
+    Check all the real-time functions on robot, return the number of failures
+*/
+int testRobot(Robot& robot)
+{
+  robot.compile();
+
+  const string robot_name = robot.getName();
+  const int numQ = robot.getNumJoints();
+
+  KinematicsWorkspace ws(numQ);
+  Vector<> q_DH = Zeros(numQ);
+  Vector<> q0_p = Zeros(numQ);
+  Vector<> qpDH = Zeros(numQ);
+  Vector<6> error;
+  UnitQuaternion Q;
+  const Vector<3> pd = makeVector(0.4, 0.1, 0.5);
+  const UnitQuaternion Qd(Matrix<3, 3>(rotx(0.3) * roty(0.2)));
+  const Vector<3> dpd = makeVector(0.01, 0.0, 0.0);
+  const Vector<3> omegad = makeVector(0.0, 0.02, 0.0);
+  const Vector<6, int> mask_full = Ones;
+  Vector<6, int> mask_position = Zeros;
+  mask_position[0] = mask_position[1] = mask_position[2] = 1;
+
+  // the joints change at each cycle
+  auto setJoints = [&](int k) {
+    for (int i = 0; i < numQ; i++)
+    {
+      q_DH[i] = 0.1 * (i + 1) + 0.001 * (k % 100);
+    }
+  };
+
+  vector<RTCase> cases;
+  cases.push_back({ "fkine_rt", [&](int k) {
+                     setJoints(k);
+                     return robot.fkine_rt(q_DH, ws);
+                   } });
+  cases.push_back({ "jacob_geometric_rt", [&](int k) {
+                     setJoints(k);
+                     return robot.jacob_geometric_rt(q_DH, ws);
+                   } });
+  cases.push_back({ "clik_rt", [&](int k) {
+                     setJoints(k);
+                     return robot.clik_rt(q_DH, pd, Qd, Q, dpd, omegad, mask_full, 50.0, 0.001, 1.0, q0_p, ws,
+                                          qpDH, error, Q);
+                   } });
+  cases.push_back({ "clik_rt_position_only", [&](int k) {
+                     setJoints(k);
+                     return robot.clik_rt(q_DH, pd, Qd, Q, dpd, omegad, mask_position, 50.0, 0.001, 1.0, q0_p, ws,
+                                          qpDH, error, Q);
+                   } });
+
+  const CLIKSolver solvers[2] = { CLIK_SOLVER_PINV, CLIK_SOLVER_CHOLESKY };
+  const string solver_names[2] = { "pinv", "cholesky" };
+
+  int failures = 0;
+  for (int s = 0; s < 2; s++)
+  {
+    robot.setCLIKSolver(solvers[s]);
+    for (RTCase rt_case : cases)
+    {
+      // the solver is used by clik only
+      if (rt_case.name.compare(0, 4, "clik") == 0)
+      {
+        rt_case.name += "_" + solver_names[s];
+      }
+      else if (s != 0)
+      {
+        continue;
+      }
+      failures += checkAllocations(robot_name, rt_case);
+      failures += checkSyscalls(robot_name, rt_case);
+      reportLatency(robot_name, rt_case);
+    }
+  }
+
+  return failures;
+}
+
+}  // namespace
+
+int main()
+{
+  LBRiiwa7 iiwa("LBRiiwa7");
+  MotomanSIA5F sia5f("MotomanSIA5F");
+
+  int failures = 0;
+  failures += testRobot(iiwa);
+  failures += testRobot(sia5f);
+
+  if (failures != 0)
+  {
+    cout << failures << " checks failed" << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
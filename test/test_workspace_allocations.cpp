@@ -0,0 +1,157 @@
+/*
+
+    Test: the workspace versions of fkine_all, jacob_geometric and clik do not allocate memory
+
+    Copyright 2018-2020 Università della Campania Luigi Vanvitelli
+
+    Author: Marco Costanzo <marco.costanzo@unicampania.it>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+    The global operator new is replaced by a counter (AllocationCounter.h).
+    After a warm-up, TEST_CYCLES cycles of each workspace function are run and the test fails
+    if the counter moves.
+*/
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "AllocationCounter.h"
+#include "sun_robot_lib/Robots/LBRiiwa7.h"
+#include "sun_robot_lib/Robots/MotomanSIA5F.h"
+
+//! Number of warm-up cycles
+#define TEST_WARMUP_CYCLES 10
+
+//! Number of checked cycles
+#define TEST_CYCLES 1000
+
+using namespace TooN;
+using namespace std;
+using namespace sun;
+
+namespace
+{
+/*
+    Run op for TEST_WARMUP_CYCLES + TEST_CYCLES cycles, return the number of allocations
+    of the last TEST_CYCLES cycles (op receives the cycle index)
+*/
+template <class Op>
+long countAllocations(const Op& op)
+{
+  for (int k = 0; k < TEST_WARMUP_CYCLES; k++)
+  {
+    op(k);
+  }
+  const long start = test::allocationCount();
+  for (int k = 0; k < TEST_CYCLES; k++)
+  {
+    op(k);
+  }
+  return test::allocationCount() - start;
+}
+
+/*
+    Print the result of a check, return 1 on failure
+*/
+int report(const string& robot_name, const string& name, long allocations)
+{
+  cout << (allocations == 0 ? "[ OK ] " : "[FAIL] ") << robot_name << "/" << name << ": " << allocations
+       << " allocations in " << TEST_CYCLES << " cycles" << endl;
+  return allocations == 0 ? 0 : 1;
+}
+
+/*
+    Check all the workspace functions on robot, return the number of failures
+*/
+int testRobot(Robot& robot)
+{
+  const string robot_name = robot.getName();
+  const int numQ = robot.getNumJoints();
+
+  KinematicsWorkspace ws(numQ);
+  Vector<> q_DH = Zeros(numQ);
+  Vector<> q0_p = Zeros(numQ);
+  Vector<> qpDH = Zeros(numQ);
+  Vector<6> error;
+  UnitQuaternion Q;
+  const Vector<3> pd = makeVector(0.4, 0.1, 0.5);
+  const UnitQuaternion Qd(Matrix<3, 3>(rotx(0.3) * roty(0.2)));
+  const Vector<3> dpd = makeVector(0.01, 0.0, 0.0);
+  const Vector<3> omegad = makeVector(0.0, 0.02, 0.0);
+  Vector<6, int> mask_position = Zeros;
+  mask_position[0] = mask_position[1] = mask_position[2] = 1;
+
+  // the joints change at each cycle
+  auto setJoints = [&](int k) {
+    for (int i = 0; i < numQ; i++)
+    {
+      q_DH[i] = 0.1 * (i + 1) + 0.001 * k;
+    }
+  };
+
+  int failures = 0;
+
+  failures += report(robot_name, "fkine_all_workspace", countAllocations([&](int k) {
+                       setJoints(k);
+                       robot.fkine_all(q_DH, ws);
+                     }));
+
+  failures += report(robot_name, "jacob_geometric_workspace", countAllocations([&](int k) {
+                       setJoints(k);
+                       robot.jacob_geometric(q_DH, ws);
+                     }));
+
+  const CLIKSolver solvers[2] = { CLIK_SOLVER_PINV, CLIK_SOLVER_CHOLESKY };
+  const string solver_names[2] = { "pinv", "cholesky" };
+  for (int s = 0; s < 2; s++)
+  {
+    robot.setCLIKSolver(solvers[s]);
+
+    failures += report(robot_name, "clik_workspace_" + solver_names[s], countAllocations([&](int k) {
+                         setJoints(k);
+                         robot.clik(q_DH, pd, Qd, Q, dpd, omegad, 50.0, 0.001, 1.0, q0_p, ws, qpDH, error, Q);
+                       }));
+
+    failures += report(robot_name, "clik_workspace_position_only_" + solver_names[s], countAllocations([&](int k) {
+                         setJoints(k);
+                         robot.clik(q_DH, pd, Qd, Q, dpd, omegad, mask_position, 50.0, 0.001, 1.0, q0_p, ws, qpDH,
+                                    error, Q);
+                       }));
+  }
+
+  return failures;
+}
+
+}  // namespace
+
+int main()
+{
+  LBRiiwa7 iiwa("LBRiiwa7");
+  MotomanSIA5F sia5f("MotomanSIA5F");
+
+  int failures = 0;
+  failures += testRobot(iiwa);
+  failures += testRobot(sia5f);
+
+  if (failures != 0)
+  {
+    cout << failures << " checks failed" << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}